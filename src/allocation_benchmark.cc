@@ -0,0 +1,203 @@
+#include "allocation_benchmark.hh"
+#include "allocation_tracker.hh"
+#include "corpus.hh"
+#include "game_loader.hh"
+#include "replay.hh"
+
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+
+
+using namespace std;
+
+
+
+struct GameAllocations
+{
+	string   path;
+	size_t   moves;
+	uint64_t allocations;
+	uint64_t bytes;
+};
+
+
+
+int corpus::allocation_report_command( const vector<string>& args )
+{
+	auto usage = []()
+	{
+		wcout << "Usage: --allocation-report <directory> [--max-allocations-per-move N]" << endl;
+		return 1;
+	};
+
+	if( args.empty() )
+	{
+		return usage();
+	}
+
+	double max_allocations_per_move = -1;
+	for( size_t i = 1; i < args.size(); i += 2 )
+	{
+		if( i + 1 >= args.size() )
+		{
+			return usage();
+		}
+
+		if( args[i] == "--max-allocations-per-move" )
+		{
+			max_allocations_per_move = stod( args[i + 1] );
+		}
+		else
+		{
+			return usage();
+		}
+	}
+
+	auto files = find_game_files( args[0] );
+	if( files.empty() )
+	{
+		wcout << "No games found in " << args[0].c_str() << endl;
+		return 1;
+	}
+
+	// A move is due at every update, each one is played and published
+	// like the viewer does at its slowest
+	using Clock = gui::MoveScheduler::Clock;
+	const Clock::duration interval = chrono::milliseconds( 1 );
+
+	vector<GameAllocations> games;
+	games.reserve( files.size() );
+
+	tools::reset_allocation_stats();
+	tools::enable_allocation_tracking( true );
+	{
+		tools::AllocationScope allocation_scope{ tools::ALLOC_REPLAY };
+
+		GameLoader  loader{ files };
+		gui::Replay replay{ interval };
+
+		auto now      = Clock::now();
+		auto deadline = Clock::time_point::max();
+
+		size_t last_move_number = 0;
+		string game_path;
+		auto   game_start       = tools::get_allocation_stats( tools::ALLOC_REPLAY );
+
+		// The bookkeeping here isn't counted against the replay
+		auto end_game = [&]( const tools::AllocationStats& end )
+		{
+			tools::AllocationScope other_scope{ tools::ALLOC_OTHER };
+			if( last_move_number )
+			{
+				games.push_back( {
+					game_path,
+					last_move_number,
+					end.allocations - game_start.allocations,
+					end.bytes - game_start.bytes
+				} );
+			}
+			game_start = end;
+		};
+
+		while( !replay.is_finished( loader ) )
+		{
+			auto before = tools::get_allocation_stats( tools::ALLOC_REPLAY );
+
+			now += interval;
+			if( !replay.update( loader, now, deadline ) && !replay.get_move_number() )
+			{
+				// Waiting for the loader
+				this_thread::yield();
+			}
+
+			auto move_number = replay.get_move_number();
+			if( move_number < last_move_number )
+			{
+				end_game( before );
+			}
+
+			if( move_number && (!last_move_number || move_number < last_move_number) )
+			{
+				tools::AllocationScope other_scope{ tools::ALLOC_OTHER };
+				game_path = replay.get_game().path;
+			}
+			last_move_number = move_number;
+		}
+
+		end_game( tools::get_allocation_stats( tools::ALLOC_REPLAY ) );
+	}
+	tools::enable_allocation_tracking( false );
+
+	for( auto& line : tools::allocation_report() )
+	{
+		wcout << line.c_str() << endl;
+	}
+
+	size_t   total_moves       = 0;
+	uint64_t total_allocations = 0;
+	uint64_t total_bytes       = 0;
+	for( auto& game : games )
+	{
+		total_moves       += game.moves;
+		total_allocations += game.allocations;
+		total_bytes       += game.bytes;
+	}
+
+	if( games.empty() || !total_moves )
+	{
+		wcout << "None of the games could be replayed" << endl;
+		return 1;
+	}
+
+	auto parse  = tools::get_allocation_stats( tools::ALLOC_PARSE );
+	auto loader = tools::get_allocation_stats( tools::ALLOC_LOADER );
+
+	auto per_move = static_cast<double>( total_allocations ) / total_moves;
+
+	char line[160];
+	snprintf(
+		line, sizeof( line ),
+		"%u games, %u moves\n"
+		"Per game: %.1f allocations parsing, %.1f loading, %.1f replaying\n"
+		"Per move: %.3f allocations, %.1f bytes replaying",
+		static_cast<unsigned>( games.size() ), static_cast<unsigned>( total_moves ),
+		static_cast<double>( parse.allocations ) / games.size(),
+		static_cast<double>( loader.allocations ) / games.size(),
+		static_cast<double>( total_allocations ) / games.size(),
+		per_move,
+		static_cast<double>( total_bytes ) / total_moves
+	);
+	wcout << line << endl;
+
+	// The games that allocate the most for their length
+	auto by_allocations_per_move = []( const GameAllocations& a, const GameAllocations& b )
+	{
+		return a.allocations * b.moves > b.allocations * a.moves;
+	};
+
+	auto worst = min<size_t>( games.size(), 5 );
+	partial_sort( games.begin(), games.begin() + worst, games.end(), by_allocations_per_move );
+
+	wcout << "Most allocations per move:" << endl;
+	for( size_t i = 0; i < worst; i++ )
+	{
+		snprintf(
+			line, sizeof( line ), "  %.3f (%llu allocations, %u moves) ",
+			static_cast<double>( games[i].allocations ) / games[i].moves,
+			static_cast<unsigned long long>( games[i].allocations ),
+			static_cast<unsigned>( games[i].moves )
+		);
+		wcout << line << games[i].path.c_str() << endl;
+	}
+
+	if( max_allocations_per_move >= 0 && per_move > max_allocations_per_move )
+	{
+		wcout << "Over the limit of " << max_allocations_per_move << " allocations per move" << endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+// Counting the heap allocations of loading and replaying a collection
+// - The games go through the same loader and replay as in the viewer,
+//   on a simulated clock that plays and publishes a move per update
+// - Reports the allocations of every subsystem, per game and per move,
+//   and fails if the replay allocates more per move than allowed, so
+//   that it can guard a benchmark run
+namespace corpus
+{
+	int allocation_report_command( const std::vector<std::string>& args );
+}
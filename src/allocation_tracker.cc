@@ -0,0 +1,265 @@
+#include "allocation_tracker.hh"
+
+#include <new>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+
+
+using namespace std;
+
+
+namespace
+{
+	struct TagCounters
+	{
+		atomic<uint64_t> allocations;
+		atomic<uint64_t> frees;
+		atomic<uint64_t> bytes;
+		atomic<int64_t>  live_bytes;
+		atomic<int64_t>  peak_bytes;
+	};
+
+	// Plain globals without constructors, usable before main() and
+	// from any allocation
+	atomic<bool> tracking_enabled{ false };
+	TagCounters  counters[tools::ALLOC_TAG_COUNT];
+
+	thread_local tools::AllocationTag current_tag = tools::ALLOC_OTHER;
+
+	// Every block starts with a header telling what it was counted
+	// against, so that the free goes to the same tag whichever thread
+	// or scope it happens in. The header keeps the alignment malloc
+	// gives.
+	struct alignas( 16 ) BlockHeader
+	{
+		uint64_t size;
+		uint32_t tag; // untracked if allocated while tracking was off
+	};
+
+	const uint32_t untracked = UINT32_MAX;
+
+
+
+	void count_allocation( BlockHeader& header )
+	{
+		auto  size = static_cast<int64_t>( header.size );
+		auto& tag  = counters[header.tag];
+
+		tag.allocations.fetch_add( 1, memory_order_relaxed );
+		tag.bytes.fetch_add( header.size, memory_order_relaxed );
+
+		auto live = tag.live_bytes.fetch_add( size, memory_order_relaxed ) + size;
+		auto peak = tag.peak_bytes.load( memory_order_relaxed );
+		while( live > peak && !tag.peak_bytes.compare_exchange_weak( peak, live, memory_order_relaxed ) )
+		{
+		}
+	}
+
+
+
+	void count_free( const BlockHeader& header )
+	{
+		auto& tag = counters[header.tag];
+
+		tag.frees.fetch_add( 1, memory_order_relaxed );
+		tag.live_bytes.fetch_sub( static_cast<int64_t>( header.size ), memory_order_relaxed );
+	}
+
+
+
+	void* tracked_allocate( size_t size )
+	{
+		if( size > SIZE_MAX - sizeof( BlockHeader ) )
+		{
+			return nullptr;
+		}
+
+		auto header = static_cast<BlockHeader*>( malloc( sizeof( BlockHeader ) + size ) );
+		if( !header )
+		{
+			return nullptr;
+		}
+
+		header->size = size;
+		header->tag  = untracked;
+		if( tracking_enabled.load( memory_order_relaxed ) )
+		{
+			header->tag = current_tag;
+			count_allocation( *header );
+		}
+
+		return header + 1;
+	}
+
+
+
+	void tracked_free( void *pointer )
+	{
+		if( !pointer )
+		{
+			return;
+		}
+
+		// Counted even if tracking was turned off since, so that the
+		// live bytes balance
+		auto header = static_cast<BlockHeader*>( pointer ) - 1;
+		if( header->tag != untracked )
+		{
+			count_free( *header );
+		}
+
+		free( header );
+	}
+}
+
+
+
+void* operator new( size_t size )
+{
+	auto pointer = tracked_allocate( size );
+	if( !pointer )
+	{
+		throw bad_alloc();
+	}
+
+	return pointer;
+}
+
+
+
+void* operator new[]( size_t size )
+{
+	auto pointer = tracked_allocate( size );
+	if( !pointer )
+	{
+		throw bad_alloc();
+	}
+
+	return pointer;
+}
+
+
+
+void* operator new( size_t size, const nothrow_t& ) noexcept
+{
+	return tracked_allocate( size );
+}
+
+
+
+void* operator new[]( size_t size, const nothrow_t& ) noexcept
+{
+	return tracked_allocate( size );
+}
+
+
+
+void operator delete( void *pointer ) noexcept                     { tracked_free( pointer ); }
+void operator delete[]( void *pointer ) noexcept                   { tracked_free( pointer ); }
+void operator delete( void *pointer, size_t ) noexcept             { tracked_free( pointer ); }
+void operator delete[]( void *pointer, size_t ) noexcept           { tracked_free( pointer ); }
+void operator delete( void *pointer, const nothrow_t& ) noexcept   { tracked_free( pointer ); }
+void operator delete[]( void *pointer, const nothrow_t& ) noexcept { tracked_free( pointer ); }
+
+
+
+void tools::enable_allocation_tracking( bool enable )
+{
+	tracking_enabled = enable;
+}
+
+
+
+bool tools::is_allocation_tracking()
+{
+	return tracking_enabled;
+}
+
+
+
+tools::AllocationStats tools::get_allocation_stats( AllocationTag tag )
+{
+	auto& tag_counters = counters[tag];
+
+	AllocationStats stats;
+	stats.allocations = tag_counters.allocations.load( memory_order_relaxed );
+	stats.frees       = tag_counters.frees.load( memory_order_relaxed );
+	stats.bytes       = tag_counters.bytes.load( memory_order_relaxed );
+	stats.live_bytes  = tag_counters.live_bytes.load( memory_order_relaxed );
+	stats.peak_bytes  = tag_counters.peak_bytes.load( memory_order_relaxed );
+	return stats;
+}
+
+
+
+void tools::reset_allocation_stats()
+{
+	for( auto& tag_counters : counters )
+	{
+		tag_counters.allocations = 0;
+		tag_counters.frees       = 0;
+		tag_counters.bytes       = 0;
+		tag_counters.peak_bytes  = tag_counters.live_bytes.load();
+	}
+}
+
+
+
+const char* tools::allocation_tag_name( AllocationTag tag )
+{
+	switch( tag )
+	{
+		case ALLOC_OTHER:  return "other";
+		case ALLOC_PARSE:  return "parse";
+		case ALLOC_LOADER: return "loader";
+		case ALLOC_REPLAY: return "replay";
+		case ALLOC_RENDER: return "render";
+		default:           return "?";
+	}
+}
+
+
+
+vector<string> tools::allocation_report()
+{
+	vector<string> lines;
+	char line[160];
+
+	snprintf( line, sizeof( line ), "%-8s %12s %12s %14s %12s %12s",
+	          "tag", "allocations", "frees", "bytes", "live", "peak" );
+	lines.push_back( line );
+
+	for( int tag = 0; tag < ALLOC_TAG_COUNT; tag++ )
+	{
+		auto stats = get_allocation_stats( static_cast<AllocationTag>( tag ) );
+		snprintf(
+			line, sizeof( line ), "%-8s %12llu %12llu %14llu %12lld %12lld",
+			allocation_tag_name( static_cast<AllocationTag>( tag ) ),
+			static_cast<unsigned long long>( stats.allocations ),
+			static_cast<unsigned long long>( stats.frees ),
+			static_cast<unsigned long long>( stats.bytes ),
+			static_cast<long long>( stats.live_bytes ),
+			static_cast<long long>( stats.peak_bytes )
+		);
+		lines.push_back( line );
+	}
+
+	return lines;
+}
+
+
+
+tools::AllocationScope::AllocationScope( AllocationTag tag )
+: previous_tag( current_tag )
+{
+	current_tag = tag;
+}
+
+
+
+tools::AllocationScope::~AllocationScope()
+{
+	current_tag = previous_tag;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Counting heap allocations by subsystem
+// - The global operator new and delete are replaced. While tracking is
+//   off, the default, they cost one relaxed atomic load and the
+//   header on top of malloc and free.
+// - While on, every allocation is counted against the tag of the
+//   innermost AllocationScope of the thread doing it. The tag is kept
+//   in a small header in front of the block, and the free is counted
+//   against that tag, whatever thread or scope frees it. Memory handed
+//   over to another subsystem shows as live in the one that allocated it.
+// - Blocks allocated while tracking was off aren't counted when freed
+namespace tools
+{
+	enum AllocationTag
+	{
+		ALLOC_OTHER,
+		ALLOC_PARSE,
+		ALLOC_LOADER,
+		ALLOC_REPLAY,
+		ALLOC_RENDER,
+		ALLOC_TAG_COUNT
+	};
+
+	struct AllocationStats
+	{
+		uint64_t allocations = 0;
+		uint64_t frees       = 0;
+		uint64_t bytes       = 0; // Allocated in total
+		int64_t  live_bytes  = 0;
+		int64_t  peak_bytes  = 0; // Highest live_bytes seen
+	};
+
+
+	void enable_allocation_tracking( bool enable );
+	bool is_allocation_tracking();
+
+	AllocationStats get_allocation_stats( AllocationTag tag );
+
+	// Zeroes the counts, live bytes are kept and the peaks start over
+	// from them
+	void reset_allocation_stats();
+
+	const char* allocation_tag_name( AllocationTag tag );
+
+	// A line per tag, for printing
+	std::vector<std::string> allocation_report();
+
+
+	// Tags the allocations of this thread until it goes out of scope
+	class AllocationScope
+	{
+		AllocationTag previous_tag;
+
+
+	  public:
+		explicit AllocationScope( AllocationTag tag );
+		~AllocationScope();
+
+		AllocationScope( const AllocationScope& ) = delete;
+		AllocationScope& operator=( const AllocationScope& ) = delete;
+	};
+}
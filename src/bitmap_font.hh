@@ -0,0 +1,19 @@
+#pragma once
+
+#include "sdl2.hh"
+
+#include <cstdint>
+
+
+namespace gui
+{
+	// Built-in 5x7 pixel font, so that labels don't depend on font files,
+	// drawn through the TextCache like any other font
+	const int bitmap_glyph_width   = 5;
+	const int bitmap_glyph_height  = 7;
+	const int bitmap_glyph_advance = 6;
+
+	// Rows of the glyph from the top, bit 4 is the leftmost column
+	// - Lower case letters map to upper case, unknown characters are blank
+	const uint8_t* get_bitmap_glyph( char c );
+}
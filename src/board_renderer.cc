@@ -0,0 +1,849 @@
+#include "board_renderer.hh"
+
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+
+using namespace std;
+using namespace gui;
+
+
+
+string gui::column_label( size_t x )
+{
+	const string letters = "ABCDEFGHJKLMNOPQRSTUVWXYZ";
+
+	if( x < letters.size() )
+	{
+		return string( 1, letters[x] );
+	}
+
+	return string( 1, letters[x / letters.size() - 1] ) + letters[x % letters.size()];
+}
+
+
+
+// Kept even for a single board, resizing goes through a few sizes
+const size_t min_cached_resources = 4;
+
+// Text smaller than this isn't readable, it's left out
+const int min_text_size = 6;
+
+const SDL_Color black_ink{ 0, 0, 0, 255 };
+const SDL_Color white_ink{ 255, 255, 255, 255 };
+const SDL_Color last_move_ink{ 220, 40, 40, 255 };
+const SDL_Color info_ink{ 200, 200, 200, 255 };
+
+
+
+BoardResources::BoardResources(
+	SDL_Renderer *target_renderer,
+	SDL_Surface  *wood,
+	const string& font_path
+)
+: renderer( target_renderer ),
+  capacity( min_cached_resources ),
+  next_id( 1 ),
+  text( target_renderer, font_path ),
+  generation( 0 )
+{
+	wood_texture = sdl2::TexturePtr(
+		SDL_CreateTextureFromSurface( renderer, wood )
+	);
+
+	if( !wood_texture )
+	{
+		wcerr << "BoardResources::BoardResources() - Couldn't create wood texture: "
+		      << SDL_GetError() << endl;
+	}
+}
+
+
+
+bool BoardResources::is_initialized() const
+{
+	return !!wood_texture;
+}
+
+
+
+SDL_Renderer* BoardResources::get_renderer() const
+{
+	return renderer;
+}
+
+
+
+void BoardResources::set_board_count( size_t board_count )
+{
+	capacity = max( board_count, min_cached_resources );
+}
+
+
+
+SDL_Texture* BoardResources::get_board_layer( size_t board_size, int width, int height, uint64_t *id )
+{
+	for( auto layer = layers.begin(); layer != layers.end(); layer++ )
+	{
+		if( layer->board_size == board_size &&
+		    layer->width == width &&
+		    layer->height == height )
+		{
+			// Most recently used to the back
+			auto used = move( *layer );
+			layers.erase( layer );
+			layers.push_back( move( used ) );
+
+			if( id )
+			{
+				*id = layers.back().id;
+			}
+			return layers.back().texture.get();
+		}
+	}
+
+	if( width <= 0 || height <= 0 )
+	{
+		return nullptr;
+	}
+
+	auto texture = sdl2::TexturePtr( SDL_CreateTexture(
+		renderer,
+		SDL_PIXELFORMAT_RGBA8888,
+		SDL_TEXTUREACCESS_TARGET,
+		width,
+		height
+	) );
+
+	if( !texture )
+	{
+		return nullptr;
+	}
+
+	auto previous_target = SDL_GetRenderTarget( renderer );
+	if( SDL_SetRenderTarget( renderer, texture.get() ) )
+	{
+		return nullptr;
+	}
+
+	draw_board( board_size, width, height );
+	SDL_SetRenderTarget( renderer, previous_target );
+
+	while( layers.size() >= capacity )
+	{
+		layers.pop_front();
+	}
+
+	layers.push_back( { board_size, width, height, next_id++, move( texture ) } );
+	if( id )
+	{
+		*id = layers.back().id;
+	}
+	return layers.back().texture.get();
+}
+
+
+
+StoneAtlas& BoardResources::get_atlas( int diameter, uint64_t *id )
+{
+	for( auto atlas = atlases.begin(); atlas != atlases.end(); atlas++ )
+	{
+		if( atlas->atlas->get_diameter() == diameter )
+		{
+			auto used = move( *atlas );
+			atlases.erase( atlas );
+			atlases.push_back( move( used ) );
+
+			if( id )
+			{
+				*id = atlases.back().id;
+			}
+			return *atlases.back().atlas;
+		}
+	}
+
+	while( atlases.size() >= capacity )
+	{
+		atlases.pop_front();
+	}
+
+	atlases.push_back( { next_id++, unique_ptr<StoneAtlas>( new StoneAtlas( renderer ) ) } );
+	atlases.back().atlas->prepare( diameter );
+	if( id )
+	{
+		*id = atlases.back().id;
+	}
+	return *atlases.back().atlas;
+}
+
+
+
+bool BoardResources::holds( uint64_t id ) const
+{
+	for( auto& layer : layers )
+	{
+		if( layer.id == id )
+		{
+			return true;
+		}
+	}
+
+	for( auto& atlas : atlases )
+	{
+		if( atlas.id == id )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+TextCache& BoardResources::get_text()
+{
+	return text;
+}
+
+
+
+void BoardResources::clear()
+{
+	layers.clear();
+	atlases.clear();
+	text.clear();
+	generation++;
+}
+
+
+
+uint64_t BoardResources::get_generation() const
+{
+	return generation;
+}
+
+
+
+void BoardResources::draw_board( size_t board_size, int width, int height )
+{
+	double step_size = (width < height ? width : height) / (board_size + 1);
+
+	// Fill rather than clear, clearing ignores the viewport
+	const SDL_Rect background{ 0, 0, width, height };
+	SDL_SetRenderDrawColor( renderer, 0, 0, 0, 255 );
+	SDL_RenderFillRect( renderer, &background );
+
+	SDL_Rect board_rect =
+	{
+		static_cast<int>(step_size/2.f),
+		static_cast<int>(step_size/2.f),
+		static_cast<int>(board_size * step_size),
+		static_cast<int>(board_size * step_size)
+	};
+
+	SDL_RenderCopy(
+		renderer,
+		wood_texture.get(),
+		nullptr,
+		&board_rect
+	);
+
+	// Render lines
+
+	for( size_t y = 1; y <= board_size; y++ )
+	{
+		SDL_RenderDrawLine(
+			renderer,
+			static_cast<int>(step_size),
+			static_cast<int>(y*step_size),
+			static_cast<int>(board_size * step_size),
+			static_cast<int>(y*step_size)
+		);
+	}
+
+	for( size_t x = 1; x <= board_size; x++ )
+	{
+		SDL_RenderDrawLine(
+			renderer,
+			static_cast<int>(x*step_size),
+			static_cast<int>(step_size ),
+			static_cast<int>(x*step_size),
+			static_cast<int>(board_size * step_size)
+		);
+	}
+
+	// Render star points, on the 4th line from the edges on
+	// big boards and on the 3rd on small ones, plus the center
+
+	if( board_size >= 7 )
+	{
+		size_t edge = board_size >= 13 ? 4 : 3;
+		vector<size_t> lines{ edge, board_size + 1 - edge };
+		if( board_size % 2 && board_size >= 9 )
+		{
+			lines.push_back( (board_size + 1) / 2 );
+		}
+
+		auto radius = static_cast<int>( step_size / 10 ) + 1;
+		for( auto y : lines )
+		{
+			for( auto x : lines )
+			{
+				auto center_x = static_cast<int>( x * step_size );
+				auto center_y = static_cast<int>( y * step_size );
+
+				for( int dy = -radius; dy <= radius; dy++ )
+				{
+					int dx = 0;
+					while( (dx + 1) * (dx + 1) + dy * dy <= radius * radius )
+					{
+						dx++;
+					}
+
+					SDL_RenderDrawLine(
+						renderer,
+						center_x - dx, center_y + dy,
+						center_x + dx, center_y + dy
+					);
+				}
+			}
+		}
+	}
+
+	// Render coordinate labels, in the wood margin around the lines
+
+	auto label_height = static_cast<int>( step_size * 0.25 );
+	if( label_height < 7 )
+	{
+		return;
+	}
+
+	for( size_t i = 0; i < board_size; i++ )
+	{
+		auto line_position = static_cast<int>( (i + 1) * step_size );
+		auto near_margin   = static_cast<int>( step_size * 0.75 );
+		auto far_margin    = static_cast<int>( (board_size + 0.25) * step_size );
+		auto row_label     = to_string( board_size - i );
+
+		text.draw( column_label( i ), label_height, line_position, near_margin, black_ink );
+		text.draw( column_label( i ), label_height, line_position, far_margin, black_ink );
+		text.draw( row_label, label_height, near_margin, line_position, black_ink );
+		text.draw( row_label, label_height, far_margin, line_position, black_ink );
+	}
+
+	text.flush();
+}
+
+
+
+BoardRenderer::BoardRenderer( BoardResources& shared_resources )
+: resources( shared_resources ),
+  renderer( shared_resources.get_renderer() ),
+  board_layer( nullptr ),
+  atlas( nullptr ),
+  batch( shared_resources.get_renderer() ),
+  frame_valid( false ),
+  resources_generation( shared_resources.get_generation() ),
+  board_layer_id( 0 ),
+  atlas_id( 0 ),
+  width( 0 ),
+  height( 0 ),
+  board_size( 0 ),
+  step_size( 0 ),
+  show_move_numbers( false ),
+  info_area{ 0, 0, 0, 0 },
+  info_text_size( 0 )
+{
+}
+
+
+
+void BoardRenderer::set_move_numbers( bool show )
+{
+	if( show != show_move_numbers )
+	{
+		show_move_numbers = show;
+		invalidate();
+	}
+}
+
+
+
+void BoardRenderer::invalidate()
+{
+	frame_valid = false;
+}
+
+
+
+bool BoardRenderer::is_up_to_date( uint64_t revision ) const
+{
+	return frame_valid &&
+	       frame_board.revision == revision &&
+	       resources_generation == resources.get_generation() &&
+	       resources.holds( board_layer_id ) &&
+	       resources.holds( atlas_id );
+}
+
+
+
+void BoardRenderer::update_layout( size_t goban_size, int target_width, int target_height )
+{
+	if( goban_size == board_size &&
+	    target_width == width &&
+	    target_height == height )
+	{
+		return;
+	}
+
+	board_size = goban_size;
+	width      = target_width;
+	height     = target_height;
+	step_size  = (width < height ? width : height) / (board_size + 1);
+
+	// The game info goes beside the board if there's room,
+	// otherwise below it, otherwise nowhere
+	auto board_extent = static_cast<int>( (board_size + 1) * step_size );
+	info_text_size = min( max( static_cast<int>( step_size * 0.45 ), 10 ), 20 );
+	info_area      = { 0, 0, 0, 0 };
+
+	if( width - board_extent >= 12 * info_text_size )
+	{
+		info_area = { board_extent, 0, width - board_extent, height };
+	}
+	else if( height - board_extent >= 4 * info_text_size )
+	{
+		info_area = { 0, board_extent, width, height - board_extent };
+	}
+
+	frame.reset();
+	invalidate();
+}
+
+
+
+void BoardRenderer::render( const go::BoardSnapshot& board, const SDL_Rect& area )
+{
+	update_layout( board.board_size, area.w, area.h );
+
+	// The layer and the atlas are looked up every time, the resources
+	// may have dropped the ones used last to make room for other boards.
+	// Only a frame drawn with dropped ones is redrawn.
+	uint64_t layer_id  = 0;
+	uint64_t stones_id = 0;
+	board_layer = resources.get_board_layer( board_size, width, height, &layer_id );
+	atlas       = &resources.get_atlas( static_cast<int>( step_size - step_size / 5 ), &stones_id );
+
+	if( resources_generation != resources.get_generation() ||
+	    layer_id != board_layer_id ||
+	    stones_id != atlas_id )
+	{
+		resources_generation = resources.get_generation();
+		board_layer_id       = layer_id;
+		atlas_id             = stones_id;
+		invalidate();
+	}
+
+	if( board_layer && !frame )
+	{
+		frame = sdl2::TexturePtr( SDL_CreateTexture(
+			renderer,
+			SDL_PIXELFORMAT_RGBA8888,
+			SDL_TEXTUREACCESS_TARGET,
+			width,
+			height
+		) );
+	}
+
+	// Without render target support, draw everything the slow way
+	if( !board_layer || !frame )
+	{
+		SDL_RenderSetViewport( renderer, &area );
+		resources.draw_board( board_size, width, height );
+		draw_stones( board );
+		for( size_t i = 0; i < board_size * board_size; i++ )
+		{
+			draw_annotations( board, i );
+		}
+		resources.get_text().flush();
+		draw_info( board );
+		SDL_RenderSetViewport( renderer, nullptr );
+		return;
+	}
+
+	update_frame( board );
+	SDL_RenderCopy( renderer, frame.get(), nullptr, &area );
+}
+
+
+
+void BoardRenderer::update_frame( const go::BoardSnapshot& board )
+{
+	if( frame_valid && board.revision == frame_board.revision )
+	{
+		return;
+	}
+
+	auto previous_target = SDL_GetRenderTarget( renderer );
+	SDL_SetRenderTarget( renderer, frame.get() );
+
+	// Start over from the board layer
+	if( !frame_valid || frame_board.board_size != board.board_size )
+	{
+		SDL_RenderCopy( renderer, board_layer, nullptr, nullptr );
+		draw_stones( board );
+		for( size_t i = 0; i < board_size * board_size; i++ )
+		{
+			draw_annotations( board, i );
+		}
+		resources.get_text().flush();
+		draw_info( board );
+	}
+
+	// Repaint the points that differ from what the frame shows,
+	// comparing 32 points at a time
+	else
+	{
+		dirty_points.clear();
+
+		auto point_count = board.board_size * board.board_size;
+		auto used_words  = board.used_words();
+		for( size_t word = 0; word < used_words; word++ )
+		{
+			auto difference = board.words[word] ^ frame_board.words[word];
+			for( size_t bit = 0; difference; bit++, difference >>= 2 )
+			{
+				if( difference & 3 )
+				{
+					dirty_points.push_back( word * 32 + bit );
+				}
+			}
+		}
+
+		// The last move marker moves along
+		if( frame_board.last_move != board.last_move )
+		{
+			for( auto index : { frame_board.last_move, board.last_move } )
+			{
+				if( index < point_count )
+				{
+					dirty_points.push_back( index );
+				}
+			}
+		}
+
+		add_dirty_annotations( board );
+
+		sort( dirty_points.begin(), dirty_points.end() );
+		dirty_points.erase( unique( dirty_points.begin(), dirty_points.end() ), dirty_points.end() );
+
+		// Restore the board under the points, then put the stones
+		// back, a batch for each
+		batch.begin( board_layer );
+		for( auto index : dirty_points )
+		{
+			auto rect = point_rect( index % board_size, index / board_size );
+			batch.add( rect, rect );
+		}
+
+		batch.begin( atlas->get_texture() );
+		for( auto index : dirty_points )
+		{
+			add_stone( board, index );
+		}
+		batch.flush();
+
+		for( auto index : dirty_points )
+		{
+			draw_annotations( board, index );
+		}
+		resources.get_text().flush();
+
+		if( board.move_number != frame_board.move_number ||
+		    !equal( begin( board.info ), end( board.info ), begin( frame_board.info ) ) )
+		{
+			draw_info( board );
+		}
+	}
+
+	SDL_SetRenderTarget( renderer, previous_target );
+
+	frame_valid = true;
+	frame_board = board;
+}
+
+
+
+// Area of the point, a step wide and high around the intersection
+SDL_Rect BoardRenderer::point_rect( size_t x, size_t y ) const
+{
+	auto step = static_cast<int>( step_size );
+	return {
+		static_cast<int>( (x + 1) * step_size ) - step / 2,
+		static_cast<int>( (y + 1) * step_size ) - step / 2,
+		step,
+		step
+	};
+}
+
+
+
+void BoardRenderer::draw_stones( const go::BoardSnapshot& board )
+{
+	batch.begin( atlas->get_texture() );
+	for( size_t i = 0; i < board.board_size * board.board_size; i++ )
+	{
+		add_stone( board, i );
+	}
+	batch.flush();
+}
+
+
+
+void BoardRenderer::add_stone( const go::BoardSnapshot& board, size_t index )
+{
+	auto side = board.get( index );
+	if( side == go::Side::NONE || !atlas->get_texture() )
+	{
+		return;
+	}
+
+	auto stone_size = atlas->get_diameter();
+	auto source     = atlas->get_sprite( side, index == board.last_move && !show_move_numbers );
+	auto x          = index % board_size;
+	auto y          = index / board_size;
+
+	SDL_Rect stone_rect
+	{
+		static_cast<int>( (x + 1) * step_size ) - stone_size / 2,
+		static_cast<int>( (y + 1) * step_size ) - stone_size / 2,
+		stone_size,
+		stone_size
+	};
+
+	batch.add( source, stone_rect );
+}
+
+
+
+// Points whose move number, markup or label changed
+void BoardRenderer::add_dirty_annotations( const go::BoardSnapshot& board )
+{
+	if( show_move_numbers )
+	{
+		auto used_words = board.used_number_words();
+		for( size_t word = 0; word < used_words; word++ )
+		{
+			auto difference = board.numbers[word] ^ frame_board.numbers[word];
+			for( size_t lane = 0; difference; lane++, difference >>= 16 )
+			{
+				if( difference & 0xffff )
+				{
+					dirty_points.push_back( word * 4 + lane );
+				}
+			}
+		}
+	}
+
+	auto used_words = board.used_mark_words();
+	for( size_t word = 0; word < used_words; word++ )
+	{
+		auto difference = board.marks[word] ^ frame_board.marks[word];
+		for( size_t lane = 0; difference; lane++, difference >>= 4 )
+		{
+			if( difference & 0xf )
+			{
+				dirty_points.push_back( word * 16 + lane );
+			}
+		}
+	}
+
+	auto labels_changed = board.label_count != frame_board.label_count ||
+		!equal( board.labels, board.labels + board.label_count, frame_board.labels );
+	if( !labels_changed )
+	{
+		return;
+	}
+
+	auto point_count = board.board_size * board.board_size;
+	const go::BoardSnapshot *snapshots[] = { &board, &frame_board };
+	for( auto snapshot : snapshots )
+	{
+		for( size_t i = 0; i < snapshot->label_count; i++ )
+		{
+			size_t index;
+			snapshot->get_label( i, index );
+			if( index < point_count )
+			{
+				dirty_points.push_back( index );
+			}
+		}
+	}
+}
+
+
+
+// Queues the label or the move number of the point on the text cache
+// and draws its markup, ink contrasting with the stone
+void BoardRenderer::draw_annotations( const go::BoardSnapshot& board, size_t index )
+{
+	auto side     = board.get( index );
+	auto ink      = side == go::Side::BLACK ? white_ink : black_ink;
+	auto center_x = static_cast<int>( (index % board_size + 1) * step_size );
+	auto center_y = static_cast<int>( (index / board_size + 1) * step_size );
+
+	auto mark = board.get_mark( index );
+	if( mark != go::MARK_NONE )
+	{
+		draw_mark( mark, center_x, center_y, ink );
+	}
+
+	auto& text = resources.get_text();
+	for( size_t i = 0; i < board.label_count; i++ )
+	{
+		size_t label_index;
+		auto label = board.get_label( i, label_index );
+
+		auto label_size = static_cast<int>( step_size * 0.5 );
+		if( label_index == index && label_size >= min_text_size )
+		{
+			text.draw( label, label_size, center_x, center_y, ink );
+			return;
+		}
+	}
+
+	auto number_size = static_cast<int>( step_size * 0.4 );
+	if( !show_move_numbers || side == go::Side::NONE || number_size < min_text_size )
+	{
+		return;
+	}
+
+	auto number = board.get_number( index );
+	if( number )
+	{
+		text.draw(
+			to_string( number ),
+			number_size,
+			center_x,
+			center_y,
+			index == board.last_move ? last_move_ink : ink
+		);
+	}
+}
+
+
+
+void BoardRenderer::draw_mark( go::Mark mark, int center_x, int center_y, SDL_Color color )
+{
+	auto radius = static_cast<int>( step_size * 0.25 );
+	if( radius < 2 )
+	{
+		return;
+	}
+
+	vector<SDL_Point> outline;
+	switch( mark )
+	{
+		case go::MARK_TRIANGLE:
+		{
+			auto half_width = static_cast<int>( radius * 0.87 );
+			outline = {
+				{ center_x, center_y - radius },
+				{ center_x + half_width, center_y + radius / 2 },
+				{ center_x - half_width, center_y + radius / 2 },
+				{ center_x, center_y - radius }
+			};
+			break;
+		}
+
+		case go::MARK_CIRCLE:
+		{
+			const int    segments = 16;
+			const double pi       = 3.14159265358979323846;
+			for( int i = 0; i <= segments; i++ )
+			{
+				auto angle = i * 2 * pi / segments;
+				outline.push_back( {
+					center_x + static_cast<int>( lround( radius * cos( angle ) ) ),
+					center_y + static_cast<int>( lround( radius * sin( angle ) ) )
+				} );
+			}
+			break;
+		}
+
+		case go::MARK_SQUARE:
+		{
+			auto half = static_cast<int>( radius * 0.8 );
+			outline = {
+				{ center_x - half, center_y - half },
+				{ center_x + half, center_y - half },
+				{ center_x + half, center_y + half },
+				{ center_x - half, center_y + half },
+				{ center_x - half, center_y - half }
+			};
+			break;
+		}
+
+		case go::MARK_CROSS:
+		{
+			auto half = static_cast<int>( radius * 0.8 );
+			SDL_SetRenderDrawColor( renderer, color.r, color.g, color.b, color.a );
+			SDL_RenderDrawLine( renderer, center_x - half, center_y - half, center_x + half, center_y + half );
+			SDL_RenderDrawLine( renderer, center_x - half, center_y + half, center_x + half, center_y - half );
+			return;
+		}
+
+		default:
+			return;
+	}
+
+	SDL_SetRenderDrawColor( renderer, color.r, color.g, color.b, color.a );
+	SDL_RenderDrawLines( renderer, outline.data(), static_cast<int>( outline.size() ) );
+}
+
+
+
+// Players, date, result and the move number, a line each
+void BoardRenderer::draw_info( const go::BoardSnapshot& board )
+{
+	if( info_area.w <= 0 || info_area.h <= 0 )
+	{
+		return;
+	}
+
+	SDL_SetRenderDrawColor( renderer, 0, 0, 0, 255 );
+	SDL_RenderFillRect( renderer, &info_area );
+
+	vector<string> lines;
+	stringstream   info( board.get_info() );
+	string         line;
+	while( getline( info, line ) )
+	{
+		lines.push_back( line );
+	}
+
+	if( board.move_number )
+	{
+		lines.push_back( "Move " + to_string( board.move_number ) );
+	}
+
+	auto& text        = resources.get_text();
+	auto  line_height = text.measure( "Move", info_text_size ).y + info_text_size / 4;
+	auto  margin      = info_text_size / 2;
+	auto  y           = info_area.y + margin;
+
+	SDL_RenderSetClipRect( renderer, &info_area );
+	for( auto& info_line : lines )
+	{
+		text.draw( info_line, info_text_size, info_area.x + margin, y, info_ink, ALIGN_LEFT );
+		y += line_height;
+	}
+	text.flush();
+	SDL_RenderSetClipRect( renderer, nullptr );
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "sdl2.hh"
+#include "goban.hh"
+#include "board_snapshot.hh"
+#include "stone_atlas.hh"
+#include "sprite_batch.hh"
+#include "text_cache.hh"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+namespace gui
+{
+	// Textures shared by every board drawn with one renderer
+	// - The wood, grid lines, star points and coordinate labels only
+	//   change with the board area and the board size, so they're drawn
+	//   once into a board layer texture for each combination in use
+	// - Stone atlases are kept for each stone size in use
+	// - Text goes through one glyph cache
+	// Enough of each are kept for every board to have its own, beyond
+	// that the least recently used go first. Every layer and atlas has
+	// an id of its own, so that a board can tell whether the ones it
+	// drew with are still around.
+	class BoardResources
+	{
+		struct Layer
+		{
+			size_t           board_size;
+			int              width;
+			int              height;
+			uint64_t         id;
+			sdl2::TexturePtr texture;
+		};
+
+		struct Atlas
+		{
+			uint64_t                    id;
+			std::unique_ptr<StoneAtlas> atlas;
+		};
+
+		SDL_Renderer      *renderer;
+		sdl2::TexturePtr   wood_texture;
+		std::deque<Layer>  layers;  // Least recently used first
+		std::deque<Atlas>  atlases;
+		size_t             capacity;
+		uint64_t           next_id;
+		TextCache          text;
+		uint64_t           generation;
+
+
+	  public:
+		BoardResources(
+			SDL_Renderer      *target_renderer,
+			SDL_Surface       *wood,
+			const std::string& font_path = default_font_path
+		);
+
+		bool is_initialized() const;
+
+		SDL_Renderer* get_renderer() const;
+
+		// Keeps a layer and an atlas for this many boards
+		void set_board_count( size_t board_count );
+
+		// The board layer of the size, nullptr without render targets,
+		// id tells which one it is
+		SDL_Texture* get_board_layer( size_t board_size, int width, int height, uint64_t *id = nullptr );
+
+		StoneAtlas& get_atlas( int diameter, uint64_t *id = nullptr );
+
+		// The layer or atlas with the id hasn't been dropped
+		bool holds( uint64_t id ) const;
+
+		TextCache& get_text();
+
+		// Draws what the board layer holds to the current target
+		void draw_board( size_t board_size, int width, int height );
+
+		// Drops the layers, atlases and glyphs, eg. when render targets
+		// were reset
+		void clear();
+
+		// Changes with every clear()
+		uint64_t get_generation() const;
+	};
+
+
+	// Draws a board snapshot into an area of the current target
+	// - The finished frame is kept in a texture of its own, and only the
+	//   points that differ from the last frame are repainted into it,
+	//   from the board layer and the stones on them
+	// - Stones are anti-aliased sprites from a stone atlas, submitted
+	//   in batches rather than one draw call per stone
+	// - Markup, labels and optionally move numbers are drawn on top,
+	//   the game info beside the board when there's room for it. They
+	//   are repainted along with the points, so a full board of move
+	//   numbers costs nothing once drawn.
+	class BoardRenderer
+	{
+		BoardResources   &resources;
+		SDL_Renderer     *renderer;
+		sdl2::TexturePtr  frame;
+		SDL_Texture      *board_layer;
+		StoneAtlas       *atlas;
+		SpriteBatch       batch;
+		bool              frame_valid;
+		uint64_t          resources_generation;
+		uint64_t          board_layer_id;
+		uint64_t          atlas_id;
+
+		// What the frame shows
+		go::BoardSnapshot   frame_board;
+		std::vector<size_t> dirty_points;
+
+		int               width;
+		int               height;
+		size_t            board_size;
+		double            step_size;
+
+		bool              show_move_numbers;
+		SDL_Rect          info_area;
+		int               info_text_size;
+
+
+	  public:
+		BoardRenderer( BoardResources& shared_resources );
+
+		// Forces the frame to be redrawn, eg. after a resize
+		void invalidate();
+
+		// The frame shows this revision of the board
+		bool is_up_to_date( uint64_t revision ) const;
+
+		void render( const go::BoardSnapshot& board, const SDL_Rect& area );
+
+		// Move numbers on every stone instead of the last move marker
+		void set_move_numbers( bool show );
+
+
+	  private:
+		void update_layout( size_t goban_size, int target_width, int target_height );
+		void update_frame( const go::BoardSnapshot& board );
+		void draw_stones( const go::BoardSnapshot& board );
+		void add_stone( const go::BoardSnapshot& board, size_t index );
+		void add_dirty_annotations( const go::BoardSnapshot& board );
+		void draw_annotations( const go::BoardSnapshot& board, size_t index );
+		void draw_mark( go::Mark mark, int center_x, int center_y, SDL_Color color );
+		void draw_info( const go::BoardSnapshot& board );
+		SDL_Rect point_rect( size_t x, size_t y ) const;
+	};
+
+
+	// Go coordinate label of a column, skipping I like the convention
+	std::string column_label( size_t x );
+}
@@ -0,0 +1,346 @@
+#include "board_snapshot.hh"
+
+#include <thread>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+
+
+using namespace std;
+using namespace go;
+
+
+const size_t BoardSnapshot::max_board_size;
+const size_t BoardSnapshot::max_points;
+const size_t BoardSnapshot::word_count;
+const size_t BoardSnapshot::no_move;
+const size_t BoardSnapshot::number_word_count;
+const size_t BoardSnapshot::mark_word_count;
+const size_t BoardSnapshot::max_labels;
+const size_t BoardSnapshot::max_label_length;
+const size_t BoardSnapshot::info_word_count;
+const size_t BoardSnapshot::max_info_length;
+
+
+
+BoardSnapshot::BoardSnapshot()
+{
+}
+
+
+
+BoardSnapshot::BoardSnapshot( const Goban& goban )
+: revision( goban.get_revision() ),
+  board_size( goban.get_board_size() )
+{
+	if( board_size > max_board_size )
+	{
+		throw runtime_error( "The board is too big for a snapshot" );
+	}
+
+	auto& board = goban.get_board();
+	for( size_t i = 0; i < board.size(); i++ )
+	{
+		set( i, board[i].side );
+		if( board[i].side != Side::NONE )
+		{
+			set_number( i, board[i].number );
+		}
+	}
+
+	auto& move = goban.get_last_move();
+	if( move.side != Side::NONE )
+	{
+		last_move = move.y * board_size + move.x;
+	}
+}
+
+
+
+Side BoardSnapshot::get( size_t index ) const
+{
+	return static_cast<Side>( (words[index / 32] >> (index % 32 * 2)) & 3 );
+}
+
+
+
+void BoardSnapshot::set( size_t index, Side side )
+{
+	auto shift = index % 32 * 2;
+	auto& word = words[index / 32];
+
+	word = (word & ~(uint64_t( 3 ) << shift)) | (uint64_t( side ) << shift);
+}
+
+
+
+size_t BoardSnapshot::get_number( size_t index ) const
+{
+	return static_cast<size_t>( (numbers[index / 4] >> (index % 4 * 16)) & 0xffff );
+}
+
+
+
+void BoardSnapshot::set_number( size_t index, size_t number )
+{
+	auto shift = index % 4 * 16;
+	auto& word = numbers[index / 4];
+
+	word = (word & ~(uint64_t( 0xffff ) << shift)) | (uint64_t( min<size_t>( number, 0xffff ) ) << shift);
+}
+
+
+
+Mark BoardSnapshot::get_mark( size_t index ) const
+{
+	return static_cast<Mark>( (marks[index / 16] >> (index % 16 * 4)) & 0xf );
+}
+
+
+
+void BoardSnapshot::set_mark( size_t index, Mark mark )
+{
+	auto shift = index % 16 * 4;
+	auto& word = marks[index / 16];
+
+	word = (word & ~(uint64_t( 0xf ) << shift)) | (uint64_t( mark ) << shift);
+}
+
+
+
+// Length of the text cut to at most max_length bytes,
+// without splitting a UTF-8 sequence
+size_t utf8_prefix_length( const string& text, size_t max_length )
+{
+	if( text.size() <= max_length )
+	{
+		return text.size();
+	}
+
+	auto length = max_length;
+	while( length && (static_cast<unsigned char>( text[length] ) & 0xc0) == 0x80 )
+	{
+		length--;
+	}
+
+	return length;
+}
+
+
+
+bool BoardSnapshot::add_label( size_t index, const string& text )
+{
+	if( label_count >= max_labels )
+	{
+		return false;
+	}
+
+	auto     length = utf8_prefix_length( text, max_label_length );
+	uint64_t label  = index & 0xffff;
+	for( size_t i = 0; i < length; i++ )
+	{
+		label |= uint64_t( static_cast<unsigned char>( text[i] ) ) << (16 + i * 8);
+	}
+
+	labels[label_count++] = label;
+	return true;
+}
+
+
+
+string BoardSnapshot::get_label( size_t label, size_t& index ) const
+{
+	auto word = labels[label];
+	index = static_cast<size_t>( word & 0xffff );
+
+	string text;
+	for( word >>= 16; word & 0xff; word >>= 8 )
+	{
+		text += static_cast<char>( word & 0xff );
+	}
+
+	return text;
+}
+
+
+
+void BoardSnapshot::set_info( const string& text )
+{
+	auto length = utf8_prefix_length( text, max_info_length );
+
+	fill( begin( info ), end( info ), 0 );
+	for( size_t i = 0; i < length; i++ )
+	{
+		info[i / 8] |= uint64_t( static_cast<unsigned char>( text[i] ) ) << (i % 8 * 8);
+	}
+}
+
+
+
+string BoardSnapshot::get_info() const
+{
+	string text;
+	for( size_t i = 0; i < max_info_length; i++ )
+	{
+		auto c = static_cast<char>( (info[i / 8] >> (i % 8 * 8)) & 0xff );
+		if( !c )
+		{
+			break;
+		}
+
+		text += c;
+	}
+
+	return text;
+}
+
+
+
+size_t BoardSnapshot::used_words() const
+{
+	return (board_size * board_size + 31) / 32;
+}
+
+
+
+size_t BoardSnapshot::used_number_words() const
+{
+	return (board_size * board_size + 3) / 4;
+}
+
+
+
+size_t BoardSnapshot::used_mark_words() const
+{
+	return (board_size * board_size + 15) / 16;
+}
+
+
+
+SnapshotPublisher::SnapshotPublisher()
+: sequence( 0 ),
+  revision( 0 ),
+  board_size( 0 ),
+  last_move( BoardSnapshot::no_move ),
+  move_number( 0 ),
+  label_count( 0 )
+{
+	for( auto& word : words )
+	{
+		word.store( 0, memory_order_relaxed );
+	}
+
+	for( auto& word : numbers )
+	{
+		word.store( 0, memory_order_relaxed );
+	}
+
+	for( auto& word : marks )
+	{
+		word.store( 0, memory_order_relaxed );
+	}
+
+	for( auto& word : labels )
+	{
+		word.store( 0, memory_order_relaxed );
+	}
+
+	for( auto& word : info )
+	{
+		word.store( 0, memory_order_relaxed );
+	}
+}
+
+
+
+// Copies count words between plain and atomic arrays
+void store_words( atomic<uint64_t> *to, const uint64_t *from, size_t count )
+{
+	for( size_t i = 0; i < count; i++ )
+	{
+		to[i].store( from[i], memory_order_relaxed );
+	}
+}
+
+
+
+void load_words( uint64_t *to, const atomic<uint64_t> *from, size_t count )
+{
+	for( size_t i = 0; i < count; i++ )
+	{
+		to[i] = from[i].load( memory_order_relaxed );
+	}
+}
+
+
+
+void SnapshotPublisher::publish( const BoardSnapshot& snapshot )
+{
+	// An odd sequence marks a write in progress
+	auto begin = sequence.load( memory_order_relaxed );
+	sequence.store( begin + 1, memory_order_relaxed );
+	atomic_thread_fence( memory_order_release );
+
+	revision.store( snapshot.revision, memory_order_relaxed );
+	board_size.store( snapshot.board_size, memory_order_relaxed );
+	last_move.store( snapshot.last_move, memory_order_relaxed );
+	move_number.store( snapshot.move_number, memory_order_relaxed );
+	label_count.store( snapshot.label_count, memory_order_relaxed );
+
+	store_words( words, snapshot.words, snapshot.used_words() );
+	store_words( numbers, snapshot.numbers, snapshot.used_number_words() );
+	store_words( marks, snapshot.marks, snapshot.used_mark_words() );
+	store_words( labels, snapshot.labels, snapshot.label_count );
+	store_words( info, snapshot.info, BoardSnapshot::info_word_count );
+
+	sequence.store( begin + 2, memory_order_release );
+}
+
+
+
+void SnapshotPublisher::read( BoardSnapshot& snapshot ) const
+{
+	while( true )
+	{
+		auto begin = sequence.load( memory_order_acquire );
+		if( begin & 1 )
+		{
+			this_thread::yield();
+			continue;
+		}
+
+		snapshot.revision    = revision.load( memory_order_relaxed );
+		snapshot.board_size  = static_cast<size_t>( board_size.load( memory_order_relaxed ) );
+		snapshot.last_move   = static_cast<size_t>( last_move.load( memory_order_relaxed ) );
+		snapshot.move_number = static_cast<size_t>( move_number.load( memory_order_relaxed ) );
+		snapshot.label_count = static_cast<size_t>( label_count.load( memory_order_relaxed ) );
+
+		// The sizes may be torn too, keep within the arrays until
+		// the sequence check throws the copy out
+		if( snapshot.board_size > BoardSnapshot::max_board_size )
+		{
+			snapshot.board_size = BoardSnapshot::max_board_size;
+		}
+
+		snapshot.label_count = min( snapshot.label_count, BoardSnapshot::max_labels );
+
+		load_words( snapshot.words, words, snapshot.used_words() );
+		load_words( snapshot.numbers, numbers, snapshot.used_number_words() );
+		load_words( snapshot.marks, marks, snapshot.used_mark_words() );
+		load_words( snapshot.labels, labels, snapshot.label_count );
+		load_words( snapshot.info, info, BoardSnapshot::info_word_count );
+
+		atomic_thread_fence( memory_order_acquire );
+		if( sequence.load( memory_order_relaxed ) == begin )
+		{
+			return;
+		}
+	}
+}
+
+
+
+uint64_t SnapshotPublisher::get_revision() const
+{
+	return revision.load( memory_order_acquire );
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "goban.hh"
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+
+namespace go
+{
+	// SGF markup on a point, TR, CR, SQ and MA
+	enum Mark
+	{
+		MARK_NONE,
+		MARK_TRIANGLE,
+		MARK_CIRCLE,
+		MARK_SQUARE,
+		MARK_CROSS
+	};
+
+
+
+	// Compact copy of a position, 2 bits per point, small enough to be
+	// copied around freely and compared a word at a time
+	// - Besides the stones it carries what is drawn on top of them:
+	//   move numbers, markup, labels and a few lines of game info
+	// - Everything is packed into 64 bit words, so that it can go
+	//   through a SnapshotPublisher as is
+	struct BoardSnapshot
+	{
+		// Big enough for any board SGF can describe
+		static const size_t max_board_size = 52;
+		static const size_t max_points     = max_board_size * max_board_size;
+		static const size_t word_count     = (max_points * 2 + 63) / 64;
+		static const size_t no_move        = SIZE_MAX;
+
+		// 16 bits of move number and 4 bits of markup per point
+		static const size_t number_word_count = (max_points + 3) / 4;
+		static const size_t mark_word_count   = (max_points + 15) / 16;
+
+		// A label is its point in the low 16 bits and up to 6 bytes of
+		// UTF-8 text in the rest
+		static const size_t max_labels        = 32;
+		static const size_t max_label_length  = 6;
+
+		// UTF-8 text, lines separated by '\n'
+		static const size_t info_word_count   = 32;
+		static const size_t max_info_length   = info_word_count * 8 - 1;
+
+		uint64_t revision    = 0;
+		size_t   board_size  = 0;
+		size_t   last_move   = no_move; // Board index of the last move
+		size_t   move_number = 0;       // Moves played, passes included
+		size_t   label_count = 0;
+		uint64_t words[word_count] = {};
+		uint64_t numbers[number_word_count] = {};
+		uint64_t marks[mark_word_count] = {};
+		uint64_t labels[max_labels] = {};
+		uint64_t info[info_word_count] = {};
+
+
+		BoardSnapshot();
+
+		// Takes the position, the move numbers of the stones and the
+		// revision of the goban, throws if the board is too big
+		explicit BoardSnapshot( const Goban& goban );
+
+		Side get( size_t index ) const;
+		void set( size_t index, Side side );
+
+		// 0 for empty points and setup stones
+		size_t get_number( size_t index ) const;
+		void   set_number( size_t index, size_t number );
+
+		Mark get_mark( size_t index ) const;
+		void set_mark( size_t index, Mark mark );
+
+		// The text is cut short to fit, false when there's no room
+		// for another label
+		bool        add_label( size_t index, const std::string& text );
+		std::string get_label( size_t label, size_t& index ) const;
+
+		void        set_info( const std::string& text );
+		std::string get_info() const;
+
+		// Words covering the points of this board size
+		size_t used_words() const;
+		size_t used_number_words() const;
+		size_t used_mark_words() const;
+	};
+
+
+	// Publishes positions from one writer thread to any number of
+	// reader threads with a sequence lock
+	// - The writer never waits, readers retry when they overlap a write
+	// - Every field is an atomic, so a torn read is only ever retried,
+	//   never acted on
+	class SnapshotPublisher
+	{
+		std::atomic<uint64_t> sequence;
+		std::atomic<uint64_t> revision;
+		std::atomic<uint64_t> board_size;
+		std::atomic<uint64_t> last_move;
+		std::atomic<uint64_t> move_number;
+		std::atomic<uint64_t> label_count;
+		std::atomic<uint64_t> words[BoardSnapshot::word_count];
+		std::atomic<uint64_t> numbers[BoardSnapshot::number_word_count];
+		std::atomic<uint64_t> marks[BoardSnapshot::mark_word_count];
+		std::atomic<uint64_t> labels[BoardSnapshot::max_labels];
+		std::atomic<uint64_t> info[BoardSnapshot::info_word_count];
+
+
+	  public:
+		SnapshotPublisher();
+
+		// From the writer thread only
+		void publish( const BoardSnapshot& snapshot );
+
+		// A consistent copy of the last published snapshot
+		void read( BoardSnapshot& snapshot ) const;
+
+		// Revision of the last published snapshot, cheap enough to poll
+		uint64_t get_revision() const;
+
+		SnapshotPublisher( const SnapshotPublisher& ) = delete;
+		SnapshotPublisher& operator=( const SnapshotPublisher& ) = delete;
+	};
+}
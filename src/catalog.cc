@@ -0,0 +1,767 @@
+#include "catalog.hh"
+#include "corpus.hh"
+#include "game_loader.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <exception>
+#include <unordered_map>
+
+
+using namespace std;
+using namespace corpus;
+
+
+
+/*
+	File layout, native byte order:
+
+	CatalogHeader
+	CatalogDirectory[directory_count] level by level from the root
+	CatalogFile[file_count]           grouped by directory, sorted by path
+	char[strings_size]                paths and game info, not terminated
+ */
+
+struct CatalogHeader
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t directory_count;
+	uint64_t file_count;
+	int64_t  scan_time;
+	uint64_t directories_offset;
+	uint64_t files_offset;
+	uint64_t strings_offset;
+	uint64_t strings_size;
+};
+
+const char     catalog_magic[8] = { 'V', 'I', 'S', 'C', 'A', 'T', 'L', 'G' };
+const uint32_t catalog_version  = 1;
+
+// Listing is mostly waiting on the file system, more threads than cores
+// keep more requests in flight on network and spinning disks
+const size_t listing_threads = 8;
+
+
+
+corpus::Catalog::Catalog( const string& path )
+: mapped( path ),
+  directories( nullptr ),
+  files( nullptr ),
+  strings( nullptr ),
+  directories_size( 0 ),
+  files_size( 0 ),
+  scanned( 0 )
+{
+	CatalogHeader header;
+	if( mapped.size() < sizeof( header ) )
+	{
+		throw runtime_error( "'" + path + "' is not a catalog" );
+	}
+
+	memcpy( &header, mapped.data(), sizeof( header ) );
+	if( memcmp( header.magic, catalog_magic, sizeof( catalog_magic ) ) ||
+	    header.version != catalog_version )
+	{
+		throw runtime_error( "'" + path + "' is not a catalog" );
+	}
+
+	auto fits = [&]( uint64_t offset, uint64_t count, uint64_t item_size )
+	{
+		return offset <= mapped.size() &&
+		       count <= (mapped.size() - offset) / item_size;
+	};
+
+	if( !fits( header.directories_offset, header.directory_count, sizeof( CatalogDirectory ) ) ||
+	    !fits( header.files_offset, header.file_count, sizeof( CatalogFile ) ) ||
+	    !fits( header.strings_offset, header.strings_size, 1 ) ||
+	    header.directory_count == 0 )
+	{
+		throw runtime_error( "Catalog '" + path + "' is truncated" );
+	}
+
+	directories      = reinterpret_cast<const CatalogDirectory*>( mapped.data() + header.directories_offset );
+	files            = reinterpret_cast<const CatalogFile*>( mapped.data() + header.files_offset );
+	strings          = reinterpret_cast<const char*>( mapped.data() + header.strings_offset );
+	directories_size = header.directory_count;
+	files_size       = static_cast<size_t>( header.file_count );
+	scanned          = header.scan_time;
+
+	auto in_strings = [&]( uint64_t offset, uint64_t length )
+	{
+		return offset <= header.strings_size && length <= header.strings_size - offset;
+	};
+
+	for( size_t i = 0; i < directories_size; i++ )
+	{
+		auto& directory = directories[i];
+		if( !in_strings( directory.path_offset, directory.path_length ) ||
+		    directory.first_file > files_size ||
+		    directory.file_count > files_size - directory.first_file ||
+		    (i > 0 && directory.parent >= i) )
+		{
+			throw runtime_error( "Catalog '" + path + "' is corrupted" );
+		}
+	}
+
+	for( size_t i = 0; i < files_size; i++ )
+	{
+		if( !in_strings( files[i].path_offset, files[i].path_length ) ||
+		    !in_strings( files[i].info_offset, files[i].info_length ) )
+		{
+			throw runtime_error( "Catalog '" + path + "' is corrupted" );
+		}
+	}
+}
+
+
+
+size_t corpus::Catalog::directory_count() const
+{
+	return directories_size;
+}
+
+
+
+size_t corpus::Catalog::file_count() const
+{
+	return files_size;
+}
+
+
+
+const CatalogDirectory& corpus::Catalog::directory( size_t index ) const
+{
+	if( index >= directories_size )
+	{
+		throw runtime_error( "Catalog directory out of range" );
+	}
+
+	return directories[index];
+}
+
+
+
+const CatalogFile& corpus::Catalog::file( size_t index ) const
+{
+	if( index >= files_size )
+	{
+		throw runtime_error( "Catalog file out of range" );
+	}
+
+	return files[index];
+}
+
+
+
+string corpus::Catalog::directory_path( size_t index ) const
+{
+	auto& entry = directory( index );
+	return string( strings + entry.path_offset, entry.path_length );
+}
+
+
+
+string corpus::Catalog::file_path( size_t index ) const
+{
+	auto& entry = file( index );
+	return string( strings + entry.path_offset, entry.path_length );
+}
+
+
+
+string corpus::Catalog::file_info( size_t index ) const
+{
+	auto& entry = file( index );
+	return string( strings + entry.info_offset, entry.info_length );
+}
+
+
+
+string corpus::Catalog::root_path() const
+{
+	return directory_path( 0 );
+}
+
+
+
+int64_t corpus::Catalog::scan_time() const
+{
+	return scanned;
+}
+
+
+
+// A catalog entry being put together, before the strings are laid out
+struct ScannedFile
+{
+	string   path;
+	string   info;
+	uint32_t status       = CATALOG_UNCHECKED;
+	uint64_t size         = 0;
+	int64_t  modified     = 0;
+	uint64_t content_hash = 0;
+	uint32_t board_size   = 0;
+	uint32_t move_count   = 0;
+	bool     needs_parse  = false;
+	bool     known        = false; // Taken over from the old catalog
+};
+
+struct ScannedDirectory
+{
+	string              path;
+	uint32_t            parent   = CatalogDirectory::no_parent;
+	int64_t             modified = 0;
+	bool                listed   = false;
+	bool                failed   = false;
+	vector<ScannedFile> files;
+	vector<string>      subdirectories;
+};
+
+
+
+static ScannedFile file_from_catalog( const Catalog& catalog, size_t index, bool parse_files )
+{
+	auto& entry = catalog.file( index );
+
+	ScannedFile file;
+	file.path         = catalog.file_path( index );
+	file.info         = catalog.file_info( index );
+	file.status       = entry.status;
+	file.size         = entry.size;
+	file.modified     = entry.modified;
+	file.content_hash = entry.content_hash;
+	file.board_size   = entry.board_size;
+	file.move_count   = entry.move_count;
+	file.needs_parse  = parse_files && entry.status == CATALOG_UNCHECKED;
+	file.known        = true;
+	return file;
+}
+
+
+
+// Known to be a game, or at least not known not to be
+static bool is_playable( const ScannedFile& file )
+{
+	return !file.needs_parse &&
+	       (file.status == CATALOG_GAME || file.status == CATALOG_UNCHECKED);
+}
+
+
+
+// Lists the directory again, keeping the old entries of the files
+// that still have the same size and modification time
+static void list_scanned_directory(
+	ScannedDirectory& directory,
+	const Catalog*    old_catalog,
+	size_t            old_index,
+	bool              parse_files
+)
+{
+	unordered_map<string, size_t> old_files;
+	if( old_catalog )
+	{
+		auto& old_directory = old_catalog->directory( old_index );
+		for( auto i = old_directory.first_file; i < old_directory.first_file + old_directory.file_count; i++ )
+		{
+			old_files[old_catalog->file_path( static_cast<size_t>( i ) )] = static_cast<size_t>( i );
+		}
+	}
+
+	for( auto& item : tools::get_directory_listing( directory.path + "/" ) )
+	{
+		if( item.name == "." || item.name == ".." )
+		{
+			continue;
+		}
+
+		auto path = directory.path + "/" + item.name;
+		if( item.type == tools::DirectoryItemType::DIRECTORY )
+		{
+			directory.subdirectories.push_back( move( path ) );
+			continue;
+		}
+
+		if( !tools::has_extension( item.name, ".sgf" ) )
+		{
+			continue;
+		}
+
+		tools::FileInfo info;
+		try
+		{
+			info = tools::get_file_info( path );
+		}
+		catch( runtime_error& )
+		{
+			continue;
+		}
+
+		auto old_file = old_files.find( path );
+		if( old_file != old_files.end() )
+		{
+			auto& entry = old_catalog->file( old_file->second );
+			if( entry.size == info.size && entry.modified == info.modified )
+			{
+				directory.files.push_back( file_from_catalog( *old_catalog, old_file->second, parse_files ) );
+				continue;
+			}
+		}
+
+		ScannedFile file;
+		file.path        = move( path );
+		file.size        = info.size;
+		file.modified    = info.modified;
+		file.needs_parse = parse_files;
+		directory.files.push_back( move( file ) );
+	}
+
+	sort( directory.files.begin(), directory.files.end(),
+		[]( const ScannedFile& a, const ScannedFile& b ) { return a.path < b.path; } );
+	sort( directory.subdirectories.begin(), directory.subdirectories.end() );
+}
+
+
+
+// Hashes and parses the file from one read of it
+static void parse_scanned_file( ScannedFile& file )
+{
+	file.needs_parse = false;
+
+	try
+	{
+		tools::MappedFile contents{ file.path };
+
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		for( size_t i = 0; i < contents.size(); i++ )
+		{
+			hash = (hash ^ contents.data()[i]) * 0x100000001b3ULL;
+		}
+
+		file.content_hash = hash;
+
+		auto bytes = string( reinterpret_cast<const char*>( contents.data() ), contents.size() );
+		auto game  = load_game( file.path, parse_sgf_data( move( bytes ) ) );
+
+		file.board_size = static_cast<uint32_t>( game.board_size );
+		file.move_count = static_cast<uint32_t>( game.moves.size() );
+		file.info       = move( game.info );
+		file.status     = game.moves.empty() ? CATALOG_EMPTY : CATALOG_GAME;
+	}
+	catch( exception& )
+	{
+		file.status = CATALOG_BROKEN;
+	}
+}
+
+
+
+template<typename T>
+static void write_items( ofstream& out, const T* items, size_t count )
+{
+	out.write( reinterpret_cast<const char*>( items ), count * sizeof( T ) );
+	if( !out )
+	{
+		throw runtime_error( "Couldn't write to the catalog file" );
+	}
+}
+
+
+
+static void write_catalog(
+	const string&                   path,
+	const vector<ScannedDirectory>& scanned,
+	int64_t                         scan_time
+)
+{
+	vector<CatalogDirectory> directories;
+	vector<CatalogFile>      files;
+	string                   strings;
+
+	auto add_string = [&]( const string& text, uint64_t& offset, uint32_t& length )
+	{
+		offset = strings.size();
+		length = static_cast<uint32_t>( text.size() );
+		strings += text;
+	};
+
+	for( auto& directory : scanned )
+	{
+		CatalogDirectory entry;
+		memset( &entry, 0, sizeof( entry ) );
+		add_string( directory.path, entry.path_offset, entry.path_length );
+		entry.parent     = directory.parent;
+		entry.modified   = directory.modified;
+		entry.first_file = files.size();
+		entry.file_count = directory.files.size();
+		directories.push_back( entry );
+
+		for( auto& file : directory.files )
+		{
+			CatalogFile file_entry;
+			memset( &file_entry, 0, sizeof( file_entry ) );
+			add_string( file.path, file_entry.path_offset, file_entry.path_length );
+			add_string( file.info, file_entry.info_offset, file_entry.info_length );
+			file_entry.status       = file.status;
+			file_entry.size         = file.size;
+			file_entry.modified     = file.modified;
+			file_entry.content_hash = file.content_hash;
+			file_entry.board_size   = file.board_size;
+			file_entry.move_count   = file.move_count;
+			files.push_back( file_entry );
+		}
+	}
+
+	ofstream out( path, ios_base::out | ios_base::binary | ios_base::trunc );
+	if( !out.is_open() )
+	{
+		throw runtime_error( "Couldn't create '" + path + "'" );
+	}
+
+	CatalogHeader header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, catalog_magic, sizeof( catalog_magic ) );
+	header.version            = catalog_version;
+	header.directory_count    = static_cast<uint32_t>( directories.size() );
+	header.file_count         = files.size();
+	header.scan_time          = scan_time;
+	header.directories_offset = sizeof( header );
+	header.files_offset       = header.directories_offset + directories.size() * sizeof( CatalogDirectory );
+	header.strings_offset     = header.files_offset + files.size() * sizeof( CatalogFile );
+	header.strings_size       = strings.size();
+
+	write_items( out, &header, 1 );
+	write_items( out, directories.data(), directories.size() );
+	write_items( out, files.data(), files.size() );
+	write_items( out, strings.data(), strings.size() );
+}
+
+
+
+CatalogUpdate corpus::update_catalog(
+	const string&         root_directory,
+	const string&         catalog_path,
+	const CatalogOptions& options
+)
+{
+	CatalogUpdate update;
+
+	// Directories modified in the same second as the last scan started
+	// may have changed after it listed them, so only older ones count
+	// as unchanged
+	auto scan_time = chrono::duration_cast<chrono::seconds>(
+		chrono::system_clock::now().time_since_epoch() ).count();
+
+	auto cancelled = [&]()
+	{
+		return options.cancel && options.cancel->load();
+	};
+
+
+	unique_ptr<Catalog> old_catalog;
+	try
+	{
+		tools::get_file_info( catalog_path );
+		old_catalog.reset( new Catalog( catalog_path ) );
+		if( old_catalog->root_path() != root_directory )
+		{
+			wcout << "Catalog '" << catalog_path.c_str() << "' is for another directory, rebuilding it" << endl;
+			old_catalog.reset();
+		}
+	}
+	catch( runtime_error& error )
+	{
+		// Missing is fine, the first scan creates it
+		bool exists = true;
+		try
+		{
+			tools::get_file_info( catalog_path );
+		}
+		catch( runtime_error& )
+		{
+			exists = false;
+		}
+
+		if( exists )
+		{
+			wcerr << error.what() << ", rebuilding it" << endl;
+		}
+	}
+
+	unordered_map<string, size_t> old_directories;
+	vector<vector<size_t>>        old_children;
+	if( old_catalog )
+	{
+		old_children.resize( old_catalog->directory_count() );
+		for( size_t i = 0; i < old_catalog->directory_count(); i++ )
+		{
+			old_directories[old_catalog->directory_path( i )] = i;
+
+			auto parent = old_catalog->directory( i ).parent;
+			if( parent != CatalogDirectory::no_parent )
+			{
+				old_children[parent].push_back( i );
+			}
+		}
+	}
+
+
+	// Walk the tree a level at a time, every level in parallel
+	vector<ScannedDirectory> scanned;
+	string                   root_error;
+	{
+		ScannedDirectory root;
+		root.path = root_directory;
+		scanned.push_back( move( root ) );
+	}
+
+	for( size_t level_begin = 0; level_begin < scanned.size() && !cancelled(); )
+	{
+		auto level_end = scanned.size();
+
+		tools::parallel_for( level_end - level_begin, [&]( size_t i, size_t )
+		{
+			auto& directory = scanned[level_begin + i];
+			if( cancelled() )
+			{
+				return;
+			}
+
+			auto old_directory = old_directories.find( directory.path );
+			bool known         = old_directory != old_directories.end();
+
+			auto keep_old_entries = [&]()
+			{
+				auto& old_entry = old_catalog->directory( old_directory->second );
+				for( auto file = old_entry.first_file; file < old_entry.first_file + old_entry.file_count; file++ )
+				{
+					directory.files.push_back( file_from_catalog( *old_catalog, static_cast<size_t>( file ), options.parse_files ) );
+				}
+
+				for( auto child : old_children[old_directory->second] )
+				{
+					directory.subdirectories.push_back( old_catalog->directory_path( child ) );
+				}
+			};
+
+			try
+			{
+				directory.modified = tools::get_file_info( directory.path ).modified;
+
+				if( known && !options.full_rescan &&
+				    old_catalog->directory( old_directory->second ).modified == directory.modified &&
+				    directory.modified < old_catalog->scan_time() )
+				{
+					keep_old_entries();
+					return;
+				}
+
+				directory.listed = true;
+				list_scanned_directory( directory, known ? old_catalog.get() : nullptr,
+				                        known ? old_directory->second : 0, options.parse_files );
+			}
+			catch( runtime_error& error )
+			{
+				// Gone since the parent was listed, or unreadable
+				if( level_begin + i == 0 )
+				{
+					root_error = error.what();
+					return;
+				}
+
+				// Keep what the old catalog had, with no modification time so the next scan lists it again
+				directory.modified = 0;
+				directory.listed   = false;
+				directory.failed   = true;
+				directory.files.clear();
+				directory.subdirectories.clear();
+				if( known )
+				{
+					keep_old_entries();
+				}
+			}
+		}, max( tools::worker_thread_count(), listing_threads ) );
+
+		if( !root_error.empty() )
+		{
+			throw runtime_error( root_error );
+		}
+
+		vector<string> level_games;
+		for( auto index = level_begin; index < level_end; index++ )
+		{
+			for( auto& file : scanned[index].files )
+			{
+				if( options.on_games && is_playable( file ) )
+				{
+					level_games.push_back( file.path );
+				}
+			}
+
+			auto subdirectories = move( scanned[index].subdirectories );
+			for( auto& path : subdirectories )
+			{
+				ScannedDirectory child;
+				child.path   = move( path );
+				child.parent = static_cast<uint32_t>( index );
+				scanned.push_back( move( child ) );
+			}
+
+			if( scanned[index].failed )
+			{
+				update.directories_failed++;
+			}
+			else if( scanned[index].listed )
+			{
+				update.directories_listed++;
+			}
+			else
+			{
+				update.directories_kept++;
+			}
+		}
+
+		if( !level_games.empty() )
+		{
+			options.on_games( level_games );
+		}
+
+		level_begin = level_end;
+	}
+
+
+	// Parse what's new or changed
+	vector<ScannedFile*> to_parse;
+	for( auto& directory : scanned )
+	{
+		for( auto& file : directory.files )
+		{
+			if( file.needs_parse )
+			{
+				to_parse.push_back( &file );
+			}
+			else if( file.known )
+			{
+				update.files_kept++;
+			}
+			else
+			{
+				update.files_unchecked++;
+			}
+		}
+	}
+
+	tools::parallel_for( to_parse.size(), [&]( size_t i, size_t )
+	{
+		if( !cancelled() )
+		{
+			parse_scanned_file( *to_parse[i] );
+		}
+	} );
+
+	if( cancelled() )
+	{
+		update.cancelled = true;
+		return update;
+	}
+
+	vector<string> parsed_games;
+	for( auto file : to_parse )
+	{
+		update.files_parsed++;
+		if( file->status == CATALOG_BROKEN )
+		{
+			update.files_broken++;
+		}
+		else if( options.on_games && is_playable( *file ) )
+		{
+			parsed_games.push_back( file->path );
+		}
+	}
+
+	if( !parsed_games.empty() )
+	{
+		options.on_games( parsed_games );
+	}
+
+
+	auto temporary_path = catalog_path + ".tmp";
+	write_catalog( temporary_path, scanned, scan_time );
+
+	// Release the old mapping before replacing the file
+	old_catalog.reset();
+	remove( catalog_path.c_str() );
+	if( rename( temporary_path.c_str(), catalog_path.c_str() ) )
+	{
+		throw runtime_error( "Couldn't replace '" + catalog_path + "'" );
+	}
+
+	return update;
+}
+
+
+
+vector<string> corpus::catalog_games(
+	const string& root_directory,
+	const string& catalog_path
+)
+{
+	vector<string> games;
+
+	try
+	{
+		Catalog catalog{ catalog_path };
+		if( catalog.root_path() != root_directory )
+		{
+			return games;
+		}
+
+		for( size_t i = 0; i < catalog.file_count(); i++ )
+		{
+			auto status = catalog.file( i ).status;
+			if( status == CATALOG_GAME || status == CATALOG_UNCHECKED )
+			{
+				games.push_back( catalog.file_path( i ) );
+			}
+		}
+	}
+	catch( runtime_error& )
+	{
+		games.clear();
+	}
+
+	return games;
+}
+
+
+
+int corpus::build_catalog_command( const vector<string>& args )
+{
+	if( args.size() < 2 || args.size() > 3 || (args.size() == 3 && args[2] != "--full") )
+	{
+		wcout << "Usage: --build-catalog <directory> <catalog file> [--full]" << endl;
+		return 1;
+	}
+
+	CatalogOptions options;
+	options.full_rescan = args.size() == 3;
+
+	auto start   = chrono::steady_clock::now();
+	auto update  = update_catalog( args[0], args[1], options );
+	auto elapsed = chrono::duration<double>( chrono::steady_clock::now() - start );
+
+	wcout << "Catalog updated in " << elapsed.count() << " s: "
+	      << update.directories_listed << " directories listed, "
+	      << update.directories_kept << " unchanged, "
+	      << update.directories_failed << " unreadable, "
+	      << update.files_parsed << " files parsed ("
+	      << update.files_broken << " broken), "
+	      << update.files_kept << " kept" << endl;
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "common_tools.hh"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// On-disk catalog of a game collection, so that a start doesn't have to
+// walk and parse the whole tree again
+// - Every directory with its modification time, every game file with
+//   its size, modification time, content hash, parse status and the
+//   root metadata shown with the game
+// - Mapped straight from the file, reading it allocates nothing
+// - Updating one only lists the directories modified since the last
+//   scan, the others keep their files as they were. A file changed in
+//   place in an otherwise untouched directory needs a full rescan.
+// - Files that couldn't be parsed keep their status and aren't opened
+//   again until they change
+// - A scan can leave out the parsing, like the viewer's does, as it
+//   parses the games it plays anyway. New files are then unchecked and
+//   count as games until a scan that parses comes along.
+namespace corpus
+{
+	enum CatalogFileStatus
+	{
+		CATALOG_GAME      = 0, // Parsed fine, has moves
+		CATALOG_BROKEN    = 1, // Couldn't be parsed, or isn't a go game
+		CATALOG_EMPTY     = 2, // No moves to replay
+		CATALOG_UNCHECKED = 3  // Found by a scan that didn't parse it
+	};
+
+	struct CatalogDirectory
+	{
+		uint64_t path_offset;
+		uint32_t path_length;
+		uint32_t parent;     // no_parent for the root
+		int64_t  modified;   // Seconds since the epoch
+		uint64_t first_file; // Files of a directory are consecutive
+		uint64_t file_count;
+
+		static const uint32_t no_parent = UINT32_MAX;
+	};
+
+	struct CatalogFile
+	{
+		uint64_t path_offset;
+		uint32_t path_length;
+		uint32_t status;       // CatalogFileStatus
+		uint64_t size;
+		int64_t  modified;
+		uint64_t content_hash; // FNV-1a of the bytes
+		uint32_t board_size;
+		uint32_t move_count;
+		uint64_t info_offset;  // Players, event, date and result,
+		uint32_t info_length;  // see game_info_text()
+		uint32_t reserved;
+	};
+
+
+
+	class Catalog
+	{
+		tools::MappedFile       mapped;
+		const CatalogDirectory *directories;
+		const CatalogFile      *files;
+		const char             *strings;
+		size_t                  directories_size;
+		size_t                  files_size;
+		int64_t                 scanned;
+
+
+	  public:
+		// Throws if the file isn't a catalog of this version
+		Catalog( const std::string& path );
+
+		size_t directory_count() const;
+		size_t file_count() const;
+
+		const CatalogDirectory& directory( size_t index ) const;
+		const CatalogFile&      file( size_t index ) const;
+
+		std::string directory_path( size_t index ) const;
+		std::string file_path( size_t index ) const;
+		std::string file_info( size_t index ) const;
+
+		// The root is the first directory
+		std::string root_path() const;
+
+		// When the scan that wrote the catalog started, seconds since
+		// the epoch
+		int64_t scan_time() const;
+	};
+
+
+
+	struct CatalogOptions
+	{
+		bool                     full_rescan = false;   // List every directory
+		bool                     parse_files = true;    // Or leave new ones unchecked
+		const std::atomic<bool> *cancel      = nullptr; // Stops without writing
+
+		// Called with the games found, as the scan goes through each
+		// level of the tree and with the ones parsed at the end. The
+		// files known to be broken or empty are left out.
+		std::function<void( std::vector<std::string>& )> on_games;
+	};
+
+	struct CatalogUpdate
+	{
+		size_t directories_listed = 0;
+		size_t directories_kept   = 0;
+		size_t directories_failed = 0; // Kept from the old catalog, if known
+		size_t files_parsed       = 0;
+		size_t files_kept         = 0;
+		size_t files_unchecked    = 0; // Found without parsing them
+		size_t files_broken       = 0; // Of the parsed ones
+		bool   cancelled          = false;
+	};
+
+	// Creates the catalog or brings it up to date with the directory
+	// tree, replacing the file. A catalog of another root is rebuilt.
+	CatalogUpdate update_catalog(
+		const std::string&    root_directory,
+		const std::string&    catalog_path,
+		const CatalogOptions& options = {}
+	);
+
+	// The games of the catalog file, including the unchecked ones,
+	// empty if there's no usable catalog for the root
+	std::vector<std::string> catalog_games(
+		const std::string& root_directory,
+		const std::string& catalog_path
+	);
+
+
+	int build_catalog_command( const std::vector<std::string>& args );
+}
@@ -1,5 +1,7 @@
 #include "common_tools.hh"
 
+#include <cctype>
+
 using namespace std;
 using namespace tools;
 
@@ -61,34 +63,336 @@ vector<DirectoryItem> tools::get_directory_listing( string path )
 #else
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 vector<DirectoryItem> tools::get_directory_listing( string path )
 {
-  vector<DirectoryItem> items;
+	vector<DirectoryItem> items;
 
-  DIR *handle;
-  dirent *data;
-  handle = opendir( path.c_str() );
-  if( handle == nullptr )
-  {
-    throw runtime_error( "Couldn't get directory listing for '" + path + "'" );
-  }
+	auto handle = opendir( path.c_str() );
+	if( handle == nullptr )
+	{
+		throw runtime_error( "Couldn't get directory listing for '" + path + "'" );
+	}
 
-  while( (data = readdir( handle )) != nullptr )
-  {
-    auto type = (data->d_type == DT_DIR ? DirectoryItemType::DIRECTORY : DirectoryItemType::FILE);
-    
-    items.push_back({
-        type,
-        data->d_name,
-        0, // Filesize is just ignored, atm
-        0
-    });
-  }
+	auto defer_close_handle = make_defer( [&]() {
+		closedir( handle );
+	} );
+
+	dirent *data;
+	while( (data = readdir( handle )) != nullptr )
+	{
+		auto type = data->d_type == DT_DIR ? DirectoryItemType::DIRECTORY : DirectoryItemType::FILE;
+
+		// The type where the file system leaves it unknown, without
+		// following links so that a link to a directory isn't one
+		struct stat file_data;
+		if( data->d_type == DT_UNKNOWN &&
+		    !fstatat( dirfd( handle ), data->d_name, &file_data, AT_SYMLINK_NOFOLLOW ) &&
+		    S_ISDIR( file_data.st_mode ) )
+		{
+			type = DirectoryItemType::DIRECTORY;
+		}
 
-  return items;
+		// Sizes of files, through links
+		uint64_t size = 0;
+		if( type == DirectoryItemType::FILE &&
+		    !fstatat( dirfd( handle ), data->d_name, &file_data, 0 ) )
+		{
+			size = static_cast<uint64_t>( file_data.st_size );
+		}
+
+		items.push_back( {
+			type,
+			data->d_name,
+			static_cast<size_t>( size >> 32 ),
+			static_cast<size_t>( size & 0xffffffff )
+		} );
+	}
+
+	return items;
 }
 
 #endif
 
+
+
+
+/* Platform specific file helpers */
+
+#ifdef _WIN32
+
+FileInfo tools::get_file_info( const string& path )
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if( !GetFileAttributesExA( path.c_str(), GetFileExInfoStandard, &data ) )
+	{
+		throw runtime_error( "Couldn't stat '" + path + "'" );
+	}
+
+	// FILETIME is in 100ns intervals since 1601-01-01
+	uint64_t ticks = (uint64_t( data.ftLastWriteTime.dwHighDateTime ) << 32)
+	               | data.ftLastWriteTime.dwLowDateTime;
+
+	return {
+		(uint64_t( data.nFileSizeHigh ) << 32) | data.nFileSizeLow,
+		static_cast<int64_t>( ticks / 10000000ULL ) - 11644473600LL
+	};
+}
+
+
+
+void tools::create_directories( const string& path )
+{
+	for( size_t end = 0; end != string::npos; )
+	{
+		end = path.find_first_of( "/\\", end + 1 );
+
+		// Drive letters aren't directories to create
+		auto directory = path.substr( 0, end );
+		if( directory.empty() || directory.back() == ':' )
+		{
+			continue;
+		}
+
+		if( !CreateDirectoryA( directory.c_str(), nullptr ) &&
+		    GetLastError() != ERROR_ALREADY_EXISTS )
+		{
+			throw runtime_error( "Couldn't create directory '" + directory + "'" );
+		}
+	}
+}
+
+
+
+MappedFile::MappedFile( const string& path )
+: MappedFile()
+{
+	auto file = CreateFileA(
+		path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+	);
+	if( file == INVALID_HANDLE_VALUE )
+	{
+		throw runtime_error( "Couldn't open '" + path + "' for mapping" );
+	}
+
+	auto defer_close_file = make_defer( [&]() {
+		CloseHandle( file );
+	} );
+
+	LARGE_INTEGER file_size;
+	if( !GetFileSizeEx( file, &file_size ) )
+	{
+		throw runtime_error( "Couldn't get the size of '" + path + "'" );
+	}
+
+	is_mapped = true;
+	if( file_size.QuadPart == 0 )
+	{
+		return;
+	}
+
+	auto mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if( !mapping )
+	{
+		throw runtime_error( "Couldn't map '" + path + "'" );
+	}
+
+	auto defer_close_mapping = make_defer( [&]() {
+		CloseHandle( mapping );
+	} );
+
+	auto view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	if( !view )
+	{
+		throw runtime_error( "Couldn't map a view of '" + path + "'" );
+	}
+
+	mapped_data = static_cast<const uint8_t*>( view );
+	mapped_size = static_cast<size_t>( file_size.QuadPart );
+}
+
+
+
+void MappedFile::unmap()
+{
+	if( mapped_data )
+	{
+		UnmapViewOfFile( mapped_data );
+	}
+
+	mapped_data = nullptr;
+	mapped_size = 0;
+	is_mapped   = false;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+FileInfo tools::get_file_info( const string& path )
+{
+	struct stat data;
+	if( stat( path.c_str(), &data ) )
+	{
+		throw runtime_error( "Couldn't stat '" + path + "'" );
+	}
+
+	return {
+		static_cast<uint64_t>( data.st_size ),
+		static_cast<int64_t>( data.st_mtime )
+	};
+}
+
+
+
+void tools::create_directories( const string& path )
+{
+	for( size_t end = 0; end != string::npos; )
+	{
+		end = path.find( '/', end + 1 );
+
+		auto directory = path.substr( 0, end );
+		if( directory.empty() )
+		{
+			continue;
+		}
+
+		if( mkdir( directory.c_str(), 0755 ) && errno != EEXIST )
+		{
+			throw runtime_error( "Couldn't create directory '" + directory + "'" );
+		}
+	}
+}
+
+
+
+MappedFile::MappedFile( const string& path )
+: MappedFile()
+{
+	auto file = open( path.c_str(), O_RDONLY );
+	if( file < 0 )
+	{
+		throw runtime_error( "Couldn't open '" + path + "' for mapping" );
+	}
+
+	auto defer_close_file = make_defer( [&]() {
+		close( file );
+	} );
+
+	struct stat data;
+	if( fstat( file, &data ) )
+	{
+		throw runtime_error( "Couldn't get the size of '" + path + "'" );
+	}
+
+	is_mapped = true;
+	if( data.st_size == 0 )
+	{
+		return;
+	}
+
+	auto view = mmap( nullptr, data.st_size, PROT_READ, MAP_SHARED, file, 0 );
+	if( view == MAP_FAILED )
+	{
+		throw runtime_error( "Couldn't map '" + path + "'" );
+	}
+
+	mapped_data = static_cast<const uint8_t*>( view );
+	mapped_size = static_cast<size_t>( data.st_size );
+}
+
+
+
+void MappedFile::unmap()
+{
+	if( mapped_data )
+	{
+		munmap( const_cast<uint8_t*>( mapped_data ), mapped_size );
+	}
+
+	mapped_data = nullptr;
+	mapped_size = 0;
+	is_mapped   = false;
+}
+
+#endif
+
+
+
+/* Shared helpers */
+
+bool tools::has_extension( const string& name, const string& extension )
+{
+	if( name.size() < extension.size() )
+	{
+		return false;
+	}
+
+	auto offset = name.size() - extension.size();
+	for( size_t i = 0; i < extension.size(); i++ )
+	{
+		if( tolower( name[offset + i] ) != tolower( extension[i] ) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+
+MappedFile::MappedFile()
+: mapped_data(nullptr), mapped_size(0), is_mapped(false)
+{
+}
+
+
+
+MappedFile::MappedFile( MappedFile&& other )
+: MappedFile()
+{
+	using std::swap;
+	swap( mapped_data, other.mapped_data );
+	swap( mapped_size, other.mapped_size );
+	swap( is_mapped,   other.is_mapped );
+}
+
+
+
+MappedFile& MappedFile::operator=( MappedFile&& other )
+{
+	using std::swap;
+	swap( mapped_data, other.mapped_data );
+	swap( mapped_size, other.mapped_size );
+	swap( is_mapped,   other.is_mapped );
+	return *this;
+}
+
+
+
+MappedFile::~MappedFile()
+{
+	unmap();
+}
+
+
+
+size_t tools::worker_thread_count( size_t thread_count )
+{
+	if( thread_count )
+	{
+		return thread_count;
+	}
+
+	auto hardware_threads = thread::hardware_concurrency();
+	return hardware_threads ? hardware_threads : 1;
+}
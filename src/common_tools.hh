@@ -1,7 +1,12 @@
 #pragma once
 
-#include <iostream>
+#include <atomic>
+#include <string>
+#include <thread>
 #include <vector>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
 #include <type_traits>
 
 namespace tools
@@ -110,5 +115,164 @@ struct DirectoryItem
 
 std::vector<DirectoryItem> get_directory_listing( std::string path );
 
+
+// Case insensitive check for a file name extension, eg. ".sgf"
+bool has_extension( const std::string& name, const std::string& extension );
+
+
+// File size and modification time, throws if the file can't be stat'd
+struct FileInfo
+{
+	uint64_t size;
+	int64_t  modified; // Seconds since the epoch
+};
+
+FileInfo get_file_info( const std::string& path );
+
+
+// Creates the directory and any missing parents, throws on failure
+void create_directories( const std::string& path );
+
+
+
+// Read-only memory mapping of a whole file
+// - An empty file maps to data() == nullptr and size() == 0
+struct MappedFile
+{
+	MappedFile();
+	MappedFile( const std::string& path );
+	~MappedFile();
+
+	MappedFile( MappedFile&& );
+	MappedFile& operator=( MappedFile&& );
+
+	const uint8_t* data() const { return mapped_data; }
+	size_t         size() const { return mapped_size; }
+	bool           is_open() const { return is_mapped; }
+
+
+	// Delete potentially dangerous constructors and operators
+	MappedFile( MappedFile& ) = delete;
+	MappedFile& operator=( MappedFile& ) = delete;
+
+
+private:
+	void unmap();
+
+	const uint8_t* mapped_data;
+	size_t         mapped_size;
+	bool           is_mapped;
+};
+
+
+
+// Parallel for
+// - Calls func( index, thread_index ) for every index in [0, count)
+//   from a pool of worker threads, handing out indices in order
+// - thread_count 0 uses every hardware thread
+// - func must not throw, catch inside it
+size_t worker_thread_count( size_t thread_count = 0 );
+
+template<typename F>
+void parallel_for( size_t count, F func, size_t thread_count = 0 )
+{
+	thread_count = std::min( worker_thread_count( thread_count ), count );
+
+	std::atomic<size_t> next_index{ 0 };
+	auto worker = [&]( size_t thread_index )
+	{
+		for( auto index = next_index++; index < count; index = next_index++ )
+		{
+			func( index, thread_index );
+		}
+	};
+
+	if( thread_count <= 1 )
+	{
+		worker( 0 );
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	for( size_t i = 0; i < thread_count; i++ )
+	{
+		threads.emplace_back( worker, i );
+	}
+
+	for( auto& thread : threads )
+	{
+		thread.join();
+	}
+}
+
+
+
+// Single producer, single consumer queue
+// - Lock-free, one thread pushes and one other thread pops
+// - The capacity is fixed, pushing to a full queue fails instead of
+//   waiting so that the producer never stalls on the consumer
+// - Popping swaps the element out, so elements that own memory keep
+//   reusing it instead of allocating on every push
+template<typename T>
+struct SpscQueue
+{
+	SpscQueue( size_t capacity )
+	: slots( capacity ? capacity : 1 ),
+	  head( 0 ),
+	  tail( 0 )
+	{
+	}
+
+
+	bool try_push( const T& value )
+	{
+		auto write = tail.load( std::memory_order_relaxed );
+		if( write - head.load( std::memory_order_acquire ) == slots.size() )
+		{
+			return false;
+		}
+
+		slots[write % slots.size()] = value;
+		tail.store( write + 1, std::memory_order_release );
+		return true;
+	}
+
+
+	bool try_pop( T& value )
+	{
+		auto read = head.load( std::memory_order_relaxed );
+		if( read == tail.load( std::memory_order_acquire ) )
+		{
+			return false;
+		}
+
+		using std::swap;
+		swap( value, slots[read % slots.size()] );
+		head.store( read + 1, std::memory_order_release );
+		return true;
+	}
+
+
+	bool empty() const
+	{
+		return head.load( std::memory_order_acquire ) ==
+		       tail.load( std::memory_order_acquire );
+	}
+
+
+	// Delete potentially dangerous constructors and operators
+	SpscQueue( SpscQueue& ) = delete;
+	SpscQueue& operator=( SpscQueue& ) = delete;
+
+
+private:
+	std::vector<T> slots;
+
+	// Padded apart, each thread writes only one of them
+	std::atomic<size_t> head;
+	char                padding[64];
+	std::atomic<size_t> tail;
+};
+
 }; // namespace tools
 
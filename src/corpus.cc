@@ -0,0 +1,115 @@
+#include "corpus.hh"
+#include "common_tools.hh"
+#include "directory_walker.hh"
+#include "profiler.hh"
+
+#include <fstream>
+#include <algorithm>
+#include <iostream>
+#include <exception>
+
+
+using namespace std;
+
+
+
+// Sorted, so that what's built from the list comes out the same
+// however the threads raced
+vector<string> find_sorted_files( const string& root_directory, const string& extension )
+{
+	PROFILE_SCOPE( "directory walk" );
+
+	vector<string> files;
+	tools::walk_directory( root_directory, extension, false, [&]( vector<tools::FoundFile>& found )
+	{
+		for( auto& file : found )
+		{
+			files.push_back( move( file.path ) );
+		}
+		return true;
+	} );
+
+	sort( files.begin(), files.end() );
+	return files;
+}
+
+
+
+vector<string> corpus::find_files( const string& root_directory )
+{
+	return find_sorted_files( root_directory, "" );
+}
+
+
+
+vector<string> corpus::find_game_files( const string& root_directory )
+{
+	return find_sorted_files( root_directory, ".sgf" );
+}
+
+
+
+string read_file_bytes( const string& filename )
+{
+	PROFILE_SCOPE( "read file" );
+
+	ifstream in( filename, ios_base::in | ios_base::binary );
+	if( !in.is_open() )
+	{
+		throw runtime_error( "Couldn't open the file!" );
+	}
+
+	return string{ istreambuf_iterator<char>( in ),
+	               istreambuf_iterator<char>() };
+}
+
+
+
+sgf::Node corpus::read_sgf_file( const string& path )
+{
+	return parse_sgf_data( read_file_bytes( path ) );
+}
+
+
+
+sgf::Node corpus::parse_sgf_data( string bytes )
+{
+	// Get rid of the BOM if it's there
+	if( bytes.compare( 0, 3, "\xef\xbb\xbf" ) == 0 )
+	{
+		bytes = bytes.substr( 3 );
+	}
+
+	wstring data{ bytes.begin(), bytes.end() };
+	auto root = sgf::read_game_tree( data );
+
+	//sgf::print_game_tree( root );
+
+	// If we got the GM property, check that the value is correct
+	auto game_property = root.properties[L"GM"];
+	if( game_property.size() )
+	{
+		auto game_type = sgf::property_value_to<int>( game_property[0] );
+		if( game_type != 1 )
+		{
+			wcout << "Error: Wrong game type(" << game_type << ") expected 1 for go" << endl;
+			throw runtime_error( "Wrong game type" );
+		}
+	}
+
+	return root;
+}
+
+
+
+sgf::MainLine corpus::read_main_line_file( const string& path )
+{
+	auto line = sgf::read_main_line( read_file_bytes( path ) );
+
+	if( line.game_type != 1 )
+	{
+		throw runtime_error( "Wrong game type" );
+	}
+
+	return line;
+}
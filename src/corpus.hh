@@ -0,0 +1,79 @@
+#pragma once
+
+#include "sgf.hh"
+#include "goban.hh"
+
+#include <string>
+#include <vector>
+
+
+// Game collections on disk
+namespace corpus
+{
+	// Lists every file under the directory, sorted. The tree is walked
+	// in parallel, see tools::walk_directory() for going through the
+	// files as they're found.
+	std::vector<std::string> find_files( const std::string& root_directory );
+
+	// Only the files with the .sgf extension
+	std::vector<std::string> find_game_files( const std::string& root_directory );
+
+
+	// Parses the whole game tree, throws if the file can't be read
+	// or if it isn't a go game
+	sgf::Node read_sgf_file( const std::string& path );
+
+	// The same for the contents of a file already read
+	sgf::Node parse_sgf_data( std::string bytes );
+
+	// Reads only the main line, throws like read_sgf_file()
+	sgf::MainLine read_main_line_file( const std::string& path );
+
+
+	// Replays the main line on a fresh board, calling
+	// on_position( goban, move_number, changed_points ) once for the
+	// setup stones as move 0 and then after every move.
+	// Passes don't change the board, so they come with no changed points.
+	template<typename F>
+	void replay_main_line( const sgf::MainLine& line, F on_position )
+	{
+		go::Goban goban{ line.board_size };
+		std::vector<go::Stone> changed_points;
+
+		auto place_setup = [&]( const std::vector<sgf::Point>& points, go::Side side )
+		{
+			for( auto& point : points )
+			{
+				goban.play_stone( { point.x, point.y, side } );
+				auto& changed = goban.get_changed_points();
+				changed_points.insert( changed_points.end(), changed.begin(), changed.end() );
+			}
+		};
+
+		place_setup( line.black_setup, go::Side::BLACK );
+		place_setup( line.white_setup, go::Side::WHITE );
+		on_position( goban, size_t( 0 ), changed_points );
+
+		const std::vector<go::Stone> no_changes;
+		size_t move_number = 0;
+
+		for( auto& move : line.moves )
+		{
+			move_number++;
+
+			if( move.point.x == 0 && move.point.y == 0 )
+			{
+				on_position( goban, move_number, no_changes );
+				continue;
+			}
+
+			goban.play_stone( {
+				move.point.x,
+				move.point.y,
+				move.black ? go::Side::BLACK : go::Side::WHITE,
+				move_number
+			} );
+			on_position( goban, move_number, goban.get_changed_points() );
+		}
+	}
+}
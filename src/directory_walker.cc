@@ -0,0 +1,366 @@
+#include "directory_walker.hh"
+#include "common_tools.hh"
+#include "profiler.hh"
+
+#include <mutex>
+#include <thread>
+#include <cstring>
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <condition_variable>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+
+using namespace std;
+using namespace tools;
+
+
+
+static bool matches_extension( const char *name, size_t length, const string& extension )
+{
+	if( length < extension.size() )
+	{
+		return false;
+	}
+
+	auto offset = length - extension.size();
+	for( size_t i = 0; i < extension.size(); i++ )
+	{
+		if( tolower( static_cast<unsigned char>( name[offset + i] ) ) !=
+		    tolower( static_cast<unsigned char>( extension[i] ) ) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+
+static string join_path( const string& directory, const char *name, size_t length )
+{
+	string path;
+	path.reserve( directory.size() + 1 + length );
+	path += directory;
+	path += '/';
+	path.append( name, length );
+	return path;
+}
+
+
+
+static bool is_dot_entry( const char *name )
+{
+	return name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0));
+}
+
+
+
+#ifdef _WIN32
+
+// Lists one directory, throws if it can't be read
+static void list_directory(
+	const string&      directory,
+	const string&      extension,
+	bool               with_sizes,
+	vector<FoundFile>& files,
+	vector<string>&    subdirectories
+)
+{
+	WIN32_FIND_DATAA data;
+	auto handle = FindFirstFileExA(
+		(directory + "/*").c_str(), FindExInfoBasic, &data,
+		FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH
+	);
+	if( handle == INVALID_HANDLE_VALUE )
+	{
+		if( GetLastError() == ERROR_FILE_NOT_FOUND )
+		{
+			return;
+		}
+		throw runtime_error( "Couldn't get directory listing for '" + directory + "'" );
+	}
+
+	auto defer_close_handle = make_defer( [&]() {
+		FindClose( handle );
+	} );
+
+	do
+	{
+		if( is_dot_entry( data.cFileName ) )
+		{
+			continue;
+		}
+
+		auto length = strlen( data.cFileName );
+		if( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+		{
+			// Junctions can loop back up the tree
+			if( !(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) )
+			{
+				subdirectories.push_back( join_path( directory, data.cFileName, length ) );
+			}
+		}
+		else if( extension.empty() || matches_extension( data.cFileName, length, extension ) )
+		{
+			files.push_back( {
+				join_path( directory, data.cFileName, length ),
+				(uint64_t( data.nFileSizeHigh ) << 32) | data.nFileSizeLow
+			} );
+		}
+	}
+	while( FindNextFileA( handle, &data ) );
+
+	if( GetLastError() != ERROR_NO_MORE_FILES )
+	{
+		throw runtime_error( "Error iterating over the items of '" + directory + "'" );
+	}
+}
+
+#else
+
+// Lists one directory, throws if it can't be read
+static void list_directory(
+	const string&      directory,
+	const string&      extension,
+	bool               with_sizes,
+	vector<FoundFile>& files,
+	vector<string>&    subdirectories
+)
+{
+	auto descriptor = open( directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+	if( descriptor < 0 )
+	{
+		throw runtime_error( "Couldn't get directory listing for '" + directory + "'" );
+	}
+
+	auto defer_close = make_defer( [&]() {
+		close( descriptor );
+	} );
+
+	// A few hundred entries a call
+	alignas( dirent64 ) char buffer[32 * 1024];
+
+	while( true )
+	{
+		auto bytes = syscall( SYS_getdents64, descriptor, buffer, sizeof( buffer ) );
+		if( bytes < 0 )
+		{
+			throw runtime_error( "Error iterating over the items of '" + directory + "'" );
+		}
+
+		if( bytes == 0 )
+		{
+			break;
+		}
+
+		for( long offset = 0; offset < bytes; )
+		{
+			auto entry = reinterpret_cast<const dirent64*>( buffer + offset );
+			offset += entry->d_reclen;
+
+			auto name = entry->d_name;
+			if( is_dot_entry( name ) )
+			{
+				continue;
+			}
+
+			auto length = strlen( name );
+			auto type   = entry->d_type;
+			if( type == DT_DIR )
+			{
+				subdirectories.push_back( join_path( directory, name, length ) );
+				continue;
+			}
+
+			// Without following links, a link to a directory mustn't be
+			// taken for one
+			struct stat data;
+			if( type == DT_UNKNOWN )
+			{
+				if( fstatat( descriptor, name, &data, AT_SYMLINK_NOFOLLOW ) )
+				{
+					continue;
+				}
+
+				if( S_ISDIR( data.st_mode ) )
+				{
+					subdirectories.push_back( join_path( directory, name, length ) );
+					continue;
+				}
+
+				type = S_ISREG( data.st_mode ) ? DT_REG :
+				       S_ISLNK( data.st_mode ) ? DT_LNK : DT_UNKNOWN;
+			}
+
+			if( type != DT_REG && type != DT_LNK )
+			{
+				continue;
+			}
+
+			if( !extension.empty() && !matches_extension( name, length, extension ) )
+			{
+				continue;
+			}
+
+			if( type == DT_REG && !with_sizes )
+			{
+				files.push_back( { join_path( directory, name, length ), 0 } );
+				continue;
+			}
+
+			// Follows links only to see whether they lead to a file,
+			// broken ones and files gone since are left out
+			if( fstatat( descriptor, name, &data, 0 ) )
+			{
+				continue;
+			}
+
+			if( S_ISREG( data.st_mode ) )
+			{
+				files.push_back( {
+					join_path( directory, name, length ),
+					static_cast<uint64_t>( data.st_size )
+				} );
+			}
+		}
+	}
+}
+
+#endif
+
+
+
+void tools::walk_directory(
+	const string&            root,
+	const string&            extension,
+	bool                     with_sizes,
+	const FoundFilesHandler& on_files,
+	size_t                   thread_count
+)
+{
+	if( !thread_count )
+	{
+		thread_count = max<size_t>( worker_thread_count(), 8 );
+	}
+
+	// Directories waiting to be listed, taken from the back so that the
+	// walk goes deep first and the list stays short
+	mutex                   lock;
+	condition_variable      work_changed;
+	vector<string>          directories{ root };
+	size_t                  listing  = 0;
+	bool                    stopping = false;
+	exception_ptr           error;
+
+	mutex                   handler_lock;
+
+	auto worker = [&]()
+	{
+		vector<FoundFile> files;
+		vector<string>    subdirectories;
+
+		while( true )
+		{
+			string directory;
+			{
+				unique_lock<mutex> guard{ lock };
+				work_changed.wait( guard, [&]()
+				{
+					return stopping || !directories.empty() || !listing;
+				} );
+
+				if( stopping || directories.empty() )
+				{
+					return;
+				}
+
+				directory = move( directories.back() );
+				directories.pop_back();
+				listing++;
+			}
+
+			files.clear();
+			subdirectories.clear();
+			try
+			{
+				PROFILE_SCOPE( "list directory" );
+				list_directory( directory, extension, with_sizes, files, subdirectories );
+			}
+			catch( exception &e )
+			{
+				if( directory != root )
+				{
+					wcerr << "Skipping directory: " << e.what() << endl;
+				}
+				else
+				{
+					lock_guard<mutex> guard{ lock };
+					error    = current_exception();
+					stopping = true;
+				}
+			}
+
+			if( !files.empty() )
+			{
+				lock_guard<mutex> guard{ handler_lock };
+				try
+				{
+					if( !on_files( files ) )
+					{
+						lock_guard<mutex> error_guard{ lock };
+						stopping = true;
+					}
+				}
+				catch( ... )
+				{
+					lock_guard<mutex> error_guard{ lock };
+					if( !error )
+					{
+						error = current_exception();
+					}
+					stopping = true;
+				}
+			}
+
+			{
+				lock_guard<mutex> guard{ lock };
+				listing--;
+				for( auto& subdirectory : subdirectories )
+				{
+					directories.push_back( move( subdirectory ) );
+				}
+			}
+			work_changed.notify_all();
+		}
+	};
+
+	vector<thread> threads;
+	for( size_t i = 1; i < thread_count; i++ )
+	{
+		threads.emplace_back( worker );
+	}
+
+	worker();
+	for( auto& thread : threads )
+	{
+		thread.join();
+	}
+
+	if( error )
+	{
+		rethrow_exception( error );
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+
+// Walking a directory tree with a pool of threads
+// - Directories are listed in parallel, which is what pays off on
+//   network file systems where every listing is a round trip
+// - On Linux the entries are read with getdents64 in large batches
+//   from a descriptor of the directory. The type from d_type is
+//   trusted, fstatat() relative to the descriptor is only needed for
+//   sizes, and only of the files that pass the extension filter, or
+//   where the file system leaves the type unknown.
+// - Symbolic links to files count as files, links to directories are
+//   not followed so that there are no cycles
+namespace tools
+{
+	struct FoundFile
+	{
+		std::string path;
+		uint64_t    size; // 0 unless asked for on Linux
+	};
+
+	// Gets the files of one directory at a time, from the walker
+	// threads but never two calls at once. May take the paths.
+	// Returning false ends the walk early.
+	using FoundFilesHandler = std::function<bool( std::vector<FoundFile>& files )>;
+
+	// Calls on_files with the files under root whose name ends with the
+	// extension, any case, or with every file for an empty extension.
+	// Order is whatever the threads get to first. Throws if root can't
+	// be listed, or what on_files threw. Subdirectories that can't be
+	// listed are skipped with a warning.
+	// thread_count 0 uses at least 8 threads, listing is mostly waiting.
+	void walk_directory(
+		const std::string&       root,
+		const std::string&       extension,
+		bool                     with_sizes,
+		const FoundFilesHandler& on_files,
+		size_t                   thread_count = 0
+	);
+}
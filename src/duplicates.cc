@@ -0,0 +1,307 @@
+#include "duplicates.hh"
+#include "corpus.hh"
+#include "symmetry.hh"
+#include "opening_tree.hh"
+#include "common_tools.hh"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <exception>
+
+
+using namespace std;
+using namespace corpus;
+
+
+
+bool is_pass( const sgf::Move& move )
+{
+	return move.point.x == 0 && move.point.y == 0;
+}
+
+
+
+size_t length_without_trailing_passes( const sgf::MainLine& line )
+{
+	auto length = line.moves.size();
+	while( length && is_pass( line.moves[length - 1] ) )
+	{
+		length--;
+	}
+
+	return length;
+}
+
+
+
+// Colour in the top bits and the point below, setup stones sort first
+uint16_t stone_key( sgf::Point point, bool black, bool setup )
+{
+	return static_cast<uint16_t>(
+		(setup ? 0 : 0x8000) | (black ? 0x4000 : 0) | (point.x << 6) | point.y
+	);
+}
+
+
+
+vector<uint16_t> corpus::canonical_game_keys(
+	const sgf::MainLine& line,
+	size_t               move_count
+)
+{
+	move_count = min( move_count, length_without_trailing_passes( line ) );
+
+	vector<uint16_t> best;
+	vector<uint16_t> keys;
+
+	for( size_t symmetry = 0; symmetry < go::symmetry_count; symmetry++ )
+	{
+		keys.clear();
+		keys.push_back( static_cast<uint16_t>( line.board_size ) );
+
+		for( auto& point : line.black_setup )
+		{
+			keys.push_back( stone_key( transform_move( point, line.board_size, symmetry ), true, true ) );
+		}
+		for( auto& point : line.white_setup )
+		{
+			keys.push_back( stone_key( transform_move( point, line.board_size, symmetry ), false, true ) );
+		}
+		sort( keys.begin() + 1, keys.end() );
+
+		for( size_t i = 0; i < move_count; i++ )
+		{
+			auto& move = line.moves[i];
+			keys.push_back( stone_key( transform_move( move.point, line.board_size, symmetry ), move.black, false ) );
+		}
+
+		if( symmetry == 0 || keys < best )
+		{
+			swap( best, keys );
+		}
+	}
+
+	return best;
+}
+
+
+
+uint64_t hash_keys( const vector<uint16_t>& keys )
+{
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for( auto key : keys )
+	{
+		hash = (hash ^ (key & 0xff)) * 0x100000001b3ULL;
+		hash = (hash ^ (key >> 8)) * 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+
+
+struct GameSignature
+{
+	uint64_t bucket; // Hash of the first min_common_moves canonical moves
+	uint32_t file;
+	bool     valid;
+};
+
+
+
+void corpus::find_duplicates(
+	const string& root_directory,
+	const string& manifest_path,
+	size_t        min_common_moves
+)
+{
+	auto files = find_game_files( root_directory );
+	sort( files.begin(), files.end() );
+
+	if( files.size() > UINT32_MAX )
+	{
+		throw runtime_error( "Too many files" );
+	}
+
+
+	// Bucket the games by their opening, only games in the same
+	// bucket can be duplicates of each other
+	vector<GameSignature> signatures( files.size() );
+	atomic<size_t>        broken_count{ 0 };
+
+	tools::parallel_for( files.size(), [&]( size_t index, size_t )
+	{
+		auto& signature = signatures[index];
+		signature.file  = static_cast<uint32_t>( index );
+		signature.valid = false;
+
+		try
+		{
+			// Games without moves have nothing to compare
+			auto line = read_main_line_file( files[index] );
+			signature.bucket = hash_keys( canonical_game_keys( line, min_common_moves ) );
+			signature.valid  = length_without_trailing_passes( line ) > 0;
+		}
+		catch( exception& )
+		{
+			broken_count++;
+		}
+	} );
+
+	signatures.erase(
+		remove_if( signatures.begin(), signatures.end(), []( const GameSignature& signature )
+		{
+			return !signature.valid;
+		} ),
+		signatures.end()
+	);
+
+	sort( signatures.begin(), signatures.end(), []( const GameSignature& a, const GameSignature& b )
+	{
+		return a.bucket != b.bucket ? a.bucket < b.bucket : a.file < b.file;
+	} );
+
+	vector<pair<size_t, size_t>> buckets; // Ranges with more than one game
+	for( size_t first = 0; first < signatures.size(); )
+	{
+		auto last = first + 1;
+		while( last < signatures.size() && signatures[last].bucket == signatures[first].bucket )
+		{
+			last++;
+		}
+
+		if( last - first > 1 )
+		{
+			buckets.emplace_back( first, last );
+		}
+
+		first = last;
+	}
+
+
+	// Compare the whole main lines inside the buckets, the longest
+	// game of a group is kept and the rest are its duplicates
+	vector<vector<pair<uint32_t, uint32_t>>> bucket_duplicates( buckets.size() );
+
+	tools::parallel_for( buckets.size(), [&]( size_t index, size_t )
+	{
+		struct Game
+		{
+			uint32_t         file;
+			vector<uint16_t> keys;
+		};
+
+		vector<Game> games;
+		for( auto i = buckets[index].first; i < buckets[index].second; i++ )
+		{
+			try
+			{
+				auto line = read_main_line_file( files[signatures[i].file] );
+				games.push_back( { signatures[i].file, canonical_game_keys( line, line.moves.size() ) } );
+			}
+			catch( exception& )
+			{
+				// Changed under us, leave it be
+			}
+		}
+
+		stable_sort( games.begin(), games.end(), []( const Game& a, const Game& b )
+		{
+			return a.keys.size() > b.keys.size();
+		} );
+
+		vector<size_t> kept;
+		for( size_t i = 0; i < games.size(); i++ )
+		{
+			auto& game = games[i].keys;
+			auto  original = find_if( kept.begin(), kept.end(), [&]( size_t k )
+			{
+				return equal( game.begin(), game.end(), games[k].keys.begin() );
+			} );
+
+			if( original == kept.end() )
+			{
+				kept.push_back( i );
+				continue;
+			}
+
+			bucket_duplicates[index].emplace_back( games[i].file, games[*original].file );
+		}
+	} );
+
+
+	// Write out the manifest, sorted by the duplicate path
+	vector<pair<uint32_t, uint32_t>> duplicates;
+	for( auto& found : bucket_duplicates )
+	{
+		duplicates.insert( duplicates.end(), found.begin(), found.end() );
+	}
+	sort( duplicates.begin(), duplicates.end() );
+
+	ofstream manifest( manifest_path, ios_base::out | ios_base::binary | ios_base::trunc );
+	for( auto& duplicate : duplicates )
+	{
+		manifest << files[duplicate.first] << '\t' << files[duplicate.second] << '\n';
+	}
+
+	if( !manifest )
+	{
+		throw runtime_error( "Couldn't write the manifest '" + manifest_path + "'" );
+	}
+
+	wcout << duplicates.size() << " duplicates among " << files.size() << " games, "
+	      << broken_count << " broken" << endl;
+}
+
+
+
+unordered_set<string> corpus::read_duplicate_manifest( const string& path )
+{
+	ifstream in( path, ios_base::in | ios_base::binary );
+	if( !in.is_open() )
+	{
+		throw runtime_error( "Couldn't open the manifest '" + path + "'" );
+	}
+
+	unordered_set<string> duplicates;
+	string line;
+	while( getline( in, line ) )
+	{
+		auto separator = line.find( '\t' );
+		if( separator != string::npos )
+		{
+			duplicates.insert( line.substr( 0, separator ) );
+		}
+	}
+
+	return duplicates;
+}
+
+
+
+int corpus::find_duplicates_command( const vector<string>& args )
+{
+	if( args.size() < 2 || args.size() > 3 )
+	{
+		wcout << "Usage: --find-duplicates <directory> <manifest file> [minimum common moves]" << endl;
+		return 1;
+	}
+
+	size_t min_common_moves = 50;
+	if( args.size() > 2 )
+	{
+		min_common_moves = stoul( args[2] );
+	}
+
+	auto start = chrono::steady_clock::now();
+	find_duplicates( args[0], args[1], min_common_moves );
+
+	auto elapsed = chrono::duration<double>( chrono::steady_clock::now() - start );
+	wcout << "Done in " << elapsed.count() << " s" << endl;
+
+	return 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "sgf.hh"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_set>
+
+
+// Finding the same game in several files of the collection
+// - Games are compared by their main line, canonicalized by board
+//   symmetry, so rotated or reflected copies and copies with different
+//   game info are found too
+// - Trailing passes are ignored, and a game cut short is a duplicate of
+//   the full game as long as it has at least the minimum moves in common
+// - The result is a manifest with a line per duplicate, the duplicate
+//   path and the path of the copy kept, separated by a tab
+namespace corpus
+{
+	// Canonical keys of the setup stones and the first move_count moves,
+	// trailing passes excluded. Smallest of the eight orientations, so
+	// prefixes of a canonical sequence are canonical as well.
+	std::vector<uint16_t> canonical_game_keys(
+		const sgf::MainLine& line,
+		size_t               move_count
+	);
+
+	void find_duplicates(
+		const std::string& root_directory,
+		const std::string& manifest_path,
+		size_t             min_common_moves
+	);
+
+	// Paths listed as duplicates in the manifest
+	std::unordered_set<std::string> read_duplicate_manifest( const std::string& path );
+
+
+	// Command line entry point
+	int find_duplicates_command( const std::vector<std::string>& args );
+}
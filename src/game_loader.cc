@@ -0,0 +1,354 @@
+#include "game_loader.hh"
+#include "corpus.hh"
+#include "board_snapshot.hh"
+#include "profiler.hh"
+#include "allocation_tracker.hh"
+#include "metrics.hh"
+
+#include <locale>
+#include <codecvt>
+#include <utility>
+#include <iterator>
+#include <iostream>
+#include <exception>
+
+
+using namespace std;
+using namespace corpus;
+
+
+
+// First value of a root property in UTF-8, empty if there's none
+string root_text( const sgf::Node& root, const wchar_t *identifier )
+{
+	auto property = root.properties.find( identifier );
+	if( property == root.properties.end() || property->second.empty() )
+	{
+		return {};
+	}
+
+	wstring_convert<codecvt_utf8<wchar_t>> converter;
+	return converter.to_bytes( property->second[0].value );
+}
+
+
+
+string corpus::game_info_text( const sgf::Node& root )
+{
+	string info;
+	auto add_line = [&]( const string& line )
+	{
+		if( line.empty() )
+		{
+			return;
+		}
+
+		if( info.size() )
+		{
+			info += '\n';
+		}
+
+		info += line;
+	};
+
+	auto player_line = [&]( const char *side, const wchar_t *name, const wchar_t *rank )
+	{
+		auto player = root_text( root, name );
+		auto level  = root_text( root, rank );
+		if( player.empty() )
+		{
+			return string{};
+		}
+
+		return string( side ) + player + (level.size() ? " " + level : "");
+	};
+
+	add_line( player_line( "Black: ", L"PB", L"BR" ) );
+	add_line( player_line( "White: ", L"PW", L"WR" ) );
+	add_line( root_text( root, L"EV" ) );
+	add_line( root_text( root, L"DT" ) );
+	add_line( root_text( root, L"RE" ) );
+
+	return info;
+}
+
+
+
+LoadedGame corpus::load_game( const string& path )
+{
+	PROFILE_SCOPE( "load game" );
+
+	return load_game( path, read_sgf_file( path ) );
+}
+
+
+
+LoadedGame corpus::load_game( const string& path, sgf::Node root )
+{
+	LoadedGame game;
+	game.path = path;
+	game.root = move( root );
+
+	auto& properties = game.root.properties;
+
+	auto size_property = properties.find( L"SZ" );
+	if( size_property != properties.end() && size_property->second.size() )
+	{
+		game.board_size = sgf::property_value_to<size_t>( size_property->second[0] );
+	}
+
+	// Skipped like any other broken file, rather than failing later
+	// when its position is published
+	if( game.board_size < 1 || game.board_size > go::BoardSnapshot::max_board_size )
+	{
+		throw runtime_error( "Unsupported board size " + to_string( game.board_size ) );
+	}
+
+	game.date = L"Unknown";
+	auto date_property = properties.find( L"DT" );
+	if( date_property != properties.end() && date_property->second.size() )
+	{
+		game.date = date_property->second[0].value;
+	}
+
+	// Follow the first variation, moving the nodes out of the tree
+	auto children = move( game.root.children );
+	game.root.children.clear();
+
+	while( children.size() )
+	{
+		auto node = move( children.front() );
+		children  = move( node.children );
+		node.children.clear();
+
+		game.nodes.push_back( move( node ) );
+	}
+
+	for( size_t node_index = 0; node_index < game.nodes.size(); node_index++ )
+	{
+		auto& node_properties = game.nodes[node_index].properties;
+		for( auto color : { L"B", L"W" } )
+		{
+			auto property = node_properties.find( color );
+			if( property == node_properties.end() || property->second.empty() )
+			{
+				continue;
+			}
+
+			try
+			{
+				auto point = sgf::property_value_to<sgf::Point>( property->second[0] );
+
+				// Passes, including "tt", leave the board as it is
+				if( point.x < 1 || point.y < 1 || point.x > game.board_size || point.y > game.board_size )
+				{
+					point = { 0, 0 };
+				}
+
+				game.moves.push_back( { point, color[0] == L'B' } );
+				game.move_nodes.push_back( node_index );
+			}
+			catch( exception &e )
+			{
+				wcerr << "Skipping a broken move in " << path.c_str() << ": " << e.what() << endl;
+			}
+
+			break;
+		}
+	}
+
+	game.info = game_info_text( game.root );
+	return game;
+}
+
+
+
+GameLoader::GameLoader( vector<string> game_files, size_t queue_size )
+: files( move( game_files ) ),
+  capacity( queue_size ? queue_size : 1 ),
+  stopping( false ),
+  finished( false ),
+  adding( false ),
+  sampling( false )
+{
+	thread = std::thread( &GameLoader::run, this );
+}
+
+
+
+GameLoader::GameLoader( uint64_t seed, size_t queue_size )
+: capacity( queue_size ? queue_size : 1 ),
+  stopping( false ),
+  finished( false ),
+  adding( true ),
+  sampling( true ),
+  random( seed )
+{
+	thread = std::thread( &GameLoader::run, this );
+}
+
+
+
+void GameLoader::add_files( vector<string>& new_files )
+{
+	if( new_files.empty() )
+	{
+		return;
+	}
+
+	{
+		lock_guard<std::mutex> lock{ mutex };
+		files.insert(
+			files.end(),
+			make_move_iterator( new_files.begin() ),
+			make_move_iterator( new_files.end() )
+		);
+	}
+	space_available.notify_one();
+}
+
+
+
+void GameLoader::finish_adding()
+{
+	{
+		lock_guard<std::mutex> lock{ mutex };
+		adding = false;
+	}
+	space_available.notify_one();
+}
+
+
+
+GameLoader::~GameLoader()
+{
+	{
+		lock_guard<std::mutex> lock{ mutex };
+		stopping = true;
+	}
+	space_available.notify_all();
+
+	if( thread.joinable() )
+	{
+		thread.join();
+	}
+
+	tools::metrics.loader_queue_depth.add( -static_cast<int64_t>( ready.size() ) );
+}
+
+
+
+void GameLoader::run()
+{
+	tools::set_thread_name( "loader" );
+	tools::AllocationScope allocation_scope{ tools::ALLOC_LOADER };
+
+	while( true )
+	{
+		string path;
+		{
+			unique_lock<std::mutex> lock{ mutex };
+			space_available.wait( lock, [this]()
+			{
+				return stopping || (ready.size() < capacity && (!files.empty() || !adding));
+			} );
+
+			if( stopping || files.empty() )
+			{
+				finished = true;
+				break;
+			}
+
+			// Any of the files so far, swapped to the back to be taken
+			if( sampling )
+			{
+				uniform_int_distribution<size_t> pick( 0, files.size() - 1 );
+				swap( files[pick( random )], files.back() );
+			}
+
+			path = move( files.back() );
+			files.pop_back();
+		}
+
+		// Parse without holding the lock
+		LoadedGame game;
+		try
+		{
+			auto start = tools::profile_clock_ns();
+			game = load_game( path );
+			tools::metrics.parse_seconds.observe( tools::profile_clock_ns() - start );
+		}
+		catch( exception &e )
+		{
+			wcerr << "Skipping " << path.c_str() << ": " << e.what() << endl;
+			tools::metrics.parse_failures.add();
+			continue;
+		}
+
+		if( game.moves.empty() )
+		{
+			continue;
+		}
+
+		{
+			lock_guard<std::mutex> lock{ mutex };
+			ready.push_back( move( game ) );
+		}
+		tools::metrics.games_loaded.add();
+		tools::metrics.loader_queue_depth.add( 1 );
+		game_available.notify_one();
+	}
+
+	game_available.notify_all();
+}
+
+
+
+bool GameLoader::pop( LoadedGame& game )
+{
+	unique_lock<std::mutex> lock{ mutex };
+	game_available.wait( lock, [this]()
+	{
+		return !ready.empty() || finished;
+	} );
+
+	if( ready.empty() )
+	{
+		return false;
+	}
+
+	game = move( ready.front() );
+	ready.pop_front();
+	tools::metrics.loader_queue_depth.add( -1 );
+
+	lock.unlock();
+	space_available.notify_one();
+	return true;
+}
+
+
+
+bool GameLoader::try_pop( LoadedGame& game )
+{
+	unique_lock<std::mutex> lock{ mutex };
+	if( ready.empty() )
+	{
+		return false;
+	}
+
+	game = move( ready.front() );
+	ready.pop_front();
+	tools::metrics.loader_queue_depth.add( -1 );
+
+	lock.unlock();
+	space_available.notify_one();
+	return true;
+}
+
+
+
+bool GameLoader::is_exhausted()
+{
+	lock_guard<std::mutex> lock{ mutex };
+	return finished && ready.empty();
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "sgf.hh"
+
+#include <mutex>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+#include <thread>
+#include <condition_variable>
+
+
+namespace corpus
+{
+	// A parsed game, ready to be played out
+	struct LoadedGame
+	{
+		std::string            path;
+		size_t                 board_size = 19;
+		std::wstring           date;
+
+		sgf::Node              root;  // Root properties, without children
+		std::vector<sgf::Node> nodes; // The main line after the root,
+		                              // each without children
+
+		// The moves of the main line, decoded on the loader thread so
+		// that replaying one is just an index, passes are at { 0, 0 }
+		std::vector<sgf::Move> moves;
+		std::vector<size_t>    move_nodes; // The node of every move
+
+		// Players, date and result as UTF-8 lines, for showing
+		std::string            info;
+	};
+
+
+	// Reads games on a thread of its own, keeping up to a given number
+	// of them parsed ahead so that the viewer never waits on the disk
+	// between games. Files that fail to parse or have no moves are
+	// skipped on the loader thread.
+	// - Either the files are all known up front and read in order, or
+	//   they're added while the loader runs, eg. as a directory walk
+	//   finds them, and every game is drawn at random from the files
+	//   added so far and not yet read
+	class GameLoader
+	{
+		std::vector<std::string> files;  // Taken from the back in order
+		std::deque<LoadedGame>   ready;
+		size_t                   capacity;
+		bool                     stopping;
+		bool                     finished; // Every file has been read
+		bool                     adding;   // More files may come
+		bool                     sampling; // Draw the files at random
+		std::mt19937_64          random;
+
+		std::mutex               mutex;
+		std::condition_variable  space_available;
+		std::condition_variable  game_available;
+		std::thread              thread;
+
+
+	  public:
+		GameLoader( std::vector<std::string> game_files, size_t queue_size = 4 );
+
+		// Starts with no files, they come with add_files()
+		GameLoader( uint64_t seed, size_t queue_size = 4 );
+
+		~GameLoader();
+
+		// Takes the paths, from any thread
+		void add_files( std::vector<std::string>& new_files );
+
+		// No more files are coming, the loader finishes once it has
+		// read the ones it has
+		void finish_adding();
+
+		// Waits for the next game, false when there are none left
+		bool pop( LoadedGame& game );
+
+		// Takes the next game if one is ready, without waiting
+		bool try_pop( LoadedGame& game );
+
+		// No more games are coming, the queue is empty
+		bool is_exhausted();
+
+		GameLoader( const GameLoader& ) = delete;
+		GameLoader& operator=( const GameLoader& ) = delete;
+
+
+	  private:
+		void run();
+	};
+
+
+	// Parses a game and flattens its main line, throws if the file
+	// isn't a readable go game. Broken moves are left out.
+	LoadedGame load_game( const std::string& path );
+
+	// The same for a game tree already parsed from the file at path
+	LoadedGame load_game( const std::string& path, sgf::Node root );
+
+	// Players with their ranks, event, date and result from the root
+	// properties, one per line in UTF-8, leaving out the missing ones
+	std::string game_info_text( const sgf::Node& root );
+}
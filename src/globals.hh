@@ -2,15 +2,25 @@
 
 #include "window.hh"
 
-#include <mutex>
 #include <vector>
+#include <cstdint>
+#include <unordered_map>
 
 
+// Only used from the main thread, which handles the SDL events
 struct Globals
 {
 	static bool                     should_quit;
 
-	static std::mutex               windows_mutex;
+	// Move numbers on the stones, toggled with M
+	static bool                     show_move_numbers;
+
+	// Frame times and stage costs over the boards, toggled with P
+	static bool                     show_profile;
+
 	static std::vector<gui::Window> windows;
+
+	// SDL window id to the index of the window in windows
+	static std::unordered_map<uint32_t, size_t> window_lookup;
 };
 
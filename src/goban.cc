@@ -1,5 +1,7 @@
 #include "goban.hh"
+#include "profiler.hh"
 
+#include <atomic>
 #include <iostream>
 #include <exception>
 
@@ -8,6 +10,14 @@ using namespace std;
 
 
 
+static uint64_t next_revision()
+{
+	static atomic<uint64_t> revision_counter{ 0 };
+	return ++revision_counter;
+}
+
+
+
 go::Stone::Stone(
 	size_t x_pos,
 	size_t y_pos,
@@ -30,252 +40,224 @@ go::Goban::Goban( size_t size )
 
 
 
-bool stones_are_neighbors( const Stone& a, const Stone& b )
+// Indices of the points next to index, returns how many there are
+static size_t point_neighbors( size_t index, size_t board_size, size_t neighbors[4] )
 {
-	if( (a.y == b.y && a.x == b.x - 1 ) ||
-		(a.y == b.y && a.x == b.x + 1 ) ||
-		(a.x == b.x && a.y == b.y - 1 ) ||
-		(a.x == b.x && a.y == b.y + 1 ) )
-	{
-		return true;
-	}
+	auto   x     = index % board_size;
+	auto   y     = index / board_size;
+	size_t count = 0;
+
+	if( x > 0 )              neighbors[count++] = index - 1;
+	if( x < board_size - 1 ) neighbors[count++] = index + 1;
+	if( y > 0 )              neighbors[count++] = index - board_size;
+	if( y < board_size - 1 ) neighbors[count++] = index + board_size;
 
-	return false;
+	return count;
 }
 
 
 
-// Takes in a vector containing the stones of one side
-vector<vector<Stone>> go::Goban::form_groups( vector<Stone> stones )
+void go::Goban::capture_group( size_t start )
 {
-	vector<vector<Stone>> groups;
-	vector<Stone> current_group;
+	auto side = board[start].side;
+	if( side == NONE || fill_marks[start] == fill_generation )
+	{
+		return;
+	}
 
-	while( stones.size() > 0 )
+	// Flood fill the group, giving up at the first liberty
+	fill_stack.clear();
+	fill_stack.push_back( start );
+	fill_marks[start] = fill_generation;
+
+	for( size_t i = 0; i < fill_stack.size(); i++ )
 	{
-		// Grab one stone 
-		current_group.clear();
-		current_group.push_back( stones.back() );
-		stones.pop_back();
+		size_t neighbors[4];
+		auto   neighbor_count = point_neighbors( fill_stack[i], board_size, neighbors );
 
-		// Find all the stones which belong to the group
-		while( true )
+		for( size_t n = 0; n < neighbor_count; n++ )
 		{
-			vector<Stone> new_stones;
-
-			// Try to find neighbors for every stone in the current_group
-			for( auto& group_stone : current_group )
+			auto neighbor = neighbors[n];
+			if( board[neighbor].side == NONE )
 			{
-				// Loop over all remaining stones
-				for( auto it = stones.begin(); it < stones.end(); )
-				{
-					if( !stones_are_neighbors( group_stone, *it ) )
-					{
-						it++;
-						continue;
-					}
-
-					// Stones are neighbors
-					new_stones.push_back( *it );
-					it = stones.erase( it );
-				}
+				return;
 			}
 
-			// Couldn't find any more stones to this group
-			if( !new_stones.size() )
+			if( board[neighbor].side == side && fill_marks[neighbor] != fill_generation )
 			{
-				break;
+				fill_marks[neighbor] = fill_generation;
+				fill_stack.push_back( neighbor );
 			}
-
-			// Found stones, append them to the current_group
-			current_group.insert(
-				current_group.end(),
-				new_stones.begin(),
-				new_stones.end()
-			);
 		}
-
-		// Save the current_group and continue to the next one
-		groups.push_back( current_group );
 	}
 
-	return groups;
+	// No liberties, the group is captured
+	for( auto index : fill_stack )
+	{
+		board[index] = { index % board_size, index / board_size };
+		changed_points.push_back( board[index] );
+	}
 }
 
 
 
-vector<Stone> go::Goban::get_stone_neighbors(
-	const vector<Stone>& board,
-	const Stone& stone
-)
+void go::Goban::play_stone( Stone stone )
 {
-	vector<Stone> neighbors;
-
-
-	size_t index;
-
-	if( stone.x > 0 )
-	{
-		index = (stone.y) * board_size + stone.x - 1;
-		neighbors.push_back( board[index] );
-	}
-
-	if( stone.y > 0 )
-	{
-		index = (stone.y-1) * board_size + stone.x;
-		neighbors.push_back( board[index] );
-	}
-
-	if( stone.x < board_size - 1 )
-	{
-		index = (stone.y) * board_size + stone.x + 1;
-		neighbors.push_back( board[index] );
-	}
+	PROFILE_SCOPE( "play stone" );
 
-	if( stone.y < board_size - 1 )
+	if( stone.x > board_size || stone.y > board_size ||
+	    stone.x <= 0 || stone.y <= 0 )
 	{
-		index = (stone.y+1) * board_size + stone.x;
-		neighbors.push_back( board[index] );
+		throw runtime_error( "Tried to play stone outside of board" );
 	}
 
-	return neighbors;
-}
+	stone.x--;
+	stone.y--;
 
+	changed_points.clear();
 
+	auto index = (stone.y) * board_size + stone.x;
 
-vector<Stone> go::Goban::find_remaining_liberties(
-	const vector<Stone>& board,
-	const vector<Stone>& group
-)
-{
-	vector<Stone> liberties;
+	board[index] = stone;
+	last_move    = stone;
 
-	for( auto& stone : group )
+	// Only the opponent groups touching the stone can lose their
+	// last liberty to it
+	if( stone.side != NONE )
 	{
-		auto neighbors = get_stone_neighbors( board, stone );
-		for( auto& neighbor : neighbors )
+		if( ++fill_generation == 0 )
 		{
-			if( neighbor.side == NONE )
-			{
-				bool found = false;
+			fill_marks.assign( fill_marks.size(), 0 );
+			fill_generation = 1;
+		}
 
-				// Check that the liberty is unique
-				for( auto& liberty : liberties )
-				{
-					if( liberty.x == neighbor.x &&
-					    liberty.y == neighbor.y )
-					{
-						found = true;
-					}
-				}
+		auto   opponent = stone.side == BLACK ? WHITE : BLACK;
+		size_t neighbors[4];
+		auto   neighbor_count = point_neighbors( index, board_size, neighbors );
 
-				// Not found, go ahead and push it back
-				if( !found )
-				{
-					liberties.push_back( neighbor );
-				}
+		for( size_t n = 0; n < neighbor_count; n++ )
+		{
+			if( board[neighbors[n]].side == opponent )
+			{
+				capture_group( neighbors[n] );
 			}
 		}
 	}
 
-	return liberties;
+	changed_points.push_back( stone );
+
+	revision = next_revision();
 }
 
 
 
-vector<vector<Stone>> go::Goban::capture_groups( const vector<Stone>& board, Stone stone )
+void go::Goban::pass()
 {
-	vector<vector<Stone>> captured_groups;
+	changed_points.clear();
+	revision = next_revision();
+}
 
-	if( stone.side == NONE )
-	{
-		return{};
-	}
 
-	// Collect opponent's stones in a vector
-	vector<Stone> opponent_stones;
-	Side opponent = stone.side == BLACK ? WHITE : BLACK;
 
-	for( auto& stone : board )
-	{
-		if( stone.side == opponent )
-		{
-			opponent_stones.push_back( stone );
-		}
-	}
+const std::vector<Stone>& go::Goban::get_board() const
+{
+	return board;
+}
 
 
-	// Form groups from the stones
-	auto opponent_groups = form_groups( opponent_stones );
 
-	// Find groups with only one liberty left
-	for( auto& group : opponent_groups )
-	{
-		auto liberties = find_remaining_liberties( board, group );
-		if( liberties.size() != 1 )
-		{
-			continue;
-		}
+const std::vector<Stone>& go::Goban::get_changed_points()
+{
+	return changed_points;
+}
+
 
-		// Group has only one liberty left,
-		// check if the stone takes it
-		auto liberty = liberties[0];
-		if( liberty.x == stone.x &&
-			liberty.y == stone.y )
-		{
-			// Group is captured
-			captured_groups.push_back( group );
-		}
-	}
 
-	return captured_groups;
+const Stone& go::Goban::get_last_move() const
+{
+	return last_move;
 }
 
 
 
-void go::Goban::play_stone( Stone stone )
+uint64_t go::Goban::get_revision() const
 {
-	if( stone.x > board_size || stone.y > board_size ||
-	    stone.x <= 0 || stone.y <= 0 )
-	{
-		throw runtime_error( "Tried to play stone outside of board" );
-	}
+	return revision;
+}
+
 
-	stone.x--;
-	stone.y--;
 
-	auto captured_groups = capture_groups( board, stone );
-	
-	// Clear every captured group
-	for( auto& captured_group : captured_groups )
+size_t go::Goban::get_board_size() const
+{
+	return board_size;
+}
+
+
+
+vector<size_t> go::Goban::get_liberty_counts() const
+{
+	vector<size_t> liberty_counts( board.size(), 0 );
+	vector<size_t> liberty_marks( board.size(), 0 );
+	vector<bool>   visited( board.size(), false );
+	vector<size_t> group;
+
+	for( size_t start = 0; start < board.size(); start++ )
 	{
-		for( auto& captured_stone : captured_group )
+		if( board[start].side == NONE || visited[start] )
 		{
-			auto stone_index = (captured_stone.y) * board_size
-			                 + captured_stone.x;
-			board[stone_index] = {
-				captured_stone.x,
-				captured_stone.y
-			};
+			continue;
 		}
-	}
 
-	auto index = (stone.y) * board_size + stone.x;
+		// Flood fill the group, marking its liberties with start + 1
+		size_t liberties = 0;
+		group.clear();
+		group.push_back( start );
+		visited[start] = true;
 
-	board[index] = stone;
-}
+		for( size_t i = 0; i < group.size(); i++ )
+		{
+			size_t neighbors[4];
+			auto   neighbor_count = point_neighbors( group[i], board_size, neighbors );
 
+			for( size_t n = 0; n < neighbor_count; n++ )
+			{
+				auto neighbor = neighbors[n];
+				if( board[neighbor].side == NONE )
+				{
+					if( liberty_marks[neighbor] != start + 1 )
+					{
+						liberty_marks[neighbor] = start + 1;
+						liberties++;
+					}
+				}
+				else if( board[neighbor].side == board[start].side && !visited[neighbor] )
+				{
+					visited[neighbor] = true;
+					group.push_back( neighbor );
+				}
+			}
+		}
 
+		for( auto index : group )
+		{
+			liberty_counts[index] = liberties;
+		}
+	}
 
-const std::vector<Stone>& go::Goban::get_board()
-{
-	return board;
+	return liberty_counts;
 }
 
 
 
 void go::Goban::clear()
 {
+	changed_points.clear();
+	last_move = Stone{};
+	revision  = next_revision();
+
+	fill_marks.assign( board_size * board_size, 0 );
+	fill_generation = 0;
+
 	board = std::vector<Stone>( (board_size * board_size), Stone{} );
 	size_t index = 0;
 	for( auto &stone : board )
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 #include <iostream>
 
 
@@ -38,6 +39,12 @@ namespace go
 		size_t             board_size;
 		size_t             current_move;
 		std::vector<Stone> board;
+		std::vector<Stone> changed_points;
+		Stone              last_move;
+
+		// Every change of any board gets a new revision number, so that
+		// a viewer can tell whether it has seen the previous state
+		uint64_t           revision;
 
 
 	  public:
@@ -45,31 +52,40 @@ namespace go
 
 		void play_stone( Stone stone );
 
-		const std::vector<Stone>& get_board();
+		// Leaves the stones as they are, but the position after a pass
+		// is a new state with a revision of its own
+		void pass();
 
-		void clear();
+		const std::vector<Stone>& get_board() const;
 
+		// Points changed by the last play_stone(), in their new state
+		const std::vector<Stone>& get_changed_points();
 
+		// Changes with every play_stone(), pass() and clear()
+		uint64_t get_revision() const;
 
-	  protected:
-		std::vector<std::vector<Stone>>
-		form_groups( std::vector<Stone> stones );
+		size_t get_board_size() const;
 
+		// The stone placed by the last play_stone(), NONE on a cleared board
+		const Stone& get_last_move() const;
 
-		std::vector<Stone> get_stone_neighbors(
-			const std::vector<Stone>& board,
-			const Stone& stone
-		);
+		// Liberties of the group at every point, 0 for empty points
+		std::vector<size_t> get_liberty_counts() const;
 
-		std::vector<Stone> find_remaining_liberties(
-			const std::vector<Stone>& board,
-			const std::vector<Stone>& group
-		);
+		void clear();
 
-		std::vector<std::vector<Stone>> capture_groups(
-			const std::vector<Stone>& board,
-			Stone stone
-		);
+
+
+	  protected:
+		// Removes the group at index if it has no liberties left,
+		// using a flood fill from that point only
+		void capture_group( size_t index );
+
+		// Scratch space for the flood fill, points are marked with the
+		// current generation so that nothing needs clearing between fills
+		std::vector<uint32_t> fill_marks;
+		std::vector<size_t>   fill_stack;
+		uint32_t              fill_generation;
 	};
 }
 
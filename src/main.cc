@@ -4,10 +4,33 @@
 #include "globals.hh"
 #include "sgf.hh"
 #include "goban.hh"
-
-#include <mutex>
+#include "render_worker.hh"
+#include "text_cache.hh"
+#include "profiler.hh"
+#include "allocation_tracker.hh"
+#include "metrics_server.hh"
+#include "move_scheduler.hh"
+#include "replay.hh"
+#include "corpus.hh"
+#include "game_loader.hh"
+#include "directory_walker.hh"
+#include "position_index.hh"
+#include "pattern_search.hh"
+#include "opening_tree.hh"
+#include "duplicates.hh"
+#include "training_export.hh"
+#include "thumbnails.hh"
+#include "video_export.hh"
+#include "allocation_benchmark.hh"
+#include "render_benchmark.hh"
+#include "session.hh"
+#include "catalog.hh"
+
+#include <chrono>
 #include <memory>
+#include <atomic>
 #include <thread>
+#include <random>
 #include <vector>
 #include <locale>
 #include <codecvt>
@@ -15,6 +38,8 @@
 #include <iostream>
 #include <algorithm>
 #include <exception>
+#include <unordered_map>
+#include <unordered_set>
 
 
 #ifdef _WIN32
@@ -38,14 +63,44 @@ using namespace std;
 
 // Set up the Globals
 bool Globals::should_quit = false;
+bool Globals::show_move_numbers = false;
+bool Globals::show_profile = false;
 
 vector<gui::Window> Globals::windows{};
-mutex Globals::windows_mutex = {};
+unordered_map<uint32_t, size_t> Globals::window_lookup{};
+
+
+// Share of a display refresh the replays may spend playing moves,
+// the rest is left for events and handing positions to the renderers
+const double move_budget_share = 0.5;
+
+
+
+
+// The boards replayed in a window, drawn by its render thread
+struct WallWindow
+{
+	vector<unique_ptr<gui::Replay>> replays;
+	bool                            new_positions = false;
+	bool                            targets_reset = false;
+	bool                            options_changed = false;
+	unique_ptr<gui::RenderWorker>   worker;
+};
+
 
 
+void update_window_lookup()
+{
+	Globals::window_lookup.clear();
+	for( size_t i = 0; i < Globals::windows.size(); i++ )
+	{
+		Globals::window_lookup[Globals::windows[i].sdl_id] = i;
+	}
+}
+
 
 
-void handle_sdl_event( const SDL_Event &e )
+void handle_sdl_event( const SDL_Event &e, vector<unique_ptr<WallWindow>> &walls )
 {
 	if( e.type == SDL_QUIT )
 	{
@@ -54,24 +109,60 @@ void handle_sdl_event( const SDL_Event &e )
 
 	else if( e.type == SDL_KEYDOWN )
 	{
+		// The keys act on every board
+		vector<gui::Replay*> replays;
+		for( auto& wall : walls )
+		{
+			for( auto& replay : wall->replays )
+			{
+				replays.push_back( replay.get() );
+			}
+		}
+		gui::apply_replay_key( e.key.keysym.sym, replays );
+
+		if( e.key.keysym.sym == SDLK_m || e.key.keysym.sym == SDLK_p )
+		{
+			if( e.key.keysym.sym == SDLK_m )
+			{
+				Globals::show_move_numbers = !Globals::show_move_numbers;
+			}
+			else
+			{
+				Globals::show_profile = !Globals::show_profile;
+				tools::enable_profiling( Globals::show_profile );
+			}
+
+			for( auto& wall : walls )
+			{
+				wall->options_changed = true;
+			}
+		}
+
 		if( e.key.keysym.sym == SDLK_ESCAPE )
 		{
 			Globals::should_quit = true;
 		}
 	}
 
+	// Render target textures lose their contents, rebuild them
+	else if( e.type == SDL_RENDER_TARGETS_RESET ||
+	         e.type == SDL_RENDER_DEVICE_RESET )
+	{
+		for( auto& wall : walls )
+		{
+			wall->targets_reset = true;
+		}
+	}
+
 	else if( e.type == SDL_WINDOWEVENT )
 	{
 		auto window_id = e.window.windowID;
 
-		lock_guard<mutex> windows_lock{ Globals::windows_mutex };
-		for( auto& window : Globals::windows )
+		auto window_index = Globals::window_lookup.find( window_id );
+		if( window_index != Globals::window_lookup.end() )
 		{
-			if( window.sdl_id == window_id )
-			{
-				window.handle_sdl_event( e );
-				return;
-			}
+			Globals::windows[window_index->second].handle_sdl_event( e );
+			return;
 		}
 
 		cerr << "Unhandled SDL_WINDOWEVENT, target window "
@@ -81,73 +172,220 @@ void handle_sdl_event( const SDL_Event &e )
 
 
 
-auto read_file_contents( const string& filename )
+// Batch commands, run instead of the viewer
+// when given as the first argument
+struct Command
 {
-	ifstream in( filename, ios_base::in | ios_base::binary );
-	if( !in.is_open() )
-	{
-		throw runtime_error( "Couldn't open the file!" );
-	}
+	const char *name;
+	int       (*run)( const vector<string>& args );
+};
 
-	wstring str{ istreambuf_iterator<char>( in ),
-	             istreambuf_iterator<char>() };
-
-	return str;
-}
+const Command commands[] =
+{
+	{ "--build-index", corpus::build_index_command },
+	{ "--query-index", corpus::query_index_command },
+	{ "--search-pattern", corpus::search_pattern_command },
+	{ "--build-opening-tree", corpus::build_opening_tree_command },
+	{ "--query-opening-tree", corpus::query_opening_tree_command },
+	{ "--find-duplicates", corpus::find_duplicates_command },
+	{ "--export-training-data", corpus::export_training_data_command },
+	{ "--thumbnails", corpus::thumbnails_command },
+	{ "--export-video", corpus::export_video_command },
+	{ "--allocation-report", corpus::allocation_report_command },
+	{ "--render-benchmark", gui::render_benchmark_command },
+	{ "--replay-session", gui::replay_session_command },
+	{ "--build-catalog", corpus::build_catalog_command },
+};
 
 
 
-sgf::Node read_sgf_file( const string& path )
+int main( int argc, char **argv )
 {
-	auto data = read_file_contents( path );
-
-	// Get rid of the BOM if it's there
-	if( data[0] == 0xffef ||
-		data[0] == -17 )
+	if( argc <= 1 )
 	{
-		data = data.substr( 3 );
+		wcout << "Give directory path!" << endl;
+		return 1;
 	}
 
-	auto root = sgf::read_game_tree( data );
+	for( auto& command : commands )
+	{
+		if( string( argv[1] ) != command.name )
+		{
+			continue;
+		}
 
-	//sgf::print_game_tree( root );
+		try
+		{
+			return command.run( vector<string>( argv + 2, argv + argc ) );
+		}
+		catch( exception &e )
+		{
+			wcout << "Ran into an error: " << e.what() << endl;
+			return 1;
+		}
+	}
 
-	// If we got the GM property, check that the value is correct
-	auto game_property = root.properties[L"GM"];
-	if( game_property.size() )
+	// Viewer options after the directory
+	unique_ptr<corpus::OpeningTree> opening_tree;
+	unordered_set<string>           duplicate_files;
+	gui::MoveScheduler::Clock::duration move_interval = chrono::milliseconds( 500 );
+	size_t                          prefetch_games = 4;
+	size_t                          wall_columns = 1;
+	size_t                          wall_rows    = 1;
+	size_t                          window_count = 1;
+	string                          font_path    = gui::default_font_path;
+	string                          trace_path;
+	bool                            allocation_stats = false;
+	unique_ptr<tools::MetricsServer> metrics_server;
+	uint64_t                        seed = random_device{}();
+	bool                            seed_given = false;
+	string                          session_path;
+	string                          catalog_path;
+
+	try
 	{
-		auto game_type = sgf::property_value_to<int>( game_property[0] );
-		if( game_type != 1 )
+		for( int i = 2; i < argc; i++ )
 		{
-			wcout << "Error: Wrong game type(" << game_type << ") expected 1 for go" << endl;
-			throw runtime_error( "Wrong game type" );
+			string option = argv[i];
+			if( option == "--opening-tree" && i + 1 < argc )
+			{
+				opening_tree.reset( new corpus::OpeningTree( argv[++i] ) );
+			}
+			else if( option == "--duplicates" && i + 1 < argc )
+			{
+				duplicate_files = corpus::read_duplicate_manifest( argv[++i] );
+			}
+			else if( option == "--move-interval" && i + 1 < argc )
+			{
+				move_interval = chrono::milliseconds( stoul( argv[++i] ) );
+			}
+			else if( option == "--moves-per-second" && i + 1 < argc )
+			{
+				auto moves_per_second = stod( argv[++i] );
+				if( moves_per_second <= 0 )
+				{
+					throw runtime_error( "The replay speed has to be positive" );
+				}
+
+				move_interval = chrono::duration_cast<gui::MoveScheduler::Clock::duration>(
+					chrono::duration<double>( 1.0 / moves_per_second )
+				);
+			}
+			else if( option == "--prefetch" && i + 1 < argc )
+			{
+				prefetch_games = stoul( argv[++i] );
+			}
+			else if( option == "--wall" && i + 1 < argc )
+			{
+				// Columns x rows, eg. 8x8
+				string grid = argv[++i];
+				auto separator = grid.find( 'x' );
+				if( separator == string::npos )
+				{
+					throw runtime_error( "The wall size should be given as COLUMNSxROWS" );
+				}
+
+				wall_columns = stoul( grid.substr( 0, separator ) );
+				wall_rows    = stoul( grid.substr( separator + 1 ) );
+				if( !wall_columns || !wall_rows )
+				{
+					throw runtime_error( "The wall needs at least one tile" );
+				}
+			}
+			else if( option == "--windows" && i + 1 < argc )
+			{
+				window_count = max<size_t>( stoul( argv[++i] ), 1 );
+			}
+			else if( option == "--font" && i + 1 < argc )
+			{
+				font_path = argv[++i];
+			}
+			else if( option == "--trace" && i + 1 < argc )
+			{
+				trace_path = argv[++i];
+			}
+			else if( option == "--metrics-port" && i + 1 < argc )
+			{
+				auto port = stoul( argv[++i] );
+				if( !port || port > 65535 )
+				{
+					throw runtime_error( "The metrics port should be between 1 and 65535" );
+				}
+				metrics_server.reset( new tools::MetricsServer( static_cast<uint16_t>( port ) ) );
+			}
+			else if( option == "--metrics-socket" && i + 1 < argc )
+			{
+				metrics_server.reset( new tools::MetricsServer( string( argv[++i] ) ) );
+			}
+			else if( option == "--seed" && i + 1 < argc )
+			{
+				seed       = stoull( argv[++i] );
+				seed_given = true;
+			}
+			else if( option == "--record-session" && i + 1 < argc )
+			{
+				session_path = argv[++i];
+			}
+			else if( option == "--catalog" && i + 1 < argc )
+			{
+				catalog_path = argv[++i];
+			}
+			else if( option == "--allocation-stats" )
+			{
+				allocation_stats = true;
+			}
+			else
+			{
+				wcout << "Unknown option: " << option.c_str() << endl;
+				return 1;
+			}
 		}
 	}
-
-	// Grab the date property
-	auto date_property = root.properties[L"DT"];
-	wstring date = L"Unknown";
-	if( date_property.size() )
+	catch( exception &e )
 	{
-		date = date_property[0].value;
+		wcout << "Ran into an error: " << e.what() << endl;
+		return 1;
 	}
 
-	wcout << "Game played at date: " << date << endl;
+	// Record the session for chrome://tracing or Perfetto, written out
+	// at the very end, after every thread has stopped
+	tools::set_thread_name( "main" );
+	tools::enable_tracing( !trace_path.empty() );
 
-	return root;
-}
+	auto defer_write_trace = tools::make_defer( [&trace_path]()
+	{
+		if( trace_path.empty() )
+		{
+			return;
+		}
 
+		try
+		{
+			tools::write_chrome_trace( trace_path );
+			wcout << "Wrote the trace to " << trace_path.c_str() << endl;
+		}
+		catch( exception &e )
+		{
+			wcerr << e.what() << endl;
+		}
+	} );
 
+	// Count the allocations of every subsystem, printed at the end
+	tools::enable_allocation_tracking( allocation_stats );
 
-int main( int argc, char **argv )
-{
-	if( argc <= 1 )
+	auto defer_allocation_report = tools::make_defer( [allocation_stats]()
 	{
-		wcout << "Give directory path!" << endl;
-		return 1;
-	}
+		if( !allocation_stats )
+		{
+			return;
+		}
 
-	srand( static_cast<unsigned>( time( 0 ) ) );
+		tools::enable_allocation_tracking( false );
+		for( auto& line : tools::allocation_report() )
+		{
+			wcout << line.c_str() << endl;
+		}
+	} );
 
 	// Wait for user input at the end when in debug mode
 	#ifdef  _DEBUG
@@ -181,25 +419,41 @@ int main( int argc, char **argv )
 		SDL_Quit();
 	} );
 
+	// Without SDL_ttf the text falls back to the built-in font
+	if( TTF_Init() )
+	{
+		wcerr << "TTF_Init() failed: " << TTF_GetError() << endl;
+	}
+
+	auto defer_ttf_quit = tools::make_defer( [](){
+		if( TTF_WasInit() )
+		{
+			TTF_Quit();
+		}
+	} );
 
-	// Create a window
-	Globals::windows.emplace_back();
-	if( Globals::windows.size() <= 0 ||
-	   !Globals::windows[0].is_initialized() )
+
+	// Create the windows
+	for( size_t i = 0; i < window_count; i++ )
 	{
-		return 1;
+		Globals::windows.emplace_back();
+		if( !Globals::windows.back().is_initialized() )
+		{
+			return 1;
+		}
 	}
+	update_window_lookup();
 
 	// Clear windows automatically at the end,
 	// while the SDL context is still okay
 	auto defer_close_windows = tools::make_defer( []()
 	{
-		lock_guard<mutex> windows_lock{ Globals::windows_mutex };
 		Globals::windows.clear();
+		Globals::window_lookup.clear();
 	} );
 
 
-	// Create the board texture
+	// Load the board texture
 	auto board_surface = sdl2::SurfacePtr(
 		IMG_Load( "data/wood.jpg" )
 	);
@@ -209,18 +463,6 @@ int main( int argc, char **argv )
 		return 1;
 	}
 
-	auto board_texture = sdl2::TexturePtr(
-		SDL_CreateTextureFromSurface(
-			Globals::windows[0].renderer.get(),
-			board_surface.get()
-		)
-	);
-	if( !board_texture )
-	{
-		wcerr << "Couldn't create wood texture" << endl;
-		return 1;
-	}
-
 
 	// If on windows and not in debug mode, detach the console
 	#ifdef  _WIN32
@@ -230,281 +472,409 @@ int main( int argc, char **argv )
 	#endif
 
 
-	// Fetch list of the game files to go through
-	vector<string> remaining_files;
+	// Parse the games ahead on a thread of their own,
+	// at least one for every board
+	auto tiles_per_window = wall_columns * wall_rows;
+	auto loader_queue     = max( prefetch_games, tiles_per_window * window_count );
 
-	try
-	{
-		vector<string> remaining_directories;
+	unique_ptr<corpus::GameLoader> loader;
+	gui::Session                   session;
 
-		remaining_directories.push_back( string(argv[1]) );
+	// Without a seed to repeat, the first games start while the walk
+	// goes on in the background, drawn at random from what it has found
+	thread       discovery;
+	atomic<bool> stop_discovery{ false };
+	atomic<bool> games_found{ false };
 
-		while( remaining_directories.size() > 0 )
+	if( !seed_given && session_path.empty() )
+	{
+		loader.reset( new corpus::GameLoader( seed, loader_queue ) );
+
+		discovery = thread( [&]()
 		{
-			vector<string> new_directories;
-			for( auto& directory : remaining_directories )
+			tools::set_thread_name( "discovery" );
+
+			auto add_games = [&]( vector<string>& paths )
+			{
+				paths.erase(
+					remove_if( paths.begin(), paths.end(), [&]( const string& path )
+					{
+						return duplicate_files.count( path ) > 0;
+					} ),
+					paths.end()
+				);
+
+				if( !paths.empty() )
+				{
+					games_found = true;
+				}
+				loader->add_files( paths );
+			};
+
+			try
 			{
-				auto items = tools::get_directory_listing( directory + "/" );
-				for( auto& item : items )
+				// With a catalog the walk is the catalog scan, which only
+				// lists the directories that changed and leaves out the
+				// files known to be broken. The first one creates it.
+				if( !catalog_path.empty() )
+				{
+					corpus::CatalogOptions catalog_options;
+					catalog_options.parse_files = false;
+					catalog_options.cancel      = &stop_discovery;
+					catalog_options.on_games    = add_games;
+
+					corpus::update_catalog( argv[1], catalog_path, catalog_options );
+				}
+				else
 				{
-					if( item.type == tools::DirectoryItemType::DIRECTORY )
+					tools::walk_directory( argv[1], ".sgf", false, [&]( vector<tools::FoundFile>& found )
 					{
-						if( !item.name.compare( "." ) || !item.name.compare( ".." ) )
+						vector<string> paths;
+						for( auto& file : found )
 						{
-							continue;
+							paths.push_back( move( file.path ) );
 						}
 
-						new_directories.push_back( directory + "/" + item.name );
-						continue;
-					}
-
-					remaining_files.push_back( directory + "/" + item.name );
+						add_games( paths );
+						return !stop_discovery;
+					} );
 				}
 			}
-			remaining_directories = new_directories;
-		}
+			catch( exception &e )
+			{
+				wcerr << "Ran into an error: " << e.what() << endl;
+			}
+
+			loader->finish_adding();
+		} );
 	}
-	catch( std::runtime_error &e )
+
+	auto defer_stop_discovery = tools::make_defer( [&]()
 	{
-		wcout << "Ran into an error: " << e.what() << endl;
-	}
-	catch( ... )
+		stop_discovery = true;
+		if( discovery.joinable() )
+		{
+			discovery.join();
+		}
+	} );
+
+	// A repeatable order needs every file first
+	if( !loader )
 	{
-		wcout << "Ran into an unhandled exception." << endl;
-	}
+		vector<string> remaining_files;
 
-	// Shuffle the order of the files
-	std::random_shuffle( remaining_files.begin(), remaining_files.end() );
+		try
+		{
+			// In the same order as a walk would give them
+			if( !catalog_path.empty() )
+			{
+				remaining_files = corpus::catalog_games( argv[1], catalog_path );
+				sort( remaining_files.begin(), remaining_files.end() );
+			}
 
+			if( remaining_files.empty() )
+			{
+				remaining_files = corpus::find_game_files( argv[1] );
+			}
 
-	// Grab the first game
-	go::Goban goban;
-	sgf::Node current_game_node;
+			// Leave out the games listed as duplicates
+			remaining_files.erase(
+				remove_if( remaining_files.begin(), remaining_files.end(), [&]( const string& path )
+				{
+					return duplicate_files.count( path ) > 0;
+				} ),
+				remaining_files.end()
+			);
+		}
+		catch( std::runtime_error &e )
+		{
+			wcout << "Ran into an error: " << e.what() << endl;
+		}
+		catch( ... )
+		{
+			wcout << "Ran into an unhandled exception." << endl;
+		}
 
-	while( current_game_node.children.size() == 0 )
-	{
 		if( !remaining_files.size() )
 		{
 			wcerr << "No games found." << endl;
 			return 1;
 		}
 
-		current_game_node = read_sgf_file( remaining_files.back() );
-		remaining_files.pop_back();
+		// Shuffle the order of the files, the same seed gives the same order
+		wcout << "Shuffling the games with seed " << seed << endl;
+		shuffle( remaining_files.begin(), remaining_files.end(), mt19937_64( seed ) );
+
+		// What the session starts with, recorded once the main loop starts
+		if( !session_path.empty() )
+		{
+			session.seed             = seed;
+			session.move_interval_ns = static_cast<uint64_t>(
+				chrono::duration_cast<chrono::nanoseconds>( move_interval ).count()
+			);
+			session.wall_columns     = wall_columns;
+			session.wall_rows        = wall_rows;
+			session.games            = remaining_files;
+			for( auto& window : Globals::windows )
+			{
+				session.window_sizes.push_back( {
+					static_cast<int>( window.width ),
+					static_cast<int>( window.height )
+				} );
+			}
+		}
+
+		loader.reset( new corpus::GameLoader( move( remaining_files ), loader_queue ) );
 	}
 
-	// Grab the size property
-	size_t board_size = 19;
-	auto size_property = current_game_node.properties[L"SZ"];
-	if( size_property.size() )
+	// Set up the boards of every window, the opening statistics
+	// are only printed when there's just one board
+	auto single_board = tiles_per_window * window_count == 1;
+
+	vector<unique_ptr<WallWindow>> walls;
+	for( auto& window : Globals::windows )
 	{
-		board_size = sgf::property_value_to<size_t>( size_property[0] );
-	}
+		walls.emplace_back( new WallWindow );
 
-	goban = go::Goban{ board_size };
+		auto& wall = *walls.back();
+		vector<const go::SnapshotPublisher*> tiles;
+		for( size_t i = 0; i < tiles_per_window; i++ )
+		{
+			wall.replays.emplace_back( new gui::Replay(
+				move_interval,
+				single_board ? opening_tree.get() : nullptr
+			) );
+			tiles.push_back( &wall.replays.back()->get_publisher() );
+		}
 
-	auto tmp_node = current_game_node.children.front();
-	current_game_node = tmp_node;
+		wall.worker.reset( new gui::RenderWorker(
+			window.window.get(),
+			board_surface.get(),
+			move( tiles ),
+			wall_columns,
+			wall_rows,
+			static_cast<int>( window.width ),
+			static_cast<int>( window.height ),
+			font_path
+		) );
+	}
 
 
 
 	/* Start main loop */
 
-	SDL_Event event;
+	using Clock = gui::MoveScheduler::Clock;
 
-	auto next_move_time = chrono::system_clock::now();
+	SDL_Event          event;
+	gui::RenderCommand command;
 
+	// Window events that didn't fit in a render queue yet
+	bool posts_pending = false;
 
-	while( !Globals::should_quit )
+	// The replays advance once per display refresh at most, however
+	// fast they run, and only the resulting positions get drawn
+	auto refresh_rate = 60;
 	{
-		while( SDL_PollEvent( &event ) )
+		SDL_DisplayMode mode;
+		auto display = SDL_GetWindowDisplayIndex( Globals::windows[0].window.get() );
+		if( display >= 0 && !SDL_GetCurrentDisplayMode( display, &mode ) && mode.refresh_rate > 0 )
 		{
-			handle_sdl_event( event );
+			refresh_rate = mode.refresh_rate;
 		}
+	}
 
-		this_thread::sleep_until( next_move_time );
-		
-		next_move_time = chrono::system_clock::now() + chrono::milliseconds( 500 );
-
+	auto update_period = chrono::duration_cast<Clock::duration>( chrono::seconds( 1 ) ) / refresh_rate;
+	auto move_budget   = chrono::duration_cast<Clock::duration>( update_period * move_budget_share );
+	auto next_update   = Clock::now();
 
-		// Play the move out
-		sgf::Point move{ 0, 0 };
-		go::Side player;
+	unique_ptr<gui::SessionRecorder> recorder;
+	if( !session_path.empty() )
+	{
+		session.update_period_ns = static_cast<uint64_t>(
+			chrono::duration_cast<chrono::nanoseconds>( update_period ).count()
+		);
 
 		try
 		{
-			if( current_game_node.properties[L"B"].size() )
-			{
-				player = go::Side::BLACK;
-				move = sgf::property_value_to<sgf::Point>(
-					current_game_node.properties[L"B"][0]
-				);
-			}
-			else if( current_game_node.properties[L"W"].size() )
+			recorder.reset( new gui::SessionRecorder( session_path, session ) );
+		}
+		catch( exception &e )
+		{
+			wcerr << e.what() << endl;
+			return 1;
+		}
+	}
+
+	auto handle_event = [&]()
+	{
+		if( recorder && event.type == SDL_KEYDOWN )
+		{
+			recorder->record_key( event.key.keysym.sym );
+		}
+		handle_sdl_event( event, walls );
+	};
+
+
+	while( !Globals::should_quit )
+	{
+		// Sleep until there's input or a move falls due, or shortly
+		// when a render thread has yet to take everything
+		auto now  = Clock::now();
+		auto wait = Clock::duration( chrono::seconds( 1 ) );
+		if( posts_pending )
+		{
+			wait = chrono::milliseconds( 4 );
+		}
+
+		auto until_update = next_update > now ? next_update - now : Clock::duration::zero();
+		for( auto& wall : walls )
+		{
+			for( auto& replay : wall->replays )
 			{
-				player = go::Side::WHITE;
-				move = sgf::property_value_to<sgf::Point>(
-					current_game_node.properties[L"W"][0]
-				);
+				wait = min( wait, max( replay->get_scheduler().time_until_next( now ), until_update ) );
 			}
-			else
+		}
+
+		auto wait_ms = chrono::duration_cast<chrono::milliseconds>(
+			wait + chrono::microseconds( 999 )
+		).count();
+
+		if( SDL_WaitEventTimeout( &event, static_cast<int>( wait_ms ) ) )
+		{
+			PROFILE_SCOPE( "events" );
+
+			handle_event();
+			while( SDL_PollEvent( &event ) )
 			{
-				wcerr << "Skip!" << endl;
-				current_game_node = current_game_node.children[0];
-				continue;
+				handle_event();
 			}
+		}
 
-			go::Stone new_stone = {
-				move.x,
-				move.y,
-				player
-			};
-
-			goban.play_stone( new_stone );
 
+		// Play out the moves that are due, within a share of the frame
+		now = Clock::now();
+		bool all_finished = true;
+		if( now >= next_update )
+		{
+			next_update = now + update_period;
 
-			// Move to the next game if this one's played out
-			if( !current_game_node.children.size() )
+			auto deadline = now + move_budget;
+			for( auto& wall : walls )
 			{
-				current_game_node = {};
-				while( current_game_node.children.size() == 0 )
+				for( auto& replay : wall->replays )
 				{
-					if( !remaining_files.size() )
+					if( replay->update( *loader, now, deadline ) )
 					{
-						wcerr << "No games left" << endl;
-						return 0;
+						wall->new_positions = true;
 					}
-
-					current_game_node = read_sgf_file( remaining_files.back() );
-
-					// Grab the size property
-					board_size = 19;
-					auto size_property = current_game_node.properties[L"SZ"];
-					if( size_property.size() )
-					{
-						board_size = sgf::property_value_to<size_t>( size_property[0] );
-					}
-
-					goban = go::Goban{ board_size };
-
-					remaining_files.pop_back();
 				}
-				tmp_node = current_game_node.children.front();
-				current_game_node = tmp_node;
 			}
+		}
 
-			// Otherwise just go to the next move
-			else
+		for( auto& wall : walls )
+		{
+			for( auto& replay : wall->replays )
 			{
-				tmp_node = current_game_node.children.front();
-				current_game_node = tmp_node;
+				all_finished = all_finished && replay->is_finished( *loader );
 			}
 		}
-		catch( ... )
+
+		if( all_finished )
 		{
+			// Nothing turned up while the walk went on, like an empty
+			// list when the files are known up front
+			if( discovery.joinable() && !games_found )
+			{
+				wcerr << "No games found." << endl;
+				return 1;
+			}
 
+			wcerr << "No games left" << endl;
+			return 0;
 		}
 
 
-		// Render board
-
-		auto& window = Globals::windows[0];
-		double step_size = (window.width < window.height ?
-			window.width : window.height) / (board_size + 1);
-
-		auto stone_size = step_size - step_size / 5;
-
-		SDL_SetRenderDrawColor( window.renderer.get(), 0, 0, 0, 255 );
-		SDL_RenderClear( window.renderer.get() );
-		SDL_SetRenderDrawColor( window.renderer.get(), 0, 0, 0, 255 );
-
-		SDL_Rect board_rect =
+		// Remove closed windows along with their boards,
+		// stopping the render thread before the window goes
+		bool windows_removed = false;
+		for( size_t i = 0; i < Globals::windows.size(); )
 		{
-			static_cast<int>(step_size/2.f),
-			static_cast<int>(step_size/2.f),
-			static_cast<int>(board_size * step_size),
-			static_cast<int>(board_size * step_size)
-		};
-
-		SDL_RenderCopy(
-			window.renderer.get(),
-			board_texture.get(),
-			nullptr,
-			&board_rect
-		);
+			if( !Globals::windows[i].closed && !walls[i]->worker->has_failed() )
+			{
+				i++;
+				continue;
+			}
 
-		// Render lines
+			walls.erase( walls.begin() + i );
+			Globals::windows.erase( Globals::windows.begin() + i );
+			windows_removed = true;
+		}
 
-		for( size_t y = 1; y <= board_size; y++ )
+		if( windows_removed )
 		{
-			SDL_RenderDrawLine(
-				window.renderer.get(),
-				static_cast<int>(step_size),
-				static_cast<int>(y*step_size),
-				static_cast<int>(board_size * step_size),
-				static_cast<int>(y*step_size)
-			);
+			update_window_lookup();
 		}
 
-		for( size_t x = 1; x <= board_size; x++ )
+		if( Globals::windows.empty() )
 		{
-			SDL_RenderDrawLine(
-				window.renderer.get(),
-				static_cast<int>(x*step_size),
-				static_cast<int>(step_size ),
-				static_cast<int>(x*step_size),
-				static_cast<int>(board_size * step_size)
-			);
+			break;
 		}
 
-		// Render stones
 
-		auto& stones = goban.get_board();
-		for( auto& stone : stones )
+		// Tell the render threads about window events and new positions,
+		// without ever waiting on them
+		posts_pending = false;
+		for( size_t i = 0; i < Globals::windows.size(); i++ )
 		{
-			if( stone.side == go::Side::NONE )
+			auto& window = Globals::windows[i];
+			auto& wall   = *walls[i];
+			auto  posted = false;
+
+			auto post = [&]( gui::RenderCommand::Type type ) -> bool
 			{
-				continue;
-			}
+				command.type = type;
+				if( wall.worker->post( command ) )
+				{
+					posted = true;
+					return true;
+				}
+
+				posts_pending = true;
+				return false;
+			};
 
-			else if( stone.side == go::Side::BLACK )
+			if( wall.targets_reset && post( gui::RenderCommand::RESET ) )
 			{
-				SDL_SetRenderDrawColor( window.renderer.get(), 0, 0, 0, 255 );
+				wall.targets_reset = false;
 			}
-			else
+
+			command.move_numbers = Globals::show_move_numbers;
+			command.profile      = Globals::show_profile;
+			if( wall.options_changed && post( gui::RenderCommand::OPTIONS ) )
 			{
-				SDL_SetRenderDrawColor( window.renderer.get(), 255, 255, 255, 255 );
+				wall.options_changed = false;
 			}
 
-			SDL_Rect stone_rect
+			command.width  = static_cast<int>( window.width );
+			command.height = static_cast<int>( window.height );
+			if( window.size_changed && post( gui::RenderCommand::RESIZE ) )
 			{
-				static_cast<int>((stone.x+1) * step_size - stone_size / 2),
-				static_cast<int>((stone.y+1) * step_size - stone_size / 2),
-				static_cast<int>(stone_size),
-				static_cast<int>(stone_size)
-			};
-
-			SDL_RenderFillRect( window.renderer.get(), &stone_rect );
-		}
-
+				window.size_changed = false;
+			}
 
-		// Remove closed windows and render all windows
-		lock_guard<mutex> windows_lock{ Globals::windows_mutex };
-		for( auto it = Globals::windows.begin();
-		     it != Globals::windows.end(); )
-		{
-			if( (*it).closed )
+			if( window.needs_redraw && post( gui::RenderCommand::REDRAW ) )
 			{
-				it = Globals::windows.erase( it );
-				continue;
+				window.needs_redraw = false;
 			}
 
-			SDL_RenderPresent( (*it).renderer.get() );
-			++it;
+			if( posted || wall.new_positions )
+			{
+				wall.worker->wake();
+				wall.new_positions = false;
+			}
 		}
 	}
 
 
 	return 0;
 }
-
@@ -0,0 +1,158 @@
+#include "metrics.hh"
+
+#include <cstdio>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment( lib, "psapi.lib" )
+#else
+#include <unistd.h>
+#endif
+
+
+using namespace std;
+
+
+tools::Metrics tools::metrics;
+
+
+
+tools::Histogram::Histogram( initializer_list<double> bounds_seconds )
+: bucket_count( 0 ),
+  sum_ns( 0 )
+{
+	for( auto bound : bounds_seconds )
+	{
+		if( bucket_count == max_buckets )
+		{
+			break;
+		}
+
+		bounds_ns[bucket_count++] = static_cast<uint64_t>( bound * 1e9 );
+	}
+
+	for( auto& count : counts )
+	{
+		count = 0;
+	}
+}
+
+
+
+void tools::Histogram::observe( uint64_t nanoseconds )
+{
+	size_t bucket = 0;
+	while( bucket < bucket_count && nanoseconds > bounds_ns[bucket] )
+	{
+		bucket++;
+	}
+
+	counts[bucket].fetch_add( 1, memory_order_relaxed );
+	sum_ns.fetch_add( nanoseconds, memory_order_relaxed );
+}
+
+
+
+void tools::Histogram::write( string& out, const char *name, const char *help ) const
+{
+	char line[160];
+	snprintf( line, sizeof( line ), "# HELP %s %s\n# TYPE %s histogram\n", name, help, name );
+	out += line;
+
+	// Buckets are cumulative in the format
+	uint64_t total = 0;
+	for( size_t i = 0; i <= bucket_count; i++ )
+	{
+		total += counts[i].load( memory_order_relaxed );
+
+		if( i < bucket_count )
+		{
+			snprintf( line, sizeof( line ), "%s_bucket{le=\"%g\"} %llu\n",
+			          name, bounds_ns[i] / 1e9, static_cast<unsigned long long>( total ) );
+		}
+		else
+		{
+			snprintf( line, sizeof( line ), "%s_bucket{le=\"+Inf\"} %llu\n",
+			          name, static_cast<unsigned long long>( total ) );
+		}
+		out += line;
+	}
+
+	snprintf( line, sizeof( line ), "%s_sum %.9f\n%s_count %llu\n",
+	          name, sum_ns.load( memory_order_relaxed ) / 1e9,
+	          name, static_cast<unsigned long long>( total ) );
+	out += line;
+}
+
+
+
+void write_value( string& out, const char *name, const char *type, const char *help, long long value )
+{
+	char line[200];
+	snprintf( line, sizeof( line ), "# HELP %s %s\n# TYPE %s %s\n%s %lld\n",
+	          name, help, name, type, name, value );
+	out += line;
+}
+
+
+
+string tools::metrics_text()
+{
+	string out;
+
+	write_value( out, "visualis_games_loaded_total", "counter",
+	             "Games parsed and queued for replay",
+	             static_cast<long long>( metrics.games_loaded.get() ) );
+	write_value( out, "visualis_parse_failures_total", "counter",
+	             "Files skipped because they couldn't be read or parsed",
+	             static_cast<long long>( metrics.parse_failures.get() ) );
+	metrics.parse_seconds.write( out, "visualis_parse_seconds",
+	                             "Time to read and parse a game" );
+	write_value( out, "visualis_moves_played_total", "counter",
+	             "Moves played by every replay, rate() gives moves per second",
+	             static_cast<long long>( metrics.moves_played.get() ) );
+	metrics.frame_seconds.write( out, "visualis_frame_seconds",
+	                             "Time to render and present a frame" );
+	write_value( out, "visualis_loader_queue_depth", "gauge",
+	             "Games parsed ahead and waiting for a replay",
+	             static_cast<long long>( metrics.loader_queue_depth.get() ) );
+	write_value( out, "process_resident_memory_bytes", "gauge",
+	             "Resident memory size in bytes",
+	             static_cast<long long>( resident_memory_bytes() ) );
+
+	return out;
+}
+
+
+
+#ifdef _WIN32
+
+uint64_t tools::resident_memory_bytes()
+{
+	PROCESS_MEMORY_COUNTERS counters;
+	if( !GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+	{
+		return 0;
+	}
+
+	return counters.WorkingSetSize;
+}
+
+#else
+
+uint64_t tools::resident_memory_bytes()
+{
+	// Total and resident size in pages
+	ifstream statm( "/proc/self/statm" );
+	uint64_t total, resident;
+	if( !(statm >> total >> resident) )
+	{
+		return 0;
+	}
+
+	return resident * static_cast<uint64_t>( sysconf( _SC_PAGESIZE ) );
+}
+
+#endif
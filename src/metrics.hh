@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <initializer_list>
+
+
+// Counters, gauges and histograms of a running viewer, for scraping in
+// the Prometheus text format
+// - Updating a metric is a relaxed atomic operation and nothing else,
+//   most of them only ever change on one thread. Reading them for an
+//   export never holds up the threads updating them.
+// - Every metric lives in the one global Metrics
+namespace tools
+{
+	class Counter
+	{
+		std::atomic<uint64_t> value{ 0 };
+
+
+	  public:
+		void add( uint64_t amount = 1 )
+		{
+			value.fetch_add( amount, std::memory_order_relaxed );
+		}
+
+		uint64_t get() const
+		{
+			return value.load( std::memory_order_relaxed );
+		}
+	};
+
+
+
+	class Gauge
+	{
+		std::atomic<int64_t> value{ 0 };
+
+
+	  public:
+		void add( int64_t amount )
+		{
+			value.fetch_add( amount, std::memory_order_relaxed );
+		}
+
+		int64_t get() const
+		{
+			return value.load( std::memory_order_relaxed );
+		}
+	};
+
+
+
+	// Durations counted into buckets with fixed upper bounds
+	class Histogram
+	{
+	  public:
+		static const size_t max_buckets = 16;
+
+
+	  private:
+		uint64_t              bounds_ns[max_buckets];
+		size_t                bucket_count;
+		std::atomic<uint64_t> counts[max_buckets + 1]; // The last one is +Inf
+		std::atomic<uint64_t> sum_ns;
+
+
+	  public:
+		// Upper bounds in seconds, ascending, up to max_buckets
+		Histogram( std::initializer_list<double> bounds_seconds );
+
+		void observe( uint64_t nanoseconds );
+
+		// Appends the buckets, the sum and the count
+		void write( std::string& out, const char *name, const char *help ) const;
+	};
+
+
+
+	struct Metrics
+	{
+		Counter   games_loaded;
+		Counter   parse_failures;
+		Histogram parse_seconds{ 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1 };
+		Counter   moves_played;
+		Histogram frame_seconds{ 0.001, 0.002, 0.004, 0.008, 0.016, 0.033, 0.066, 0.1, 0.25, 0.5, 1 };
+		Gauge     loader_queue_depth; // Over every loader
+	};
+
+	extern Metrics metrics;
+
+
+	// Every metric in the Prometheus text exposition format, with the
+	// resident memory of the process read at the time
+	std::string metrics_text();
+
+	// 0 where it can't be read
+	uint64_t resident_memory_bytes();
+}
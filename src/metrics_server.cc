@@ -0,0 +1,284 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment( lib, "Ws2_32.lib" )
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+#include "metrics_server.hh"
+#include "metrics.hh"
+#include "profiler.hh"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+
+using namespace std;
+using namespace tools;
+
+
+#ifdef _WIN32
+using Socket = SOCKET;
+const Socket no_socket = INVALID_SOCKET;
+
+void close_socket( Socket socket )
+{
+	closesocket( socket );
+}
+
+const int send_flags = 0;
+#else
+using Socket = int;
+const Socket no_socket = -1;
+
+// A client hanging up mid-response mustn't raise SIGPIPE, which would
+// end the whole viewer
+const int send_flags = MSG_NOSIGNAL;
+
+void close_socket( Socket socket )
+{
+	close( socket );
+}
+#endif
+
+
+// How often the thread looks whether it should stop, and how long a
+// client gets to send its request
+const long poll_interval_ms    = 200;
+const long request_timeout_ms  = 1000;
+const size_t max_request_bytes = 4096;
+
+
+
+// Waits until the socket can be read or the time is up
+bool wait_readable( Socket socket, long milliseconds )
+{
+	fd_set sockets;
+	FD_ZERO( &sockets );
+	FD_SET( socket, &sockets );
+
+	timeval timeout;
+	timeout.tv_sec  = milliseconds / 1000;
+	timeout.tv_usec = (milliseconds % 1000) * 1000;
+
+	return select( static_cast<int>( socket + 1 ), &sockets, nullptr, nullptr, &timeout ) > 0;
+}
+
+
+
+void send_all( Socket socket, const string& data )
+{
+	size_t sent = 0;
+	while( sent < data.size() )
+	{
+		auto result = send( socket, data.data() + sent, static_cast<int>( data.size() - sent ), send_flags );
+		if( result <= 0 )
+		{
+			return;
+		}
+		sent += static_cast<size_t>( result );
+	}
+}
+
+
+
+string http_response( const char *status, const char *content_type, const string& body )
+{
+	return string( "HTTP/1.0 " ) + status + "\r\n"
+	       "Content-Type: " + content_type + "\r\n"
+	       "Content-Length: " + to_string( body.size() ) + "\r\n"
+	       "Connection: close\r\n"
+	       "\r\n" + body;
+}
+
+
+
+MetricsServer::MetricsServer( uint16_t port )
+: listener( static_cast<uintptr_t>( no_socket ) ),
+  stopping( false )
+{
+	#ifdef _WIN32
+	WSADATA wsa_data;
+	if( WSAStartup( MAKEWORD( 2, 2 ), &wsa_data ) )
+	{
+		throw runtime_error( "Couldn't start Winsock" );
+	}
+	#endif
+
+	auto socket_handle = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+	if( socket_handle == no_socket )
+	{
+		#ifdef _WIN32
+		WSACleanup();
+		#endif
+		throw runtime_error( "Couldn't create the metrics socket" );
+	}
+	listener = static_cast<uintptr_t>( socket_handle );
+
+	int reuse = 1;
+	setsockopt( socket_handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>( &reuse ), sizeof( reuse ) );
+
+	sockaddr_in address;
+	memset( &address, 0, sizeof( address ) );
+	address.sin_family      = AF_INET;
+	address.sin_port        = htons( port );
+	address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+	if( ::bind( socket_handle, reinterpret_cast<sockaddr*>( &address ), sizeof( address ) ) ||
+	    listen( socket_handle, 4 ) )
+	{
+		close_socket( socket_handle );
+		#ifdef _WIN32
+		WSACleanup();
+		#endif
+		throw runtime_error( "Couldn't listen on 127.0.0.1:" + to_string( port ) );
+	}
+
+	start();
+}
+
+
+
+MetricsServer::MetricsServer( const string& path )
+: listener( static_cast<uintptr_t>( no_socket ) ),
+  stopping( false )
+{
+	#ifdef _WIN32
+	throw runtime_error( "Unix sockets aren't supported on Windows, use a port" );
+	#else
+	sockaddr_un address;
+	memset( &address, 0, sizeof( address ) );
+	if( path.size() >= sizeof( address.sun_path ) )
+	{
+		throw runtime_error( "The socket path is too long: " + path );
+	}
+	address.sun_family = AF_UNIX;
+	strncpy( address.sun_path, path.c_str(), sizeof( address.sun_path ) - 1 );
+
+	auto socket_handle = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( socket_handle == no_socket )
+	{
+		throw runtime_error( "Couldn't create the metrics socket" );
+	}
+
+	// A socket left over from an earlier run
+	unlink( path.c_str() );
+
+	if( ::bind( socket_handle, reinterpret_cast<sockaddr*>( &address ), sizeof( address ) ) ||
+	    listen( socket_handle, 4 ) )
+	{
+		close_socket( socket_handle );
+		throw runtime_error( "Couldn't listen on " + path );
+	}
+
+	listener    = static_cast<uintptr_t>( socket_handle );
+	socket_path = path;
+
+	start();
+	#endif
+}
+
+
+
+MetricsServer::~MetricsServer()
+{
+	stopping = true;
+	if( thread.joinable() )
+	{
+		thread.join();
+	}
+
+	close_socket( static_cast<Socket>( listener ) );
+
+	#ifdef _WIN32
+	WSACleanup();
+	#else
+	if( !socket_path.empty() )
+	{
+		unlink( socket_path.c_str() );
+	}
+	#endif
+}
+
+
+
+void MetricsServer::start()
+{
+	thread = std::thread( &MetricsServer::run, this );
+}
+
+
+
+void MetricsServer::run()
+{
+	set_thread_name( "metrics" );
+
+	auto listen_socket = static_cast<Socket>( listener );
+	while( !stopping )
+	{
+		if( !wait_readable( listen_socket, poll_interval_ms ) )
+		{
+			continue;
+		}
+
+		auto connection = accept( listen_socket, nullptr, nullptr );
+		if( connection == no_socket )
+		{
+			continue;
+		}
+
+		serve( static_cast<uintptr_t>( connection ) );
+		close_socket( connection );
+	}
+}
+
+
+
+void MetricsServer::serve( uintptr_t connection )
+{
+	auto client = static_cast<Socket>( connection );
+
+	// Only the request line matters, the headers are read past
+	string request;
+	char   buffer[1024];
+	while( request.find( "\r\n\r\n" ) == string::npos && request.size() < max_request_bytes )
+	{
+		if( !wait_readable( client, request_timeout_ms ) )
+		{
+			return;
+		}
+
+		auto received = recv( client, buffer, sizeof( buffer ), 0 );
+		if( received <= 0 )
+		{
+			break;
+		}
+		request.append( buffer, static_cast<size_t>( received ) );
+	}
+
+	auto line_end = request.find( "\r\n" );
+	auto line     = request.substr( 0, line_end );
+
+	if( line.compare( 0, 4, "GET " ) )
+	{
+		send_all( client, http_response( "405 Method Not Allowed", "text/plain", "Only GET\n" ) );
+		return;
+	}
+
+	auto path = line.substr( 4, line.find( ' ', 4 ) - 4 );
+	if( path != "/metrics" && path != "/" )
+	{
+		send_all( client, http_response( "404 Not Found", "text/plain", "Try /metrics\n" ) );
+		return;
+	}
+
+	send_all( client, http_response( "200 OK", "text/plain; version=0.0.4", metrics_text() ) );
+}
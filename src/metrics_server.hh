@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <cstdint>
+
+
+namespace tools
+{
+	// Serves metrics_text() over HTTP on a thread of its own, at
+	// /metrics, for a Prometheus scraper or curl
+	// - Listens on loopback only, or on a Unix socket where there are
+	//   those, so that nothing is exposed to the network
+	// - Requests are answered one at a time and the connection closed,
+	//   scrapes are rare and small
+	class MetricsServer
+	{
+		uintptr_t         listener;
+		std::string       socket_path; // Removed again at the end
+		std::atomic<bool> stopping;
+		std::thread       thread;
+
+
+	  public:
+		// Port on 127.0.0.1, throws if it can't be listened on
+		explicit MetricsServer( uint16_t port );
+
+		// Unix socket at the path, throws likewise and always on Windows
+		explicit MetricsServer( const std::string& path );
+
+		~MetricsServer();
+
+		MetricsServer( const MetricsServer& ) = delete;
+		MetricsServer& operator=( const MetricsServer& ) = delete;
+
+
+	  private:
+		void start();
+		void run();
+		void serve( uintptr_t connection );
+	};
+}
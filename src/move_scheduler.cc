@@ -0,0 +1,123 @@
+#include "move_scheduler.hh"
+
+#include <algorithm>
+
+
+using namespace std;
+using namespace gui;
+
+
+MoveScheduler::Clock::duration clamp_interval( MoveScheduler::Clock::duration interval )
+{
+	// 10 000 moves a second for skimming, a move every 10 seconds
+	// for slow motion
+	const MoveScheduler::Clock::duration min_interval = chrono::microseconds( 100 );
+	const MoveScheduler::Clock::duration max_interval = chrono::seconds( 10 );
+
+	return min( max( interval, min_interval ), max_interval );
+}
+
+
+
+MoveScheduler::MoveScheduler( Clock::duration move_interval )
+: interval( clamp_interval( move_interval ) ),
+  next_move( Clock::now() ),
+  paused( false )
+{
+}
+
+
+
+size_t MoveScheduler::take_due_moves( Clock::time_point now, size_t max_moves )
+{
+	if( paused )
+	{
+		return 0;
+	}
+
+	if( next_move > now || !max_moves )
+	{
+		return 0;
+	}
+
+	// Count the due moves instead of stepping through them,
+	// at high speeds there are hundreds between frames
+	auto due   = static_cast<size_t>( (now - next_move) / interval ) + 1;
+	auto moves = min( due, max_moves );
+	next_move += interval * static_cast<Clock::rep>( moves );
+
+	if( next_move <= now )
+	{
+		next_move = now + interval;
+	}
+
+	return moves;
+}
+
+
+
+MoveScheduler::Clock::duration MoveScheduler::time_until_next( Clock::time_point now ) const
+{
+	if( paused )
+	{
+		return Clock::duration::max();
+	}
+
+	if( next_move <= now )
+	{
+		return Clock::duration::zero();
+	}
+
+	return next_move - now;
+}
+
+
+
+void MoveScheduler::set_interval( Clock::duration move_interval )
+{
+	move_interval = clamp_interval( move_interval );
+
+	// Keep the next move where it would be with the new pace
+	next_move += move_interval - interval;
+	interval   = move_interval;
+}
+
+
+
+MoveScheduler::Clock::duration MoveScheduler::get_interval() const
+{
+	return interval;
+}
+
+
+
+void MoveScheduler::faster()
+{
+	set_interval( interval / 2 );
+}
+
+
+
+void MoveScheduler::slower()
+{
+	set_interval( interval * 2 );
+}
+
+
+
+void MoveScheduler::set_paused( bool pause )
+{
+	if( paused && !pause )
+	{
+		next_move = Clock::now() + interval;
+	}
+
+	paused = pause;
+}
+
+
+
+bool MoveScheduler::is_paused() const
+{
+	return paused;
+}
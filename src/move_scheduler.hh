@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+
+namespace gui
+{
+	// Paces the replay on a monotonic clock, independent of how often
+	// frames are drawn. Several moves can fall due between two frames
+	// when the replay is faster than the display.
+	class MoveScheduler
+	{
+	  public:
+		using Clock = std::chrono::steady_clock;
+
+
+	  private:
+		Clock::duration   interval;
+		Clock::time_point next_move;
+		bool              paused;
+
+
+	  public:
+		MoveScheduler( Clock::duration move_interval );
+
+		// Takes the moves due by now, at most max_moves of them.
+		// A schedule too far behind is restarted from now rather
+		// than caught up with.
+		size_t take_due_moves( Clock::time_point now, size_t max_moves );
+
+		// Time until the next move is due, zero if one is due already
+		Clock::duration time_until_next( Clock::time_point now ) const;
+
+		void            set_interval( Clock::duration move_interval );
+		Clock::duration get_interval() const;
+
+		// Halve or double the interval, between 100 microseconds
+		// and 10 seconds
+		void faster();
+		void slower();
+
+		void set_paused( bool pause );
+		bool is_paused() const;
+	};
+}
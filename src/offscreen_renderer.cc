@@ -0,0 +1,82 @@
+#include "offscreen_renderer.hh"
+
+#include <stdexcept>
+
+
+using namespace std;
+using namespace gui;
+
+
+
+OffscreenRenderer::OffscreenRenderer(
+	int           width,
+	int           height,
+	SDL_Surface  *wood,
+	const string& font_path
+)
+{
+	surface = sdl2::SurfacePtr( SDL_CreateRGBSurfaceWithFormat(
+		0, width, height, 32, SDL_PIXELFORMAT_ARGB8888
+	) );
+	if( !surface )
+	{
+		throw runtime_error( string( "Couldn't create offscreen surface: " ) + SDL_GetError() );
+	}
+
+	renderer = sdl2::RendererPtr( SDL_CreateSoftwareRenderer( surface.get() ) );
+	if( !renderer )
+	{
+		throw runtime_error( string( "Couldn't create software renderer: " ) + SDL_GetError() );
+	}
+
+	resources.reset( new BoardResources( renderer.get(), wood, font_path ) );
+	if( !resources->is_initialized() )
+	{
+		throw runtime_error( "Couldn't create wood texture" );
+	}
+
+	board_renderer.reset( new BoardRenderer( *resources ) );
+}
+
+
+
+void OffscreenRenderer::render( const go::BoardSnapshot& board )
+{
+	board_renderer->render( board, { 0, 0, surface->w, surface->h } );
+
+	// Batched drawing has to reach the surface before it's read
+	#if SDL_VERSION_ATLEAST( 2, 0, 10 )
+	SDL_RenderFlush( renderer.get() );
+	#endif
+}
+
+
+
+void OffscreenRenderer::invalidate()
+{
+	board_renderer->invalidate();
+}
+
+
+
+void OffscreenRenderer::set_move_numbers( bool show )
+{
+	board_renderer->set_move_numbers( show );
+}
+
+
+
+SDL_Surface* OffscreenRenderer::get_surface() const
+{
+	return surface.get();
+}
+
+
+
+void OffscreenRenderer::save_png( const string& path ) const
+{
+	if( IMG_SavePNG( surface.get(), path.c_str() ) )
+	{
+		throw runtime_error( "Couldn't write '" + path + "': " + IMG_GetError() );
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "sdl2.hh"
+#include "board_snapshot.hh"
+#include "board_renderer.hh"
+
+#include <string>
+
+
+namespace gui
+{
+	// Draws boards into a surface in memory with the software renderer,
+	// for output that never goes to a window. Needs no video driver,
+	// SDL's dummy driver is enough. An OffscreenRenderer may only be
+	// used from one thread at a time, separate ones work in parallel.
+	class OffscreenRenderer
+	{
+		sdl2::SurfacePtr  surface;
+		sdl2::RendererPtr renderer;
+		std::unique_ptr<BoardResources> resources;
+		std::unique_ptr<BoardRenderer>  board_renderer;
+
+
+	  public:
+		// Throws if the surface or the renderer can't be created. The
+		// TrueType font is used if SDL_ttf was initialized, see TextCache.
+		OffscreenRenderer(
+			int                width,
+			int                height,
+			SDL_Surface       *wood,
+			const std::string& font_path = default_font_path
+		);
+
+		// Repaints what changed since the last board
+		void render( const go::BoardSnapshot& board );
+
+		// The next board is drawn from scratch
+		void invalidate();
+
+		void set_move_numbers( bool show );
+
+		// The pixels of the last board, 32 bit ARGB
+		SDL_Surface* get_surface() const;
+
+		// Throws if the file can't be written
+		void save_png( const std::string& path ) const;
+	};
+}
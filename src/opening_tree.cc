@@ -0,0 +1,443 @@
+#include "opening_tree.hh"
+#include "corpus.hh"
+#include "symmetry.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <exception>
+
+
+using namespace std;
+using namespace corpus;
+
+
+
+/*
+	File layout, native byte order:
+
+	TreeHeader
+	OpeningNode[node_count] in breadth first order, the root first
+ */
+
+struct TreeHeader
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t depth;
+	uint64_t node_count;
+};
+
+const char     tree_magic[8] = { 'V', 'I', 'S', 'O', 'P', 'E', 'N', 'T' };
+const uint32_t tree_version  = 1;
+
+
+
+uint16_t move_key( uint8_t x, uint8_t y )
+{
+	return static_cast<uint16_t>( (x << 8) | y );
+}
+
+
+
+sgf::Point corpus::transform_move( sgf::Point point, size_t board_size, size_t symmetry )
+{
+	// Passes stay passes
+	if( point.x == 0 && point.y == 0 )
+	{
+		return point;
+	}
+
+	auto x = point.x - 1;
+	auto y = point.y - 1;
+	go::transform_point( x, y, board_size, symmetry );
+
+	return { x + 1, y + 1 };
+}
+
+
+
+size_t corpus::canonical_symmetry(
+	size_t                   board_size,
+	const vector<sgf::Move>& moves,
+	size_t                   move_count
+)
+{
+	move_count = min( move_count, moves.size() );
+
+	size_t best = 0;
+	for( size_t symmetry = 1; symmetry < go::symmetry_count; symmetry++ )
+	{
+		for( size_t i = 0; i < move_count; i++ )
+		{
+			auto a = transform_move( moves[i].point, board_size, symmetry );
+			auto b = transform_move( moves[i].point, board_size, best );
+
+			auto key_a = move_key( uint8_t( a.x ), uint8_t( a.y ) );
+			auto key_b = move_key( uint8_t( b.x ), uint8_t( b.y ) );
+
+			if( key_a != key_b )
+			{
+				if( key_a < key_b )
+				{
+					best = symmetry;
+				}
+				break;
+			}
+		}
+	}
+
+	return best;
+}
+
+
+
+// Winner from the RE property, 'B', 'W' or 0 for anything else
+char game_winner( const string& result )
+{
+	if( result.size() >= 2 && result[1] == '+' &&
+	    (result[0] == 'B' || result[0] == 'W') )
+	{
+		return result[0];
+	}
+
+	return 0;
+}
+
+
+
+wstring corpus::opening_stats_text( const OpeningNode& node )
+{
+	wstringstream text;
+	text << L"Played in " << node.games << L" games";
+
+	auto decided = node.black_wins + node.white_wins;
+	if( decided )
+	{
+		text << fixed << setprecision( 1 )
+		     << L", B wins " << 100.0 * node.black_wins / decided << L"%";
+	}
+
+	return text.str();
+}
+
+
+
+/* Tree construction */
+
+struct BuildNode
+{
+	vector<pair<uint16_t, uint32_t>> children; // Move key and node index
+	uint32_t games      = 0;
+	uint32_t black_wins = 0;
+	uint32_t white_wins = 0;
+};
+
+
+
+struct BuildTree
+{
+	vector<BuildNode> nodes{ 1 };
+
+
+	uint32_t child( uint32_t parent, uint16_t key )
+	{
+		for( auto& child : nodes[parent].children )
+		{
+			if( child.first == key )
+			{
+				return child.second;
+			}
+		}
+
+		auto index = static_cast<uint32_t>( nodes.size() );
+		nodes.emplace_back();
+		nodes[parent].children.emplace_back( key, index );
+		return index;
+	}
+
+
+	void count( uint32_t index, char winner )
+	{
+		auto& node = nodes[index];
+		node.games++;
+		node.black_wins += (winner == 'B');
+		node.white_wins += (winner == 'W');
+	}
+
+
+	void add_game( const sgf::MainLine& line, size_t depth )
+	{
+		if( line.black_setup.size() || line.white_setup.size() )
+		{
+			return;
+		}
+
+		auto move_count = min( depth, line.moves.size() );
+		auto symmetry   = canonical_symmetry( line.board_size, line.moves, move_count );
+		auto winner     = game_winner( line.result );
+
+		auto node = child( 0, move_key( uint8_t( line.board_size ), 0 ) );
+		count( node, winner );
+
+		for( size_t i = 0; i < move_count; i++ )
+		{
+			auto point = transform_move( line.moves[i].point, line.board_size, symmetry );
+			node = child( node, move_key( uint8_t( point.x ), uint8_t( point.y ) ) );
+			count( node, winner );
+		}
+	}
+
+
+	void merge( const BuildTree& other, uint32_t into = 0, uint32_t from = 0 )
+	{
+		auto& source = other.nodes[from];
+		nodes[into].games      += source.games;
+		nodes[into].black_wins += source.black_wins;
+		nodes[into].white_wins += source.white_wins;
+
+		for( auto& source_child : source.children )
+		{
+			merge( other, child( into, source_child.first ), source_child.second );
+		}
+	}
+
+
+	void write( const string& path, size_t depth )
+	{
+		if( nodes.size() > UINT32_MAX )
+		{
+			throw runtime_error( "Too many nodes for an opening tree" );
+		}
+
+		// Lay the nodes out breadth first, so children are contiguous
+		vector<OpeningNode> out{ 1 };
+		vector<uint32_t>    order{ 0 };
+		memset( &out[0], 0, sizeof( OpeningNode ) );
+
+		for( size_t i = 0; i < order.size(); i++ )
+		{
+			auto& node = nodes[order[i]];
+			sort( node.children.begin(), node.children.end() );
+
+			out[i].first_child = static_cast<uint32_t>( order.size() );
+			out[i].child_count = static_cast<uint32_t>( node.children.size() );
+			out[i].games       = node.games;
+			out[i].black_wins  = node.black_wins;
+			out[i].white_wins  = node.white_wins;
+
+			for( auto& child : node.children )
+			{
+				OpeningNode entry;
+				memset( &entry, 0, sizeof( entry ) );
+				entry.x = static_cast<uint8_t>( child.first >> 8 );
+				entry.y = static_cast<uint8_t>( child.first & 0xff );
+
+				out.push_back( entry );
+				order.push_back( child.second );
+			}
+		}
+
+		TreeHeader header;
+		memcpy( header.magic, tree_magic, sizeof( tree_magic ) );
+		header.version    = tree_version;
+		header.depth      = static_cast<uint32_t>( depth );
+		header.node_count = out.size();
+
+		ofstream file( path, ios_base::out | ios_base::binary | ios_base::trunc );
+		file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+		file.write( reinterpret_cast<const char*>( out.data() ), out.size() * sizeof( OpeningNode ) );
+		if( !file )
+		{
+			throw runtime_error( "Couldn't write the opening tree to '" + path + "'" );
+		}
+	}
+};
+
+
+
+void corpus::build_opening_tree(
+	const string& root_directory,
+	const string& tree_path,
+	size_t        depth
+)
+{
+	auto files = find_game_files( root_directory );
+
+	// Every worker builds a tree of its own, merged at the end
+	vector<BuildTree> trees( tools::worker_thread_count() );
+	atomic<size_t>    broken_count{ 0 };
+
+	tools::parallel_for( files.size(), [&]( size_t index, size_t thread )
+	{
+		try
+		{
+			trees[thread].add_game( read_main_line_file( files[index] ), depth );
+		}
+		catch( exception& )
+		{
+			broken_count++;
+		}
+	} );
+
+	for( size_t i = 1; i < trees.size(); i++ )
+	{
+		trees[0].merge( trees[i] );
+		trees[i] = {};
+	}
+
+	trees[0].write( tree_path, depth );
+
+	wcout << "Opening tree of " << trees[0].nodes.size() << " nodes built from "
+	      << files.size() - broken_count << " games, "
+	      << broken_count << " broken" << endl;
+}
+
+
+
+/* Lookups */
+
+corpus::OpeningTree::OpeningTree( const string& path )
+: file( path ), nodes( nullptr ), node_count( 0 ), depth( 0 )
+{
+	TreeHeader header;
+	if( file.size() < sizeof( header ) )
+	{
+		throw runtime_error( "'" + path + "' is not an opening tree" );
+	}
+
+	memcpy( &header, file.data(), sizeof( header ) );
+	if( memcmp( header.magic, tree_magic, sizeof( tree_magic ) ) ||
+	    header.version != tree_version )
+	{
+		throw runtime_error( "'" + path + "' is not an opening tree" );
+	}
+
+	if( header.node_count < 1 ||
+	    header.node_count > (file.size() - sizeof( header )) / sizeof( OpeningNode ) )
+	{
+		throw runtime_error( "Opening tree '" + path + "' is truncated" );
+	}
+
+	nodes      = reinterpret_cast<const OpeningNode*>( file.data() + sizeof( header ) );
+	node_count = static_cast<size_t>( header.node_count );
+	depth      = header.depth;
+
+	for( size_t i = 0; i < node_count; i++ )
+	{
+		if( nodes[i].first_child + uint64_t( nodes[i].child_count ) > node_count )
+		{
+			throw runtime_error( "Opening tree '" + path + "' is corrupted" );
+		}
+	}
+}
+
+
+
+size_t corpus::OpeningTree::get_depth() const
+{
+	return depth;
+}
+
+
+
+const OpeningNode* corpus::OpeningTree::find_child(
+	const OpeningNode& node,
+	uint8_t            x,
+	uint8_t            y
+) const
+{
+	auto first = nodes + node.first_child;
+	auto last  = first + node.child_count;
+	auto key   = move_key( x, y );
+
+	auto child = lower_bound( first, last, key, []( const OpeningNode& node, uint16_t key )
+	{
+		return move_key( node.x, node.y ) < key;
+	} );
+
+	if( child == last || move_key( child->x, child->y ) != key )
+	{
+		return nullptr;
+	}
+
+	return child;
+}
+
+
+
+const OpeningNode* corpus::OpeningTree::find(
+	size_t                   board_size,
+	const vector<sgf::Move>& moves,
+	size_t                   move_count
+) const
+{
+	if( move_count > depth || move_count > moves.size() || board_size > 255 )
+	{
+		return nullptr;
+	}
+
+	auto node = find_child( nodes[0], uint8_t( board_size ), 0 );
+	auto symmetry = canonical_symmetry( board_size, moves, move_count );
+
+	for( size_t i = 0; i < move_count && node; i++ )
+	{
+		auto point = transform_move( moves[i].point, board_size, symmetry );
+		node = find_child( *node, uint8_t( point.x ), uint8_t( point.y ) );
+	}
+
+	return node;
+}
+
+
+
+int corpus::build_opening_tree_command( const vector<string>& args )
+{
+	if( args.size() < 2 || args.size() > 3 )
+	{
+		wcout << "Usage: --build-opening-tree <directory> <tree file> [depth]" << endl;
+		return 1;
+	}
+
+	size_t depth = 30;
+	if( args.size() > 2 )
+	{
+		depth = stoul( args[2] );
+	}
+
+	build_opening_tree( args[0], args[1], depth );
+	return 0;
+}
+
+
+
+int corpus::query_opening_tree_command( const vector<string>& args )
+{
+	if( args.size() != 2 )
+	{
+		wcout << "Usage: --query-opening-tree <tree file> <sgf file>" << endl;
+		return 1;
+	}
+
+	OpeningTree tree{ args[0] };
+	auto line = read_main_line_file( args[1] );
+
+	for( size_t move_count = 1; move_count <= line.moves.size(); move_count++ )
+	{
+		auto node = tree.find( line.board_size, line.moves, move_count );
+		if( !node )
+		{
+			break;
+		}
+
+		wcout << "Move " << move_count << ": "
+		      << opening_stats_text( *node ) << endl;
+	}
+
+	return 0;
+}
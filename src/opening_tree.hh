@@ -0,0 +1,88 @@
+#pragma once
+
+#include "sgf.hh"
+#include "common_tools.hh"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Prefix tree of the opening moves of a game collection
+// - Built from the main lines, canonicalized by board symmetry so that
+//   the same opening in another corner ends up in the same branch
+// - Every node counts the games through it and who won them, from RE
+// - The file is memory mapped, children of a node are contiguous and
+//   sorted so a lookup is a binary search per move
+// - Games with setup stones are left out, they don't start from an
+//   empty board
+namespace corpus
+{
+	struct OpeningNode
+	{
+		uint32_t first_child;
+		uint32_t child_count;
+		uint32_t games;
+		uint32_t black_wins;
+		uint32_t white_wins;
+		uint8_t  x;           // 1-based like sgf::Point, { 0, 0 } for a pass,
+		uint8_t  y;           //  children of the root are keyed by board size in x
+		uint16_t padding;
+	};
+
+
+
+	class OpeningTree
+	{
+		tools::MappedFile  file;
+		const OpeningNode *nodes;
+		size_t             node_count;
+		size_t             depth;
+
+
+	  public:
+		OpeningTree( const std::string& path );
+
+		size_t get_depth() const;
+
+		// Node reached by the first move_count moves, nullptr if no game
+		// in the collection started that way or if it's past the depth
+		const OpeningNode* find(
+			size_t                        board_size,
+			const std::vector<sgf::Move>& moves,
+			size_t                        move_count
+		) const;
+
+
+	  private:
+		const OpeningNode* find_child( const OpeningNode& node, uint8_t x, uint8_t y ) const;
+	};
+
+
+
+	// Symmetry giving the lexicographically smallest sequence of the
+	// first move_count moves. Every prefix of a canonical sequence is
+	// canonical too, so prefixes can be canonicalized on their own.
+	size_t canonical_symmetry(
+		size_t                        board_size,
+		const std::vector<sgf::Move>& moves,
+		size_t                        move_count
+	);
+
+	sgf::Point transform_move( sgf::Point point, size_t board_size, size_t symmetry );
+
+	// "Played in N games, B wins X%", the rate is over games with a winner
+	std::wstring opening_stats_text( const OpeningNode& node );
+
+
+	void build_opening_tree(
+		const std::string& root_directory,
+		const std::string& tree_path,
+		size_t             depth
+	);
+
+
+	// Command line entry points
+	int build_opening_tree_command( const std::vector<std::string>& args );
+	int query_opening_tree_command( const std::vector<std::string>& args );
+}
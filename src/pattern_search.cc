@@ -0,0 +1,469 @@
+#include "pattern_search.hh"
+#include "corpus.hh"
+#include "common_tools.hh"
+
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <exception>
+#include <unordered_set>
+
+
+using namespace std;
+using namespace corpus;
+
+
+
+// Widest padded board, the biggest SGF board with an off-board frame
+const size_t max_padded_size = 54;
+
+
+
+// Board with a one point wide frame of off-board points around it,
+// as bitboards with one uint64_t per row
+struct PaddedBoard
+{
+	size_t   size;
+	uint64_t black[max_padded_size];
+	uint64_t white[max_padded_size];
+	uint64_t edge[max_padded_size];
+	size_t   black_count;
+	size_t   white_count;
+
+
+	PaddedBoard( size_t board_size )
+	: size( board_size + 2 ), black_count( 0 ), white_count( 0 )
+	{
+		auto outside = ~((1ULL << (board_size + 1)) - 1) | 1ULL;
+
+		for( size_t y = 0; y < max_padded_size; y++ )
+		{
+			black[y] = 0;
+			white[y] = 0;
+			edge[y]  = (y == 0 || y >= size - 1) ? ~0ULL : outside;
+		}
+	}
+
+
+	void update( const vector<go::Stone>& changed_points )
+	{
+		for( auto& point : changed_points )
+		{
+			auto y   = point.y + 1;
+			auto bit = 1ULL << (point.x + 1);
+
+			black_count -= (black[y] & bit) ? 1 : 0;
+			white_count -= (white[y] & bit) ? 1 : 0;
+			black[y] &= ~bit;
+			white[y] &= ~bit;
+
+			if( point.side == go::Side::BLACK )
+			{
+				black[y] |= bit;
+				black_count++;
+			}
+			else if( point.side == go::Side::WHITE )
+			{
+				white[y] |= bit;
+				white_count++;
+			}
+		}
+	}
+
+
+	uint64_t empty( size_t y ) const
+	{
+		return ~(black[y] | white[y] | edge[y]);
+	}
+};
+
+
+
+Pattern::Orientation make_orientation( const vector<string>& grid )
+{
+	Pattern::Orientation orientation;
+	orientation.height        = grid.size();
+	orientation.width         = grid[0].size();
+	orientation.black_count   = 0;
+	orientation.white_count   = 0;
+	orientation.selective_row = 0;
+
+	size_t most_constraints = 0;
+
+	for( size_t y = 0; y < grid.size(); y++ )
+	{
+		uint64_t black = 0, white = 0, empty = 0, edge = 0;
+
+		for( size_t x = 0; x < grid[y].size(); x++ )
+		{
+			auto bit = 1ULL << x;
+			switch( grid[y][x] )
+			{
+				case 'X': black |= bit; orientation.black_count++; break;
+				case 'O': white |= bit; orientation.white_count++; break;
+				case '.': empty |= bit; break;
+				case '#': edge  |= bit; break;
+			}
+		}
+
+		auto row_mask = (orientation.width == 64) ? ~0ULL : (1ULL << orientation.width) - 1;
+
+		orientation.black.push_back( black );
+		orientation.white.push_back( white );
+		orientation.empty.push_back( empty );
+		orientation.edge.push_back( edge );
+		orientation.on_board.push_back( row_mask & ~edge );
+
+		size_t constraints = 0;
+		for( auto bits = black | white | empty | edge; bits; bits &= bits - 1 )
+		{
+			constraints++;
+		}
+
+		if( constraints > most_constraints )
+		{
+			most_constraints = constraints;
+			orientation.selective_row = y;
+		}
+	}
+
+	return orientation;
+}
+
+
+
+corpus::Pattern::Pattern( const vector<string>& rows, bool any_colour )
+{
+	// Clean up the rows, spaces between the cells are allowed
+	vector<string> grid;
+	for( auto& row : rows )
+	{
+		string cells;
+		for( auto c : row )
+		{
+			if( c == ' ' || c == '\t' || c == '\r' )
+			{
+				continue;
+			}
+
+			if( c != 'X' && c != 'O' && c != '.' && c != '*' && c != '#' )
+			{
+				throw runtime_error( string( "Unknown pattern cell '" ) + c + "'" );
+			}
+
+			cells += c;
+		}
+
+		if( cells.size() )
+		{
+			grid.push_back( cells );
+		}
+	}
+
+	if( !grid.size() )
+	{
+		throw runtime_error( "Empty pattern" );
+	}
+
+	for( auto& row : grid )
+	{
+		if( row.size() != grid[0].size() )
+		{
+			throw runtime_error( "Pattern rows have to be of equal width" );
+		}
+	}
+
+	if( grid.size() > max_padded_size || grid[0].size() > max_padded_size )
+	{
+		throw runtime_error( "Pattern is bigger than any board" );
+	}
+
+
+	// Every distinct orientation, and their colour swaps if asked
+	set<vector<string>> grids;
+	for( size_t symmetry = 0; symmetry < 8; symmetry++ )
+	{
+		auto width  = grid[0].size();
+		auto height = grid.size();
+		if( symmetry & 1 )
+		{
+			swap( width, height );
+		}
+
+		vector<string> oriented( height, string( width, '*' ) );
+		for( size_t y = 0; y < grid.size(); y++ )
+		{
+			for( size_t x = 0; x < grid[y].size(); x++ )
+			{
+				auto tx = x, ty = y;
+				if( symmetry & 1 )
+				{
+					swap( tx, ty );
+				}
+				if( symmetry & 2 )
+				{
+					tx = width - 1 - tx;
+				}
+				if( symmetry & 4 )
+				{
+					ty = height - 1 - ty;
+				}
+
+				oriented[ty][tx] = grid[y][x];
+			}
+		}
+
+		grids.insert( oriented );
+
+		if( any_colour )
+		{
+			for( auto& row : oriented )
+			{
+				for( auto& c : row )
+				{
+					c = (c == 'X') ? 'O' : (c == 'O') ? 'X' : c;
+				}
+			}
+
+			grids.insert( oriented );
+		}
+	}
+
+	for( auto& oriented : grids )
+	{
+		orientations.push_back( make_orientation( oriented ) );
+	}
+}
+
+
+
+Pattern corpus::Pattern::read_file( const string& path, bool any_colour )
+{
+	ifstream in( path );
+	if( !in.is_open() )
+	{
+		throw runtime_error( "Couldn't open the pattern file '" + path + "'" );
+	}
+
+	vector<string> rows;
+	string row;
+	while( getline( in, row ) )
+	{
+		// Lines starting with ; are comments
+		if( row.size() && row[0] == ';' )
+		{
+			continue;
+		}
+
+		rows.push_back( row );
+	}
+
+	return Pattern{ rows, any_colour };
+}
+
+
+
+const vector<Pattern::Orientation>& corpus::Pattern::get_orientations() const
+{
+	return orientations;
+}
+
+
+
+bool pattern_matches(
+	const Pattern::Orientation& pattern,
+	const PaddedBoard&          board,
+	size_t                      left,
+	size_t                      top
+)
+{
+	auto row_matches = [&]( size_t row )
+	{
+		auto y = top + row;
+		return ((board.black[y] >> left) & pattern.black[row]) == pattern.black[row] &&
+		       ((board.white[y] >> left) & pattern.white[row]) == pattern.white[row] &&
+		       ((board.empty( y ) >> left) & pattern.empty[row]) == pattern.empty[row] &&
+		       ((board.edge[y] >> left) & pattern.edge[row]) == pattern.edge[row] &&
+		       ((board.edge[y] >> left) & pattern.on_board[row]) == 0;
+	};
+
+	if( !row_matches( pattern.selective_row ) )
+	{
+		return false;
+	}
+
+	for( size_t row = 0; row < pattern.height; row++ )
+	{
+		if( row != pattern.selective_row && !row_matches( row ) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+
+vector<PatternHit> corpus::search_game( const Pattern& pattern, const sgf::MainLine& line )
+{
+	vector<PatternHit> hits;
+	PaddedBoard        board{ line.board_size };
+
+	auto& orientations = pattern.get_orientations();
+
+	// Placements matching on the current move, as orientation, left and top
+	unordered_set<uint64_t> active;
+	vector<size_t>          active_count( orientations.size(), 0 );
+
+	replay_main_line( line, [&]( go::Goban&, size_t move_number, const vector<go::Stone>& changed )
+	{
+		board.update( changed );
+
+		// Only placements overlapping the changed points can appear or
+		// disappear, the setup position is checked everywhere
+		size_t min_x = 0, min_y = 0;
+		size_t max_x = board.size - 1, max_y = board.size - 1;
+
+		if( move_number > 0 )
+		{
+			if( !changed.size() )
+			{
+				return;
+			}
+
+			min_x = min_y = board.size;
+			max_x = max_y = 0;
+			for( auto& point : changed )
+			{
+				min_x = min( min_x, point.x + 1 );
+				min_y = min( min_y, point.y + 1 );
+				max_x = max( max_x, point.x + 1 );
+				max_y = max( max_y, point.y + 1 );
+			}
+		}
+
+		for( size_t index = 0; index < orientations.size(); index++ )
+		{
+			auto& orientation = orientations[index];
+			if( orientation.width > board.size || orientation.height > board.size )
+			{
+				continue;
+			}
+
+			// Not enough stones on the board for the pattern anywhere
+			bool possible = board.black_count >= orientation.black_count &&
+			                board.white_count >= orientation.white_count;
+
+			if( !possible && !active_count[index] )
+			{
+				continue;
+			}
+
+			auto first_left = min_x + 1 > orientation.width ? min_x + 1 - orientation.width : 0;
+			auto first_top  = min_y + 1 > orientation.height ? min_y + 1 - orientation.height : 0;
+			auto last_left  = min( max_x, board.size - orientation.width );
+			auto last_top   = min( max_y, board.size - orientation.height );
+
+			for( auto top = first_top; top <= last_top; top++ )
+			{
+				for( auto left = first_left; left <= last_left; left++ )
+				{
+					auto key = (uint64_t( index ) << 32) | (left << 16) | top;
+
+					if( possible && pattern_matches( orientation, board, left, top ) )
+					{
+						if( active.insert( key ).second )
+						{
+							active_count[index]++;
+							hits.push_back( {
+								static_cast<uint32_t>( move_number ),
+								max<size_t>( left, 1 ),
+								max<size_t>( top, 1 ),
+								index
+							} );
+						}
+					}
+					else if( active_count[index] && active.erase( key ) )
+					{
+						active_count[index]--;
+					}
+				}
+			}
+		}
+	} );
+
+	return hits;
+}
+
+
+
+void corpus::search_games(
+	const Pattern&        pattern,
+	const vector<string>& files,
+	function<void( const string&, const vector<PatternHit>& )> on_hits
+)
+{
+	mutex hits_mutex;
+
+	tools::parallel_for( files.size(), [&]( size_t index, size_t )
+	{
+		vector<PatternHit> hits;
+		try
+		{
+			hits = search_game( pattern, read_main_line_file( files[index] ) );
+		}
+		catch( exception& )
+		{
+			return;
+		}
+
+		if( hits.size() )
+		{
+			lock_guard<mutex> hits_lock{ hits_mutex };
+			on_hits( files[index], hits );
+		}
+	} );
+}
+
+
+
+int corpus::search_pattern_command( const vector<string>& args )
+{
+	if( args.size() < 2 || args.size() > 3 ||
+	    (args.size() == 3 && args[2] != "--any-colour") )
+	{
+		wcout << "Usage: --search-pattern <pattern file> <directory> [--any-colour]" << endl;
+		return 1;
+	}
+
+	auto pattern = Pattern::read_file( args[0], args.size() == 3 );
+	auto files   = find_game_files( args[1] );
+
+	size_t hit_count  = 0;
+	size_t game_count = 0;
+	auto   start      = chrono::steady_clock::now();
+
+	search_games( pattern, files, [&]( const string& path, const vector<PatternHit>& hits )
+	{
+		for( auto& hit : hits )
+		{
+			wcout << path.c_str() << " at move " << hit.move
+			      << " (" << hit.x << ", " << hit.y << ")" << endl;
+		}
+
+		hit_count += hits.size();
+		game_count++;
+	} );
+
+	auto elapsed = chrono::duration<double>( chrono::steady_clock::now() - start );
+	wcout << hit_count << " hits in " << game_count << " of "
+	      << files.size() << " games, searched in "
+	      << elapsed.count() << " s" << endl;
+
+	return 0;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "sgf.hh"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+
+// Searching the game collection for local patterns
+// - A pattern is a rectangle of cells, given as rows of text:
+//     X  black stone       O  white stone
+//     .  empty point       *  anything
+//     #  off the board, for patterns tied to an edge or a corner
+// - Patterns are matched in every orientation, and optionally with
+//   the colours swapped
+// - A hit is reported when the pattern appears at a location, so a
+//   shape that stays on the board is found once, not on every move
+namespace corpus
+{
+	class Pattern
+	{
+	  public:
+		struct Orientation
+		{
+			size_t                width;
+			size_t                height;
+			size_t                black_count;
+			size_t                white_count;
+			size_t                selective_row; // Row with the most constraints
+			std::vector<uint64_t> black;         // Required cells per row
+			std::vector<uint64_t> white;
+			std::vector<uint64_t> empty;
+			std::vector<uint64_t> edge;
+			std::vector<uint64_t> on_board;
+		};
+
+		Pattern( const std::vector<std::string>& rows, bool any_colour = false );
+
+		static Pattern read_file( const std::string& path, bool any_colour = false );
+
+		const std::vector<Orientation>& get_orientations() const;
+
+
+	  private:
+		std::vector<Orientation> orientations;
+	};
+
+
+
+	struct PatternHit
+	{
+		uint32_t move;        // Moves played, 0 for the setup position
+		size_t   x;           // Top left corner of the pattern on the board,
+		size_t   y;           //  1-based like sgf::Point
+		size_t   orientation;
+	};
+
+	std::vector<PatternHit> search_game(
+		const Pattern&       pattern,
+		const sgf::MainLine& line
+	);
+
+	// Searches the files in parallel, calling on_hits( path, hits ) for
+	// every game with hits as soon as it's done. The calls are serialized.
+	void search_games(
+		const Pattern&                  pattern,
+		const std::vector<std::string>& files,
+		std::function<void( const std::string&, const std::vector<PatternHit>& )> on_hits
+	);
+
+
+	// Command line entry point
+	int search_pattern_command( const std::vector<std::string>& args );
+}
@@ -0,0 +1,577 @@
+#include "position_index.hh"
+#include "corpus.hh"
+#include "symmetry.hh"
+
+#include <queue>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <algorithm>
+#include <exception>
+#include <unordered_map>
+
+
+using namespace std;
+using namespace corpus;
+
+
+
+/*
+	File layout, native byte order:
+
+	IndexHeader
+	IndexPosting[posting_count] sorted by hash, game and move
+	IndexGame[game_count]       indexed by game id
+	char[paths_size]            game paths, not terminated
+ */
+
+struct IndexHeader
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t game_count;
+	uint64_t posting_count;
+	uint64_t postings_offset;
+	uint64_t games_offset;
+	uint64_t paths_offset;
+	uint64_t paths_size;
+};
+
+const char     index_magic[8] = { 'V', 'I', 'S', 'P', 'O', 'S', 'I', 'X' };
+const uint32_t index_version  = 1;
+
+// New games are replayed in batches, every batch is sorted and written
+// to a run file of its own and the runs are merged at the end. This keeps
+// the memory use bounded when indexing a large collection from scratch.
+const size_t games_per_run = 16384;
+
+
+
+bool posting_less( const IndexPosting& a, const IndexPosting& b )
+{
+	if( a.hash != b.hash )
+	{
+		return a.hash < b.hash;
+	}
+
+	if( a.game != b.game )
+	{
+		return a.game < b.game;
+	}
+
+	return a.move < b.move;
+}
+
+
+
+corpus::PositionIndex::PositionIndex( const string& path )
+: file( path ),
+  games( nullptr ),
+  postings( nullptr ),
+  paths( nullptr ),
+  games_size( 0 ),
+  postings_size( 0 )
+{
+	IndexHeader header;
+	if( file.size() < sizeof( header ) )
+	{
+		throw runtime_error( "'" + path + "' is not a position index" );
+	}
+
+	memcpy( &header, file.data(), sizeof( header ) );
+	if( memcmp( header.magic, index_magic, sizeof( index_magic ) ) ||
+	    header.version != index_version )
+	{
+		throw runtime_error( "'" + path + "' is not a position index" );
+	}
+
+	auto fits = [&]( uint64_t offset, uint64_t count, uint64_t item_size )
+	{
+		return offset <= file.size() &&
+		       count <= (file.size() - offset) / item_size;
+	};
+
+	if( !fits( header.postings_offset, header.posting_count, sizeof( IndexPosting ) ) ||
+	    !fits( header.games_offset, header.game_count, sizeof( IndexGame ) ) ||
+	    !fits( header.paths_offset, header.paths_size, 1 ) )
+	{
+		throw runtime_error( "Position index '" + path + "' is truncated" );
+	}
+
+	postings      = reinterpret_cast<const IndexPosting*>( file.data() + header.postings_offset );
+	games         = reinterpret_cast<const IndexGame*>( file.data() + header.games_offset );
+	paths         = reinterpret_cast<const char*>( file.data() + header.paths_offset );
+	postings_size = static_cast<size_t>( header.posting_count );
+	games_size    = header.game_count;
+
+	for( size_t id = 0; id < games_size; id++ )
+	{
+		if( games[id].path_offset + games[id].path_length > header.paths_size )
+		{
+			throw runtime_error( "Position index '" + path + "' is corrupted" );
+		}
+	}
+}
+
+
+
+size_t corpus::PositionIndex::game_count() const
+{
+	return games_size;
+}
+
+
+
+size_t corpus::PositionIndex::posting_count() const
+{
+	return postings_size;
+}
+
+
+
+const IndexGame& corpus::PositionIndex::game( uint32_t id ) const
+{
+	if( id >= games_size )
+	{
+		throw runtime_error( "Game id out of range" );
+	}
+
+	return games[id];
+}
+
+
+
+string corpus::PositionIndex::game_path( uint32_t id ) const
+{
+	auto& entry = game( id );
+	return string( paths + entry.path_offset, entry.path_length );
+}
+
+
+
+pair<const IndexPosting*, const IndexPosting*>
+corpus::PositionIndex::find( uint64_t hash ) const
+{
+	return equal_range(
+		begin(),
+		end(),
+		IndexPosting{ hash, 0, 0 },
+		[]( const IndexPosting& a, const IndexPosting& b )
+		{
+			return a.hash < b.hash;
+		}
+	);
+}
+
+
+
+uint64_t corpus::position_hash_at( const sgf::MainLine& line, size_t move_number )
+{
+	if( move_number > line.moves.size() )
+	{
+		throw runtime_error( "The game doesn't have that many moves" );
+	}
+
+	go::PositionHasher hasher{ line.board_size };
+	uint64_t hash = 0;
+
+	replay_main_line( line, [&]( go::Goban&, size_t number, const vector<go::Stone>& changed )
+	{
+		hasher.update( changed );
+		if( number == move_number )
+		{
+			hash = hasher.canonical_hash();
+		}
+	} );
+
+	return hash;
+}
+
+
+
+// Appends the postings of every non-empty position of the game
+void index_game( const string& path, uint32_t game_id, vector<IndexPosting>& postings )
+{
+	auto line = read_main_line_file( path );
+	go::PositionHasher hasher{ line.board_size };
+
+	replay_main_line( line, [&]( go::Goban&, size_t move_number, const vector<go::Stone>& changed )
+	{
+		hasher.update( changed );
+
+		// The empty board would match every game
+		if( hasher.is_empty() )
+		{
+			return;
+		}
+
+		postings.push_back( {
+			hasher.canonical_hash(),
+			game_id,
+			static_cast<uint32_t>( move_number )
+		} );
+	} );
+}
+
+
+
+template<typename T>
+void write_items( ofstream& out, const T* items, size_t count )
+{
+	out.write( reinterpret_cast<const char*>( items ), count * sizeof( T ) );
+	if( !out )
+	{
+		throw runtime_error( "Couldn't write to the index file" );
+	}
+}
+
+
+
+// Merges the sorted posting ranges, skipping postings of games
+// that aren't live anymore, and writes the whole index file
+void write_index(
+	const string&                                                 path,
+	const vector<pair<const IndexPosting*, const IndexPosting*>>& sources,
+	vector<IndexGame>                                             games,
+	const vector<string>&                                         game_paths
+)
+{
+	ofstream out( path, ios_base::out | ios_base::binary | ios_base::trunc );
+	if( !out.is_open() )
+	{
+		throw runtime_error( "Couldn't create '" + path + "'" );
+	}
+
+	IndexHeader header;
+	memset( &header, 0, sizeof( header ) );
+	write_items( out, &header, 1 );
+
+
+	// Postings, merged from every source with a heap
+	auto cursors = sources;
+	priority_queue<size_t, vector<size_t>, function<bool( size_t, size_t )>> heap{
+		[&]( size_t a, size_t b )
+		{
+			return posting_less( *cursors[b].first, *cursors[a].first );
+		}
+	};
+
+	for( size_t i = 0; i < cursors.size(); i++ )
+	{
+		if( cursors[i].first != cursors[i].second )
+		{
+			heap.push( i );
+		}
+	}
+
+	vector<IndexPosting> buffer;
+	buffer.reserve( 65536 );
+	uint64_t posting_count = 0;
+
+	while( heap.size() )
+	{
+		auto source = heap.top();
+		heap.pop();
+
+		auto& posting = *cursors[source].first++;
+		if( games[posting.game].flags == INDEX_GAME_LIVE )
+		{
+			buffer.push_back( posting );
+			if( buffer.size() == buffer.capacity() )
+			{
+				write_items( out, buffer.data(), buffer.size() );
+				posting_count += buffer.size();
+				buffer.clear();
+			}
+		}
+
+		if( cursors[source].first != cursors[source].second )
+		{
+			heap.push( source );
+		}
+	}
+
+	write_items( out, buffer.data(), buffer.size() );
+	posting_count += buffer.size();
+
+
+	// Games and their paths, stale games lose their path
+	string paths;
+	for( size_t id = 0; id < games.size(); id++ )
+	{
+		auto& game = games[id];
+		if( game.flags == INDEX_GAME_STALE )
+		{
+			game.path_offset = 0;
+			game.path_length = 0;
+			continue;
+		}
+
+		auto offset = paths.size();
+		paths.append( game_paths[id] );
+
+		game.path_offset = offset;
+		game.path_length = static_cast<uint32_t>( paths.size() - offset );
+	}
+
+	memcpy( header.magic, index_magic, sizeof( index_magic ) );
+	header.version         = index_version;
+	header.game_count      = static_cast<uint32_t>( games.size() );
+	header.posting_count   = posting_count;
+	header.postings_offset = sizeof( header );
+	header.games_offset    = header.postings_offset + posting_count * sizeof( IndexPosting );
+	header.paths_offset    = header.games_offset + games.size() * sizeof( IndexGame );
+	header.paths_size      = paths.size();
+
+	write_items( out, games.data(), games.size() );
+	write_items( out, paths.data(), paths.size() );
+
+	out.seekp( 0 );
+	write_items( out, &header, 1 );
+}
+
+
+
+void corpus::update_position_index(
+	const string& root_directory,
+	const string& index_path
+)
+{
+	unique_ptr<PositionIndex> old_index;
+	vector<IndexGame>         games;
+	vector<string>            game_paths;
+	unordered_map<string, uint32_t> known_games;
+
+	bool index_exists = true;
+	try
+	{
+		tools::get_file_info( index_path );
+	}
+	catch( runtime_error& )
+	{
+		index_exists = false;
+	}
+
+	if( index_exists )
+	{
+		old_index.reset( new PositionIndex( index_path ) );
+		for( uint32_t id = 0; id < old_index->game_count(); id++ )
+		{
+			auto& game = old_index->game( id );
+			auto  path = old_index->game_path( id );
+
+			if( game.flags != INDEX_GAME_STALE )
+			{
+				known_games[path] = id;
+			}
+
+			games.push_back( game );
+			game_paths.push_back( move( path ) );
+		}
+	}
+
+
+	// Sort out which files need replaying
+	auto files = find_game_files( root_directory );
+
+	vector<bool>            unchanged( games.size(), false );
+	vector<string>          new_files;
+	vector<tools::FileInfo> new_infos;
+
+	for( auto& path : files )
+	{
+		tools::FileInfo info;
+		try
+		{
+			info = tools::get_file_info( path );
+		}
+		catch( runtime_error& )
+		{
+			continue;
+		}
+
+		auto known = known_games.find( path );
+		if( known != known_games.end() )
+		{
+			auto& game = games[known->second];
+			if( game.file_size == info.size && game.modified == info.modified )
+			{
+				unchanged[known->second] = true;
+				continue;
+			}
+		}
+
+		new_files.push_back( path );
+		new_infos.push_back( info );
+	}
+
+	for( size_t id = 0; id < unchanged.size(); id++ )
+	{
+		if( !unchanged[id] )
+		{
+			games[id].flags = INDEX_GAME_STALE;
+		}
+	}
+
+	auto first_new_game = games.size();
+	if( first_new_game + new_files.size() > UINT32_MAX )
+	{
+		throw runtime_error( "Too many games for one index" );
+	}
+
+
+	// Replay the new games in runs
+	vector<string>            run_paths;
+	vector<tools::MappedFile> runs;
+	atomic<size_t>            broken_count{ 0 };
+
+	auto defer_remove_runs = tools::make_defer( [&]()
+	{
+		runs.clear();
+		for( auto& run_path : run_paths )
+		{
+			remove( run_path.c_str() );
+		}
+	} );
+
+	for( size_t first = 0; first < new_files.size(); first += games_per_run )
+	{
+		auto count = min( games_per_run, new_files.size() - first );
+
+		vector<vector<IndexPosting>> thread_postings( tools::worker_thread_count() );
+		vector<uint32_t>             flags( count, INDEX_GAME_LIVE );
+
+		tools::parallel_for( count, [&]( size_t i, size_t thread )
+		{
+			auto& postings    = thread_postings[thread];
+			auto  size_before = postings.size();
+			auto  game_id     = static_cast<uint32_t>( first_new_game + first + i );
+
+			try
+			{
+				index_game( new_files[first + i], game_id, postings );
+			}
+			catch( exception& )
+			{
+				postings.resize( size_before );
+				flags[i] = INDEX_GAME_BROKEN;
+				broken_count++;
+			}
+		} );
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			game_paths.push_back( new_files[first + i] );
+			games.push_back( {
+				0,
+				0,
+				flags[i],
+				new_infos[first + i].size,
+				new_infos[first + i].modified
+			} );
+		}
+
+		vector<IndexPosting> run;
+		for( auto& postings : thread_postings )
+		{
+			run.insert( run.end(), postings.begin(), postings.end() );
+			postings = {};
+		}
+		sort( run.begin(), run.end(), posting_less );
+
+		run_paths.push_back( index_path + ".run" + to_string( run_paths.size() ) );
+		{
+			ofstream out( run_paths.back(), ios_base::out | ios_base::binary | ios_base::trunc );
+			write_items( out, run.data(), run.size() );
+		}
+		runs.emplace_back( run_paths.back() );
+
+		wcout << "Indexed " << first + count << "/" << new_files.size()
+		      << " new games" << endl;
+	}
+
+
+	// Merge the old index and the runs into a new file
+	vector<pair<const IndexPosting*, const IndexPosting*>> sources;
+	if( old_index )
+	{
+		sources.emplace_back( old_index->begin(), old_index->end() );
+	}
+
+	for( auto& run : runs )
+	{
+		auto run_postings = reinterpret_cast<const IndexPosting*>( run.data() );
+		sources.emplace_back( run_postings, run_postings + run.size() / sizeof( IndexPosting ) );
+	}
+
+	auto temporary_path = index_path + ".tmp";
+	write_index( temporary_path, sources, games, game_paths );
+
+	// Release the old mapping before replacing the file
+	old_index.reset();
+	remove( index_path.c_str() );
+	if( rename( temporary_path.c_str(), index_path.c_str() ) )
+	{
+		throw runtime_error( "Couldn't replace '" + index_path + "'" );
+	}
+
+	wcout << "Index updated: " << new_files.size() - broken_count << " games added, "
+	      << broken_count << " broken, "
+	      << count( unchanged.begin(), unchanged.end(), true ) << " unchanged" << endl;
+}
+
+
+
+int corpus::build_index_command( const vector<string>& args )
+{
+	if( args.size() != 2 )
+	{
+		wcout << "Usage: --build-index <directory> <index file>" << endl;
+		return 1;
+	}
+
+	update_position_index( args[0], args[1] );
+	return 0;
+}
+
+
+
+int corpus::query_index_command( const vector<string>& args )
+{
+	if( args.size() < 2 || args.size() > 3 )
+	{
+		wcout << "Usage: --query-index <index file> <sgf file> [move number]" << endl;
+		return 1;
+	}
+
+	auto line        = read_main_line_file( args[1] );
+	auto move_number = line.moves.size();
+	if( args.size() > 2 )
+	{
+		move_number = stoul( args[2] );
+	}
+
+	auto hash = position_hash_at( line, move_number );
+
+	auto start   = chrono::steady_clock::now();
+	PositionIndex index{ args[0] };
+	auto matches = index.find( hash );
+	auto elapsed = chrono::duration<double, milli>( chrono::steady_clock::now() - start );
+
+	for( auto posting = matches.first; posting != matches.second; posting++ )
+	{
+		wcout << index.game_path( posting->game ).c_str()
+		      << " at move " << posting->move << endl;
+	}
+
+	wcout << matches.second - matches.first << " matches among "
+	      << index.game_count() << " games in "
+	      << elapsed.count() << " ms" << endl;
+
+	return 0;
+}
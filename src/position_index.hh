@@ -0,0 +1,87 @@
+#pragma once
+
+#include "sgf.hh"
+#include "common_tools.hh"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+
+// On-disk index of every position reached in a game collection
+// - Positions are keyed by their canonical hash, so the same position
+//   is found whatever the orientation or colours of the board
+// - The postings are sorted by hash and mapped straight from the file,
+//   a lookup is a binary search and doesn't load anything else
+// - Updating an index only replays the files added or modified since
+namespace corpus
+{
+	struct IndexPosting
+	{
+		uint64_t hash;
+		uint32_t game;
+		uint32_t move; // Moves played, 0 for the setup position
+	};
+
+	struct IndexGame
+	{
+		uint64_t path_offset;
+		uint32_t path_length;
+		uint32_t flags;
+		uint64_t file_size;
+		int64_t  modified;
+	};
+
+	enum IndexGameFlags
+	{
+		INDEX_GAME_STALE   = 0,  // Removed or modified since indexing
+		INDEX_GAME_LIVE    = 1,
+		INDEX_GAME_BROKEN  = 2   // Couldn't be replayed, not retried until modified
+	};
+
+
+
+	class PositionIndex
+	{
+		tools::MappedFile   file;
+		const IndexGame    *games;
+		const IndexPosting *postings;
+		const char         *paths;
+		size_t              games_size;
+		size_t              postings_size;
+
+
+	  public:
+		PositionIndex( const std::string& path );
+
+		size_t game_count() const;
+		size_t posting_count() const;
+
+		const IndexGame& game( uint32_t id ) const;
+		std::string      game_path( uint32_t id ) const;
+
+		// Postings of the position, sorted by game and move
+		std::pair<const IndexPosting*, const IndexPosting*>
+		find( uint64_t hash ) const;
+
+		const IndexPosting* begin() const { return postings; }
+		const IndexPosting* end() const   { return postings + postings_size; }
+	};
+
+
+
+	// Creates the index or brings it up to date with the directory tree
+	void update_position_index(
+		const std::string& root_directory,
+		const std::string& index_path
+	);
+
+	// Canonical hash of the position after the given number of moves
+	uint64_t position_hash_at( const sgf::MainLine& line, size_t move_number );
+
+
+	// Command line entry points
+	int build_index_command( const std::vector<std::string>& args );
+	int query_index_command( const std::vector<std::string>& args );
+}
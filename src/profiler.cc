@@ -0,0 +1,285 @@
+#include "profiler.hh"
+
+#include <chrono>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <unordered_map>
+
+
+using namespace std;
+
+
+// Events kept at most over all threads, about 32 bytes each
+const size_t max_trace_events = 1 << 20;
+
+
+atomic<bool> tools::profiling_enabled{ false };
+
+atomic<bool>   tracing_enabled{ false };
+atomic<size_t> trace_event_count{ 0 };
+
+
+struct TraceEvent
+{
+	const char *name;
+	uint64_t    start_ns;
+	uint64_t    duration_ns;
+};
+
+
+// What one thread recorded, kept after the thread ends
+struct ThreadProfile
+{
+	mutex                    lock;
+	uint32_t                 thread_id = 0;
+	string                   name;
+	vector<TraceEvent>       events;
+	unordered_map<const char*, tools::StageTotal> totals;
+};
+
+
+mutex                             registry_mutex;
+vector<unique_ptr<ThreadProfile>> registry;
+
+
+
+ThreadProfile& this_thread_profile()
+{
+	static thread_local ThreadProfile *profile = nullptr;
+	if( !profile )
+	{
+		lock_guard<mutex> lock{ registry_mutex };
+		registry.emplace_back( new ThreadProfile );
+		profile = registry.back().get();
+		profile->thread_id = static_cast<uint32_t>( registry.size() );
+		profile->name      = "thread " + to_string( profile->thread_id );
+	}
+
+	return *profile;
+}
+
+
+
+uint64_t tools::profile_clock_ns()
+{
+	// Counted from the first use, so that a start time is never zero
+	static const auto epoch = chrono::steady_clock::now() - chrono::nanoseconds( 1 );
+	return static_cast<uint64_t>( chrono::duration_cast<chrono::nanoseconds>(
+		chrono::steady_clock::now() - epoch
+	).count() );
+}
+
+
+
+void tools::record_scope( const char *name, uint64_t start_ns, uint64_t end_ns )
+{
+	auto& profile  = this_thread_profile();
+	auto  duration = end_ns - start_ns;
+
+	lock_guard<mutex> lock{ profile.lock };
+
+	auto& total = profile.totals[name];
+	total.name         = name;
+	total.nanoseconds += duration;
+	total.count++;
+
+	if( tracing_enabled.load( memory_order_relaxed ) &&
+	    trace_event_count.fetch_add( 1, memory_order_relaxed ) < max_trace_events )
+	{
+		profile.events.push_back( { name, start_ns, duration } );
+	}
+}
+
+
+
+void tools::enable_profiling( bool enable )
+{
+	profiling_enabled = enable || tracing_enabled;
+}
+
+
+
+void tools::enable_tracing( bool enable )
+{
+	tracing_enabled = enable;
+	if( enable )
+	{
+		profiling_enabled = true;
+	}
+}
+
+
+
+bool tools::is_tracing()
+{
+	return tracing_enabled;
+}
+
+
+
+void tools::set_thread_name( const string& name )
+{
+	auto& profile = this_thread_profile();
+
+	lock_guard<mutex> lock{ profile.lock };
+	profile.name = name;
+}
+
+
+
+vector<tools::StageTotal> tools::get_stage_totals()
+{
+	unordered_map<const char*, StageTotal> sums;
+
+	lock_guard<mutex> lock{ registry_mutex };
+	for( auto& profile : registry )
+	{
+		lock_guard<mutex> profile_lock{ profile->lock };
+		for( auto& total : profile->totals )
+		{
+			auto& sum = sums[total.first];
+			sum.name         = total.first;
+			sum.nanoseconds += total.second.nanoseconds;
+			sum.count       += total.second.count;
+		}
+	}
+
+	vector<StageTotal> totals;
+	for( auto& sum : sums )
+	{
+		totals.push_back( sum.second );
+	}
+
+	return totals;
+}
+
+
+
+string json_escape( const string& text )
+{
+	string escaped;
+	for( auto c : text )
+	{
+		if( c == '"' || c == '\\' )
+		{
+			escaped += '\\';
+		}
+
+		if( static_cast<unsigned char>( c ) >= 0x20 )
+		{
+			escaped += c;
+		}
+	}
+
+	return escaped;
+}
+
+
+
+void tools::write_chrome_trace( const string& path )
+{
+	ofstream out( path, ios_base::out | ios_base::binary | ios_base::trunc );
+	if( !out )
+	{
+		throw runtime_error( "Couldn't open '" + path + "'" );
+	}
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	auto first = true;
+	auto separator = [&]()
+	{
+		if( !first )
+		{
+			out << ",\n";
+		}
+		first = false;
+	};
+
+	lock_guard<mutex> lock{ registry_mutex };
+	for( auto& profile : registry )
+	{
+		lock_guard<mutex> profile_lock{ profile->lock };
+
+		separator();
+		out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << profile->thread_id
+		    << ",\"args\":{\"name\":\"" << json_escape( profile->name ) << "\"}}";
+
+		// Microseconds, with the nanoseconds as decimals
+		char times[64];
+		for( auto& event : profile->events )
+		{
+			snprintf(
+				times, sizeof( times ), "\"ts\":%.3f,\"dur\":%.3f",
+				event.start_ns / 1000.0, event.duration_ns / 1000.0
+			);
+
+			separator();
+			out << "{\"ph\":\"X\",\"name\":\"" << json_escape( event.name ) << "\",\"pid\":1,\"tid\":"
+			    << profile->thread_id << "," << times << "}";
+		}
+	}
+
+	out << "\n]}\n";
+
+	if( !out )
+	{
+		throw runtime_error( "Couldn't write '" + path + "'" );
+	}
+
+	if( trace_event_count > max_trace_events )
+	{
+		wcerr << "The trace is missing " << (trace_event_count - max_trace_events)
+		      << " events, it ran out of room" << endl;
+	}
+}
+
+
+
+tools::DurationWindow::DurationWindow( size_t capacity )
+: durations( max<size_t>( capacity, 1 ), 0 ),
+  next( 0 ),
+  count( 0 )
+{
+}
+
+
+
+void tools::DurationWindow::add( uint64_t nanoseconds )
+{
+	lock_guard<std::mutex> lock{ mutex };
+	durations[next] = nanoseconds;
+	next  = (next + 1) % durations.size();
+	count = min( count + 1, durations.size() );
+}
+
+
+
+vector<uint64_t> tools::DurationWindow::percentiles( const vector<double>& points ) const
+{
+	vector<uint64_t> sorted;
+	{
+		lock_guard<std::mutex> lock{ mutex };
+		sorted.assign( durations.begin(), durations.begin() + count );
+	}
+
+	sort( sorted.begin(), sorted.end() );
+
+	vector<uint64_t> values;
+	for( auto point : points )
+	{
+		if( sorted.empty() )
+		{
+			values.push_back( 0 );
+			continue;
+		}
+
+		auto rank = static_cast<size_t>( point / 100 * (sorted.size() - 1) + 0.5 );
+		values.push_back( sorted[min( rank, sorted.size() - 1 )] );
+	}
+
+	return values;
+}
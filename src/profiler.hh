@@ -0,0 +1,98 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Timing instrumentation
+// - PROFILE_SCOPE( "name" ) times the rest of the enclosing scope. The
+//   name must be a string literal, it's kept by pointer.
+// - Disabled, which is the default, a timer costs one relaxed atomic
+//   load. Enabled, every thread adds up the time per name, and with
+//   tracing on also keeps every scope as an event for a Chrome trace.
+// - The trace is the JSON that chrome://tracing and ui.perfetto.dev
+//   open, with a row for every named thread
+namespace tools
+{
+	struct StageTotal
+	{
+		const char *name;
+		uint64_t    nanoseconds;
+		uint64_t    count;
+	};
+
+
+	void enable_profiling( bool enable );
+	void enable_tracing( bool enable ); // Also enables profiling
+	bool is_tracing();
+
+	extern std::atomic<bool> profiling_enabled;
+
+	// Shown in the trace, eg. "loader"
+	void set_thread_name( const std::string& name );
+
+	// Time per name over the whole session, all threads summed up
+	std::vector<StageTotal> get_stage_totals();
+
+	// Writes the events recorded so far, throws if the file can't
+	// be written
+	void write_chrome_trace( const std::string& path );
+
+	uint64_t profile_clock_ns();
+	void     record_scope( const char *name, uint64_t start_ns, uint64_t end_ns );
+
+
+	class ScopedTimer
+	{
+		const char *name;
+		uint64_t    start_ns;
+
+
+	  public:
+		explicit ScopedTimer( const char *scope_name )
+		: name( scope_name ),
+		  start_ns( profiling_enabled.load( std::memory_order_relaxed ) ? profile_clock_ns() : 0 )
+		{
+		}
+
+		~ScopedTimer()
+		{
+			if( start_ns )
+			{
+				record_scope( name, start_ns, profile_clock_ns() );
+			}
+		}
+
+		ScopedTimer( const ScopedTimer& ) = delete;
+		ScopedTimer& operator=( const ScopedTimer& ) = delete;
+	};
+
+
+	// The last durations added, for percentiles
+	// - Thread safe, for one writer and readers on other threads
+	class DurationWindow
+	{
+		mutable std::mutex    mutex;
+		std::vector<uint64_t> durations;
+		size_t                next;
+		size_t                count;
+
+
+	  public:
+		explicit DurationWindow( size_t capacity = 512 );
+
+		void add( uint64_t nanoseconds );
+
+		// Percentiles 0-100 of the durations in the window, in the
+		// order asked for, zeros when there are none yet
+		std::vector<uint64_t> percentiles( const std::vector<double>& points ) const;
+	};
+}
+
+
+#define PROFILE_CONCAT_INNER( a, b ) a##b
+#define PROFILE_CONCAT( a, b ) PROFILE_CONCAT_INNER( a, b )
+#define PROFILE_SCOPE( name ) tools::ScopedTimer PROFILE_CONCAT( profile_scope_, __LINE__ ){ name }
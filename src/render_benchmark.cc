@@ -0,0 +1,321 @@
+#include "render_benchmark.hh"
+#include "offscreen_renderer.hh"
+#include "board_snapshot.hh"
+#include "common_tools.hh"
+#include "profiler.hh"
+
+#include <random>
+#include <cstdio>
+#include <sstream>
+#include <utility>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+
+using namespace std;
+using namespace gui;
+
+
+
+// A random position of the density that changes by a move at a time,
+// keeping the density: every move places a stone on an empty point and
+// takes one off elsewhere, like a capture
+class RandomBoard
+{
+	go::BoardSnapshot board;
+	vector<size_t>    empty_points;
+	vector<size_t>    stones;
+	mt19937           random;
+	size_t            move_number;
+
+
+  public:
+	RandomBoard( size_t board_size, double density )
+	: random( 1 ),
+	  move_number( 0 )
+	{
+		board.board_size = board_size;
+		board.revision   = 1;
+
+		for( size_t i = 0; i < board_size * board_size; i++ )
+		{
+			empty_points.push_back( i );
+		}
+
+		shuffle( empty_points.begin(), empty_points.end(), random );
+
+		auto stone_count = static_cast<size_t>( density * empty_points.size() );
+		while( stones.size() < stone_count )
+		{
+			place_stone();
+		}
+	}
+
+
+
+	void play_move()
+	{
+		if( !stones.empty() )
+		{
+			uniform_int_distribution<size_t> pick( 0, stones.size() - 1 );
+			auto stone = pick( random );
+			auto index = stones[stone];
+
+			stones[stone] = stones.back();
+			stones.pop_back();
+			board.set( index, go::Side::NONE );
+			board.set_number( index, 0 );
+			empty_points.push_back( index );
+		}
+
+		place_stone();
+		board.revision++;
+	}
+
+
+
+	const go::BoardSnapshot& get() const
+	{
+		return board;
+	}
+
+
+  private:
+	void place_stone()
+	{
+		if( empty_points.empty() )
+		{
+			return;
+		}
+
+		uniform_int_distribution<size_t> pick( 0, empty_points.size() - 1 );
+		auto point = pick( random );
+		auto index = empty_points[point];
+
+		empty_points[point] = empty_points.back();
+		empty_points.pop_back();
+		stones.push_back( index );
+
+		move_number++;
+		board.set( index, move_number % 2 ? go::Side::BLACK : go::Side::WHITE );
+		board.set_number( index, move_number );
+		board.last_move   = index;
+		board.move_number = move_number;
+	}
+};
+
+
+
+// Times each call of draw(), returns frames per second and fills in the
+// 50th, 95th and 99th percentile and the longest frame in milliseconds
+template<typename F>
+double time_frames( size_t frames, double percentiles_ms[4], F draw )
+{
+	tools::DurationWindow durations{ frames };
+
+	auto start = tools::profile_clock_ns();
+	for( size_t i = 0; i < frames; i++ )
+	{
+		auto frame_start = tools::profile_clock_ns();
+		draw();
+		durations.add( tools::profile_clock_ns() - frame_start );
+	}
+	auto elapsed = tools::profile_clock_ns() - start;
+
+	auto percentiles = durations.percentiles( { 50, 95, 99, 100 } );
+	for( size_t i = 0; i < 4; i++ )
+	{
+		percentiles_ms[i] = percentiles[i] / 1e6;
+	}
+
+	return elapsed ? frames * 1e9 / elapsed : 0;
+}
+
+
+
+void gui::run_render_benchmark( const RenderBenchmarkOptions& options )
+{
+	auto wood = sdl2::SurfacePtr( IMG_Load( options.wood_image.c_str() ) );
+	if( !wood )
+	{
+		throw runtime_error( "Couldn't load '" + options.wood_image + "': " + IMG_GetError() );
+	}
+
+	char line[160];
+	snprintf( line, sizeof( line ), "%-10s %5s %7s %-5s %9s %8s %8s %8s %8s",
+	          "window", "board", "density", "draw", "fps", "p50 ms", "p95 ms", "p99 ms", "max ms" );
+	wcout << line << endl;
+
+	auto print_result = [&]( const pair<int, int>& window_size, size_t board_size, double density,
+	                         const char *mode, double fps, const double percentiles_ms[4] )
+	{
+		char window[32];
+		snprintf( window, sizeof( window ), "%dx%d", window_size.first, window_size.second );
+		snprintf(
+			line, sizeof( line ), "%-10s %5u %7.2f %-5s %9.1f %8.3f %8.3f %8.3f %8.3f",
+			window, static_cast<unsigned>( board_size ), density, mode, fps,
+			percentiles_ms[0], percentiles_ms[1], percentiles_ms[2], percentiles_ms[3]
+		);
+		wcout << line << endl;
+	};
+
+	for( auto& window_size : options.window_sizes )
+	{
+		// A renderer per window size, its board layers and atlases are
+		// reused across the boards like in a window
+		OffscreenRenderer renderer{ window_size.first, window_size.second, wood.get(), options.font_path };
+		renderer.set_move_numbers( options.move_numbers );
+
+		for( auto board_size : options.board_sizes )
+		{
+			for( auto density : options.densities )
+			{
+				RandomBoard board{ board_size, density };
+				double percentiles_ms[4];
+
+				// The first frame builds what's missing of the layers,
+				// atlases and glyphs, it's left out
+				renderer.invalidate();
+				renderer.render( board.get() );
+
+				auto fps = time_frames( max<size_t>( options.frames / 10, 1 ), percentiles_ms, [&]()
+				{
+					renderer.invalidate();
+					renderer.render( board.get() );
+				} );
+				print_result( window_size, board_size, density, "full", fps, percentiles_ms );
+
+				fps = time_frames( options.frames, percentiles_ms, [&]()
+				{
+					board.play_move();
+					renderer.render( board.get() );
+				} );
+				print_result( window_size, board_size, density, "move", fps, percentiles_ms );
+			}
+		}
+	}
+}
+
+
+
+int gui::render_benchmark_command( const vector<string>& args )
+{
+	auto usage = []()
+	{
+		wcout << "Usage: --render-benchmark [--windows WxH,...] [--boards N,...]"
+		      << " [--densities D,...] [--frames N] [--move-numbers] [--wood <image>]"
+		      << " [--font <file.ttf>]" << endl;
+		return 1;
+	};
+
+	// Comma separated values of an option
+	auto split = []( const string& values )
+	{
+		vector<string> items;
+		stringstream stream( values );
+		string item;
+		while( getline( stream, item, ',' ) )
+		{
+			items.push_back( item );
+		}
+		return items;
+	};
+
+	RenderBenchmarkOptions options;
+	for( size_t i = 0; i < args.size(); i++ )
+	{
+		if( args[i] == "--move-numbers" )
+		{
+			options.move_numbers = true;
+			continue;
+		}
+
+		if( i + 1 >= args.size() )
+		{
+			return usage();
+		}
+
+		auto& value = args[++i];
+		if( args[i - 1] == "--windows" )
+		{
+			options.window_sizes.clear();
+			for( auto& item : split( value ) )
+			{
+				int width, height;
+				if( sscanf( item.c_str(), "%dx%d", &width, &height ) != 2 || width <= 0 || height <= 0 )
+				{
+					return usage();
+				}
+				options.window_sizes.push_back( { width, height } );
+			}
+		}
+		else if( args[i - 1] == "--boards" )
+		{
+			options.board_sizes.clear();
+			for( auto& item : split( value ) )
+			{
+				auto board_size = stoul( item );
+				if( board_size < 1 || board_size > go::BoardSnapshot::max_board_size )
+				{
+					wcout << "Board sizes go from 1 to " << go::BoardSnapshot::max_board_size << endl;
+					return 1;
+				}
+				options.board_sizes.push_back( board_size );
+			}
+		}
+		else if( args[i - 1] == "--densities" )
+		{
+			options.densities.clear();
+			for( auto& item : split( value ) )
+			{
+				options.densities.push_back( min( max( stod( item ), 0.0 ), 1.0 ) );
+			}
+		}
+		else if( args[i - 1] == "--frames" )
+		{
+			options.frames = max<size_t>( stoul( value ), 1 );
+		}
+		else if( args[i - 1] == "--wood" )
+		{
+			options.wood_image = value;
+		}
+		else if( args[i - 1] == "--font" )
+		{
+			options.font_path = value;
+		}
+		else
+		{
+			return usage();
+		}
+	}
+
+	// No window is ever opened, the dummy driver will do
+	SDL_SetHint( SDL_HINT_VIDEODRIVER, "dummy" );
+	if( SDL_Init( SDL_INIT_VIDEO ) )
+	{
+		wcerr << "SDL_Init() failed: " << SDL_GetError() << endl;
+		return 1;
+	}
+
+	auto defer_sdl_quit = tools::make_defer( [](){
+		SDL_Quit();
+	} );
+
+	// The text is drawn like in the viewer, with the TrueType font
+	// given with --font if SDL_ttf is there, the bitmap font otherwise
+	if( TTF_Init() )
+	{
+		wcerr << "TTF_Init() failed: " << TTF_GetError() << endl;
+	}
+
+	auto defer_ttf_quit = tools::make_defer( [](){
+		if( TTF_WasInit() )
+		{
+			TTF_Quit();
+		}
+	} );
+
+	run_render_benchmark( options );
+	return 0;
+}
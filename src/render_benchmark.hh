@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+
+// Measuring the board rendering without a display
+// - Boards are drawn offscreen with SDL's software renderer, under the
+//   dummy video driver, so it runs on headless build machines
+// - Every combination of window size, board size and stone density is
+//   timed twice: drawing the whole board, as after a resize, and
+//   repainting a move at a time, as during a replay
+// - The positions come from a fixed seed, runs are comparable
+namespace gui
+{
+	struct RenderBenchmarkOptions
+	{
+		std::vector<std::pair<int, int>> window_sizes = {
+			{ 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 }
+		};
+		std::vector<size_t> board_sizes = { 9, 13, 19, 52 };
+		std::vector<double> densities   = { 0.1, 0.5, 0.9 }; // Of points with a stone
+		size_t              frames      = 300;  // Moves, and a tenth as many full redraws
+		bool                move_numbers = false;
+		std::string         wood_image  = "data/wood.jpg";
+		std::string         font_path;  // TrueType, the bitmap font if empty
+	};
+
+	// Prints a line for each combination, throws if the renderer
+	// can't be set up
+	void run_render_benchmark( const RenderBenchmarkOptions& options );
+
+	int render_benchmark_command( const std::vector<std::string>& args );
+}
@@ -0,0 +1,435 @@
+#include "render_worker.hh"
+#include "board_renderer.hh"
+#include "profiler.hh"
+#include "allocation_tracker.hh"
+#include "metrics.hh"
+
+#include <memory>
+#include <utility>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+
+
+using namespace std;
+using namespace gui;
+
+
+// Commands queued at most for a window
+const size_t command_queue_size = 64;
+
+// How often the timing overlay is refreshed, and how many
+// stages it lists
+const auto   profile_refresh_interval = chrono::milliseconds( 500 );
+const size_t profile_stage_lines      = 10;
+const int    profile_text_size        = 14;
+
+
+
+// Frame time percentiles and the busiest stages since the last sample,
+// in milliseconds of work per second
+vector<string> profile_overlay_lines(
+	const tools::DurationWindow&     frame_times,
+	vector<tools::StageTotal>&       previous_totals,
+	chrono::steady_clock::duration   elapsed
+)
+{
+	vector<string> lines;
+	char line[128];
+
+	auto frame = frame_times.percentiles( { 50, 95, 99, 100 } );
+	snprintf(
+		line, sizeof( line ), "Frame  p50 %.1f  p95 %.1f  p99 %.1f  max %.1f ms",
+		frame[0] / 1e6, frame[1] / 1e6, frame[2] / 1e6, frame[3] / 1e6
+	);
+	lines.push_back( line );
+
+	auto seconds = chrono::duration<double>( elapsed ).count();
+	auto totals  = tools::get_stage_totals();
+
+	struct StageRate
+	{
+		const char *name;
+		double      milliseconds;
+		double      count;
+	};
+
+	vector<StageRate> rates;
+	for( auto& total : totals )
+	{
+		auto previous = find_if( previous_totals.begin(), previous_totals.end(), [&]( const tools::StageTotal& old )
+		{
+			return old.name == total.name;
+		} );
+
+		auto nanoseconds = total.nanoseconds;
+		auto count       = total.count;
+		if( previous != previous_totals.end() )
+		{
+			nanoseconds -= previous->nanoseconds;
+			count       -= previous->count;
+		}
+
+		if( count && seconds > 0 )
+		{
+			rates.push_back( { total.name, nanoseconds / 1e6 / seconds, count / seconds } );
+		}
+	}
+
+	previous_totals = move( totals );
+
+	sort( rates.begin(), rates.end(), []( const StageRate& a, const StageRate& b )
+	{
+		return a.milliseconds > b.milliseconds;
+	} );
+
+	if( rates.size() > profile_stage_lines )
+	{
+		rates.resize( profile_stage_lines );
+	}
+
+	for( auto& rate : rates )
+	{
+		snprintf( line, sizeof( line ), "%-16s %7.2f ms/s  %8.0f /s", rate.name, rate.milliseconds, rate.count );
+		lines.push_back( line );
+	}
+
+	return lines;
+}
+
+
+
+void draw_profile_overlay( SDL_Renderer *renderer, TextCache& text, const vector<string>& lines )
+{
+	auto line_height = text.measure( "Frame", profile_text_size ).y + 2;
+	auto width       = 0;
+	for( auto& line : lines )
+	{
+		width = max( width, text.measure( line, profile_text_size ).x );
+	}
+
+	const int margin = 6;
+	SDL_Rect background{
+		0, 0,
+		width + 2 * margin,
+		static_cast<int>( lines.size() ) * line_height + 2 * margin
+	};
+
+	SDL_SetRenderDrawBlendMode( renderer, SDL_BLENDMODE_BLEND );
+	SDL_SetRenderDrawColor( renderer, 0, 0, 0, 190 );
+	SDL_RenderFillRect( renderer, &background );
+	SDL_SetRenderDrawBlendMode( renderer, SDL_BLENDMODE_NONE );
+
+	auto y = margin;
+	for( auto& line : lines )
+	{
+		text.draw( line, profile_text_size, margin, y, { 120, 255, 120, 255 }, ALIGN_LEFT );
+		y += line_height;
+	}
+	text.flush();
+}
+
+
+
+SDL_Rect gui::tile_area( size_t index, size_t columns, size_t rows, int width, int height )
+{
+	auto column = static_cast<int>( index % columns );
+	auto row    = static_cast<int>( index / columns );
+	auto c      = static_cast<int>( columns );
+	auto r      = static_cast<int>( rows );
+
+	return {
+		column * width / c,
+		row * height / r,
+		(column + 1) * width / c - column * width / c,
+		(row + 1) * height / r - row * height / r
+	};
+}
+
+
+
+RenderWorker::RenderWorker(
+	SDL_Window  *target_window,
+	SDL_Surface *wood_surface,
+	vector<const go::SnapshotPublisher*> tile_boards,
+	size_t       tile_columns,
+	size_t       tile_rows,
+	int          width,
+	int          height,
+	string       truetype_font_path
+)
+: window( target_window ),
+  wood( wood_surface ),
+  font_path( move( truetype_font_path ) ),
+  tiles( move( tile_boards ) ),
+  columns( tile_columns ),
+  rows( tile_rows ),
+  initial_width( width ),
+  initial_height( height ),
+  commands( command_queue_size ),
+  stopping( false ),
+  failed( false ),
+  wake_requested( false )
+{
+	thread = std::thread( &RenderWorker::run, this );
+}
+
+
+
+RenderWorker::~RenderWorker()
+{
+	stopping = true;
+	wake();
+
+	if( thread.joinable() )
+	{
+		thread.join();
+	}
+}
+
+
+
+bool RenderWorker::post( const RenderCommand& command )
+{
+	return commands.try_push( command );
+}
+
+
+
+void RenderWorker::wake()
+{
+	{
+		lock_guard<mutex> lock{ wake_mutex };
+		wake_requested = true;
+	}
+	wake_condition.notify_one();
+}
+
+
+
+bool RenderWorker::has_failed() const
+{
+	return failed;
+}
+
+
+
+void RenderWorker::run()
+{
+	using Clock = chrono::steady_clock;
+
+	tools::set_thread_name( "render" );
+	tools::AllocationScope allocation_scope{ tools::ALLOC_RENDER };
+
+	auto renderer = sdl2::RendererPtr( SDL_CreateRenderer(
+		window, -1,
+		SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE |
+		SDL_RENDERER_PRESENTVSYNC
+	) );
+
+	if( !renderer )
+	{
+		wcerr << "RenderWorker::run() - SDL_CreateRenderer() failed: "
+		      << SDL_GetError() << endl;
+		failed = true;
+		return;
+	}
+
+	// Without vsync, keep to the refresh rate of the display
+	auto frame_interval = Clock::duration::zero();
+
+	SDL_RendererInfo info;
+	if( SDL_GetRendererInfo( renderer.get(), &info ) ||
+	    !(info.flags & SDL_RENDERER_PRESENTVSYNC) )
+	{
+		SDL_DisplayMode mode;
+		auto display = SDL_GetWindowDisplayIndex( window );
+		auto refresh_rate = 60;
+		if( display >= 0 && !SDL_GetCurrentDisplayMode( display, &mode ) && mode.refresh_rate > 0 )
+		{
+			refresh_rate = mode.refresh_rate;
+		}
+
+		frame_interval = chrono::duration_cast<Clock::duration>(
+			chrono::seconds( 1 ) ) / refresh_rate;
+	}
+
+	// The textures go before the renderer they belong to
+	{
+		BoardResources resources{ renderer.get(), wood, font_path };
+		if( !resources.is_initialized() )
+		{
+			failed = true;
+			return;
+		}
+
+		auto tile_count = min( columns * rows, tiles.size() );
+		resources.set_board_count( tile_count );
+		go::BoardSnapshot board;
+		vector<unique_ptr<BoardRenderer>> board_renderers;
+		for( size_t i = 0; i < tile_count; i++ )
+		{
+			board_renderers.emplace_back( new BoardRenderer( resources ) );
+		}
+
+		// The whole wall, only the tiles that changed are repainted into it
+		sdl2::TexturePtr composite;
+
+		auto width        = initial_width;
+		auto height       = initial_height;
+		auto needs_redraw  = true;
+		auto use_composite = true;
+		auto next_frame_time = Clock::now();
+
+		// The timing overlay
+		tools::DurationWindow            frame_times;
+		vector<tools::StageTotal>        previous_totals;
+		vector<string>                   profile_lines;
+		auto show_profile        = false;
+		auto last_profile_sample = Clock::now();
+
+		RenderCommand command;
+
+		while( !stopping )
+		{
+			{
+				unique_lock<mutex> lock{ wake_mutex };
+				wake_condition.wait_for( lock, chrono::milliseconds( 100 ), [this]()
+				{
+					return stopping || wake_requested || !commands.empty();
+				} );
+				wake_requested = false;
+			}
+
+			while( commands.try_pop( command ) )
+			{
+				switch( command.type )
+				{
+					case RenderCommand::RESIZE:
+						width  = command.width;
+						height = command.height;
+						composite.reset();
+						needs_redraw = true;
+						break;
+
+					case RenderCommand::REDRAW:
+						needs_redraw = true;
+						break;
+
+					case RenderCommand::RESET:
+						resources.clear();
+						composite.reset();
+						needs_redraw = true;
+						break;
+
+					case RenderCommand::OPTIONS:
+						for( auto& board_renderer : board_renderers )
+						{
+							board_renderer->set_move_numbers( command.move_numbers );
+						}
+
+						if( command.profile && !show_profile )
+						{
+							previous_totals     = tools::get_stage_totals();
+							last_profile_sample = Clock::now();
+							profile_lines.clear();
+						}
+
+						show_profile = command.profile;
+						needs_redraw = true;
+						break;
+				}
+			}
+
+			if( show_profile && Clock::now() - last_profile_sample >= profile_refresh_interval )
+			{
+				auto now = Clock::now();
+				profile_lines = profile_overlay_lines( frame_times, previous_totals, now - last_profile_sample );
+				last_profile_sample = now;
+				needs_redraw = true;
+			}
+
+			auto changed = needs_redraw;
+			for( size_t i = 0; i < tile_count && !changed; i++ )
+			{
+				changed = !board_renderers[i]->is_up_to_date( tiles[i]->get_revision() );
+			}
+
+			if( !changed || stopping )
+			{
+				continue;
+			}
+
+			auto frame_start = Clock::now();
+
+			auto repaint_all = !use_composite;
+			if( use_composite && !composite )
+			{
+				repaint_all = true;
+				composite = sdl2::TexturePtr( SDL_CreateTexture(
+					renderer.get(),
+					SDL_PIXELFORMAT_RGBA8888,
+					SDL_TEXTUREACCESS_TARGET,
+					width,
+					height
+				) );
+			}
+
+			// Without render targets, every tile is drawn every frame
+			if( use_composite &&
+			    (!composite || SDL_SetRenderTarget( renderer.get(), composite.get() )) )
+			{
+				composite.reset();
+				use_composite = false;
+				repaint_all   = true;
+			}
+
+			{
+				PROFILE_SCOPE( "render" );
+
+				for( size_t i = 0; i < tile_count; i++ )
+				{
+					if( !repaint_all && board_renderers[i]->is_up_to_date( tiles[i]->get_revision() ) )
+					{
+						continue;
+					}
+
+					tiles[i]->read( board );
+					board_renderers[i]->render(
+						board,
+						tile_area( i, columns, rows, width, height )
+					);
+				}
+			}
+
+			if( composite )
+			{
+				SDL_SetRenderTarget( renderer.get(), nullptr );
+				SDL_RenderCopy( renderer.get(), composite.get(), nullptr, nullptr );
+			}
+
+			if( show_profile && profile_lines.size() )
+			{
+				draw_profile_overlay( renderer.get(), resources.get_text(), profile_lines );
+			}
+
+			{
+				PROFILE_SCOPE( "present" );
+				SDL_RenderPresent( renderer.get() );
+			}
+
+			auto frame_ns = static_cast<uint64_t>(
+				chrono::duration_cast<chrono::nanoseconds>( Clock::now() - frame_start ).count()
+			);
+			frame_times.add( frame_ns );
+			tools::metrics.frame_seconds.observe( frame_ns );
+			needs_redraw = false;
+
+			// Hold frames back to the display rate when presenting doesn't
+			next_frame_time = max( next_frame_time + frame_interval, Clock::now() );
+			this_thread::sleep_until( next_frame_time );
+		}
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "sdl2.hh"
+#include "board_snapshot.hh"
+#include "common_tools.hh"
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <condition_variable>
+
+
+namespace gui
+{
+	// What the render thread of a window is told to do
+	struct RenderCommand
+	{
+		enum Type
+		{
+			RESIZE, // The window has a new size
+			REDRAW, // The window contents were lost
+			RESET,  // The render targets were lost
+			OPTIONS // What is shown on the boards changed
+		};
+
+		Type type         = REDRAW;
+		int  width        = 0;
+		int  height       = 0;
+		bool move_numbers = false;
+		bool profile      = false; // The timing overlay
+	};
+
+
+	// Draws a window of boards on a thread of its own
+	// - The renderer is created on the thread and only used there, so
+	//   a slow display or vsync only ever holds up this window
+	// - The positions are read from the snapshots the replays publish,
+	//   window events come through a lock-free queue. The replay thread
+	//   never waits on the renderer: when the queue is full, posting
+	//   fails and it tries again later.
+	// - The boards are laid out in a grid of columns x rows tiles, the
+	//   tiles share the board layers and the stone atlas, and only the
+	//   ones with a new position are repainted
+	class RenderWorker
+	{
+		SDL_Window                      *window;
+		SDL_Surface                     *wood;
+		std::string                      font_path;
+		std::vector<const go::SnapshotPublisher*> tiles;
+		size_t                           columns;
+		size_t                           rows;
+		int                              initial_width;
+		int                              initial_height;
+
+		tools::SpscQueue<RenderCommand>  commands;
+		std::atomic<bool>                stopping;
+		std::atomic<bool>                failed;
+
+		// Only wakes the thread up, the commands don't go through it
+		std::mutex                       wake_mutex;
+		std::condition_variable          wake_condition;
+		bool                             wake_requested;
+
+		std::thread                      thread;
+
+
+	  public:
+		RenderWorker(
+			SDL_Window  *target_window,
+			SDL_Surface *wood_surface,
+			std::vector<const go::SnapshotPublisher*> tile_boards,
+			size_t       tile_columns,
+			size_t       tile_rows,
+			int          width,
+			int          height,
+			std::string  truetype_font_path
+		);
+		~RenderWorker();
+
+		// Queues the command without waiting, false if the queue is full.
+		// Only one thread may post.
+		bool post( const RenderCommand& command );
+
+		// Wakes the thread to take the posted commands
+		// and look for new positions
+		void wake();
+
+		// The renderer couldn't be set up, the window shows nothing
+		bool has_failed() const;
+
+		RenderWorker( const RenderWorker& ) = delete;
+		RenderWorker& operator=( const RenderWorker& ) = delete;
+
+
+	  private:
+		void run();
+	};
+
+
+	// Area of a tile in a grid of columns x rows over the whole target
+	SDL_Rect tile_area( size_t index, size_t columns, size_t rows, int width, int height );
+}
@@ -0,0 +1,345 @@
+#include "replay.hh"
+#include "profiler.hh"
+#include "allocation_tracker.hh"
+#include "metrics.hh"
+
+#include <locale>
+#include <codecvt>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+#include <exception>
+
+
+using namespace std;
+using namespace gui;
+
+
+
+Replay::Replay(
+	MoveScheduler::Clock::duration move_interval,
+	const corpus::OpeningTree     *opening_statistics
+)
+: current_move( 0 ),
+  has_game( false ),
+  skip_requested( false ),
+  waits_for_loader( false ),
+  scheduler( move_interval ),
+  published_revision( 0 ),
+  opening_tree( opening_statistics )
+{
+}
+
+
+
+// Calls func( index ) for the board index of every point of a value,
+// a single point or an "aa:cc" rectangle, ignoring points off the board
+template<typename F>
+void for_each_point( const wstring& value, size_t board_size, F func )
+{
+	auto separator = value.find( L':' );
+	auto from = sgf::property_value_to<sgf::Point>( { value.substr( 0, separator ) } );
+	auto to   = from;
+	if( separator != wstring::npos )
+	{
+		to = sgf::property_value_to<sgf::Point>( { value.substr( separator + 1 ) } );
+	}
+
+	for( auto y = min( from.y, to.y ); y <= max( from.y, to.y ); y++ )
+	{
+		for( auto x = min( from.x, to.x ); x <= max( from.x, to.x ); x++ )
+		{
+			if( x >= 1 && y >= 1 && x <= board_size && y <= board_size )
+			{
+				func( (y - 1) * board_size + x - 1 );
+			}
+		}
+	}
+}
+
+
+
+// Copies the markup and the labels of the node into the snapshot
+void add_markup( go::BoardSnapshot& snapshot, const sgf::Node& node )
+{
+	const struct
+	{
+		const wchar_t *identifier;
+		go::Mark       mark;
+	}
+	mark_properties[] =
+	{
+		{ L"TR", go::MARK_TRIANGLE },
+		{ L"CR", go::MARK_CIRCLE },
+		{ L"SQ", go::MARK_SQUARE },
+		{ L"MA", go::MARK_CROSS },
+	};
+
+	auto& properties = node.properties;
+	auto  board_size = snapshot.board_size;
+
+	try
+	{
+		for( auto& mark_property : mark_properties )
+		{
+			auto property = properties.find( mark_property.identifier );
+			if( property == properties.end() )
+			{
+				continue;
+			}
+
+			for( auto& value : property->second )
+			{
+				for_each_point( value.value, board_size, [&]( size_t index )
+				{
+					snapshot.set_mark( index, mark_property.mark );
+				} );
+			}
+		}
+
+		// Labels are "point:text"
+		auto property = properties.find( L"LB" );
+		if( property == properties.end() )
+		{
+			return;
+		}
+
+		wstring_convert<codecvt_utf8<wchar_t>> converter;
+		for( auto& value : property->second )
+		{
+			auto separator = value.value.find( L':' );
+			if( separator == wstring::npos )
+			{
+				continue;
+			}
+
+			auto point = sgf::property_value_to<sgf::Point>( { value.value.substr( 0, separator ) } );
+			if( point.x < 1 || point.y < 1 || point.x > board_size || point.y > board_size )
+			{
+				continue;
+			}
+
+			snapshot.add_label(
+				(point.y - 1) * board_size + point.x - 1,
+				converter.to_bytes( value.value.substr( separator + 1 ) )
+			);
+		}
+	}
+	catch( exception& )
+	{
+		// Broken markup is left out, the position still shows
+	}
+}
+
+
+
+// Moves taken from the scheduler at most in one update, and how many
+// are played between looks at the clock
+const size_t max_moves_per_update = 1 << 16;
+const size_t moves_per_deadline_check = 256;
+
+
+
+bool Replay::update(
+	corpus::GameLoader&              loader,
+	MoveScheduler::Clock::time_point now,
+	MoveScheduler::Clock::time_point deadline
+)
+{
+	PROFILE_SCOPE( "replay" );
+	tools::AllocationScope allocation_scope{ tools::ALLOC_REPLAY };
+
+	if( skip_requested )
+	{
+		corpus::LoadedGame next_game;
+		if( waits_for_loader ? loader.pop( next_game ) : loader.try_pop( next_game ) )
+		{
+			start_game( move( next_game ) );
+		}
+	}
+
+	auto due_moves = scheduler.take_due_moves( now, max_moves_per_update );
+	for( size_t i = 0; i < due_moves; i++ )
+	{
+		// Moves left over are dropped, the replay falls behind
+		// rather than the display
+		if( i && i % moves_per_deadline_check == 0 &&
+		    MoveScheduler::Clock::now() >= deadline )
+		{
+			break;
+		}
+
+		if( has_game )
+		{
+			play_next_move();
+			continue;
+		}
+
+		// The next game wasn't parsed in time, try again later
+		corpus::LoadedGame next_game;
+		if( !(waits_for_loader ? loader.pop( next_game ) : loader.try_pop( next_game )) )
+		{
+			break;
+		}
+
+		start_game( move( next_game ) );
+	}
+
+	if( goban.get_revision() == published_revision )
+	{
+		return false;
+	}
+
+	published_revision = goban.get_revision();
+	try
+	{
+		PROFILE_SCOPE( "publish" );
+
+		go::BoardSnapshot snapshot{ goban };
+		snapshot.move_number = played_moves.size();
+		snapshot.set_info( game.info );
+		if( current_move )
+		{
+			add_markup( snapshot, game.nodes[game.move_nodes[current_move - 1]] );
+		}
+
+		publisher.publish( snapshot );
+	}
+	catch( exception &e )
+	{
+		wcerr << "Couldn't publish the position: " << e.what() << endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+
+bool Replay::is_finished( corpus::GameLoader& loader ) const
+{
+	return !has_game && loader.is_exhausted();
+}
+
+
+
+void Replay::set_waits_for_loader( bool wait )
+{
+	waits_for_loader = wait;
+}
+
+
+
+const corpus::LoadedGame& Replay::get_game() const
+{
+	return game;
+}
+
+
+
+size_t Replay::get_move_number() const
+{
+	return played_moves.size();
+}
+
+
+
+go::Goban& Replay::get_goban()
+{
+	return goban;
+}
+
+
+
+MoveScheduler& Replay::get_scheduler()
+{
+	return scheduler;
+}
+
+
+
+const go::SnapshotPublisher& Replay::get_publisher() const
+{
+	return publisher;
+}
+
+
+
+void Replay::jump_to_end()
+{
+	while( has_game )
+	{
+		play_next_move();
+	}
+}
+
+
+
+void Replay::skip_game()
+{
+	has_game       = false;
+	skip_requested = true;
+}
+
+
+
+void Replay::start_game( corpus::LoadedGame&& next_game )
+{
+	game         = move( next_game );
+	current_move   = 0;
+	has_game       = true;
+	skip_requested = false;
+
+	wcout << "Game played at date: " << game.date << endl;
+
+	goban = go::Goban{ game.board_size };
+	played_moves.clear();
+}
+
+
+
+// Plays out the current move and moves on to the next one
+void Replay::play_next_move()
+{
+	auto& next_move = game.moves[current_move];
+
+	try
+	{
+		// A pass changes no stones, but the move number and the
+		// markup shown with it
+		if( next_move.point.x )
+		{
+			goban.play_stone( {
+				next_move.point.x,
+				next_move.point.y,
+				next_move.black ? go::Side::BLACK : go::Side::WHITE,
+				current_move + 1
+			} );
+		}
+		else
+		{
+			goban.pass();
+		}
+
+		played_moves.push_back( next_move );
+		tools::metrics.moves_played.add();
+		if( opening_tree )
+		{
+			auto opening = opening_tree->find( game.board_size, played_moves, played_moves.size() );
+			if( opening )
+			{
+				wcout << corpus::opening_stats_text( *opening ) << endl;
+			}
+		}
+	}
+	catch( exception &e )
+	{
+		wcerr << "Skipping a broken move: " << e.what() << endl;
+	}
+
+	// The game is played out, wait for the next one
+	if( ++current_move >= game.moves.size() )
+	{
+		has_game = false;
+	}
+}
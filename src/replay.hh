@@ -0,0 +1,85 @@
+#pragma once
+
+#include "sgf.hh"
+#include "goban.hh"
+#include "board_snapshot.hh"
+#include "game_loader.hh"
+#include "opening_tree.hh"
+#include "move_scheduler.hh"
+
+#include <vector>
+
+
+namespace gui
+{
+	// A board being replayed on its own clock, taking the next game
+	// from the loader whenever the current one ends
+	// - Every new position is published as a snapshot, for the threads
+	//   that draw or otherwise look at the board
+	class Replay
+	{
+		corpus::LoadedGame         game;
+		size_t                     current_move;
+		bool                       has_game;
+		bool                       skip_requested;
+		bool                       waits_for_loader;
+		go::Goban                  goban;
+		MoveScheduler              scheduler;
+		go::SnapshotPublisher      publisher;
+		uint64_t                   published_revision;
+
+		// Moves of the current game so far, for the opening statistics
+		std::vector<sgf::Move>     played_moves;
+		const corpus::OpeningTree *opening_tree;
+
+
+	  public:
+		Replay(
+			MoveScheduler::Clock::duration move_interval,
+			const corpus::OpeningTree     *opening_statistics = nullptr
+		);
+
+		// Plays out the moves due by now, stopping early once the
+		// deadline has passed so that a fast replay can't hold up the
+		// frame. Only the resulting position is published.
+		// Between games the final position stays up until the loader
+		// has the next game ready. Returns true if a new position
+		// was published.
+		bool update(
+			corpus::GameLoader&              loader,
+			MoveScheduler::Clock::time_point now,
+			MoveScheduler::Clock::time_point deadline
+		);
+
+		// Plays the rest of the current game at once
+		void jump_to_end();
+
+		// Drops the current game, the next one starts with the next
+		// update if the loader has it ready
+		void skip_game();
+
+		// The last game has ended and the loader has no more
+		bool is_finished( corpus::GameLoader& loader ) const;
+
+		// Wait for the loader between games instead of dropping moves
+		// until it has the next one, for runs that have to play the
+		// same moves every time
+		void set_waits_for_loader( bool wait );
+
+		// The current game, or the last one once it has ended
+		const corpus::LoadedGame& get_game() const;
+
+		// Moves played of the current game
+		size_t         get_move_number() const;
+
+		go::Goban&     get_goban();
+		MoveScheduler& get_scheduler();
+
+		const go::SnapshotPublisher& get_publisher() const;
+
+
+	  private:
+		void start_game( corpus::LoadedGame&& next_game );
+		void play_next_move();
+	};
+}
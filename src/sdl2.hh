@@ -16,11 +16,13 @@ namespace sdl2
 		void operator()( SDL_Window   *ptr ) { if( ptr ) SDL_DestroyWindow( ptr ); }
 		void operator()( SDL_Texture  *ptr ) { if( ptr ) SDL_DestroyTexture( ptr ); }
 		void operator()( SDL_Renderer *ptr ) { if( ptr ) SDL_DestroyRenderer( ptr ); }
+		void operator()( TTF_Font     *ptr ) { if( ptr ) TTF_CloseFont( ptr ); }
 	};
 
 	using SurfacePtr  = std::unique_ptr<SDL_Surface, Deleter>;
 	using WindowPtr   = std::unique_ptr<SDL_Window, Deleter>;
 	using TexturePtr  = std::unique_ptr<SDL_Texture, Deleter>;
 	using RendererPtr = std::unique_ptr<SDL_Renderer, Deleter>;
+	using FontPtr     = std::unique_ptr<TTF_Font, Deleter>;
 }
 
@@ -0,0 +1,424 @@
+#include "session.hh"
+#include "offscreen_renderer.hh"
+#include "board_snapshot.hh"
+#include "common_tools.hh"
+#include "game_loader.hh"
+#include "profiler.hh"
+#include "metrics.hh"
+
+#include <memory>
+#include <cstdio>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+
+using namespace std;
+using namespace gui;
+
+
+const char *session_magic = "visualis-session";
+const int   session_version = 1;
+
+
+
+SessionRecorder::SessionRecorder( const string& path, const Session& session )
+: file( path ),
+  start( chrono::steady_clock::now() )
+{
+	if( !file )
+	{
+		throw runtime_error( "Couldn't write the session to '" + path + "'" );
+	}
+
+	file << session_magic << " " << session_version << "\n"
+	     << "seed " << session.seed << "\n"
+	     << "move-interval-ns " << session.move_interval_ns << "\n"
+	     << "update-period-ns " << session.update_period_ns << "\n"
+	     << "wall " << session.wall_columns << " " << session.wall_rows << "\n";
+
+	for( auto& size : session.window_sizes )
+	{
+		file << "window " << size.first << " " << size.second << "\n";
+	}
+
+	// Paths last on their line, they may have spaces
+	file << "games " << session.games.size() << "\n";
+	for( auto& game : session.games )
+	{
+		file << game << "\n";
+	}
+
+	file.flush();
+}
+
+
+
+SessionRecorder::~SessionRecorder()
+{
+	file << "end " << elapsed_ns() << "\n";
+}
+
+
+
+void SessionRecorder::record_key( SDL_Keycode key )
+{
+	file << "key " << elapsed_ns() << " " << key << "\n";
+	file.flush();
+}
+
+
+
+uint64_t SessionRecorder::elapsed_ns() const
+{
+	return static_cast<uint64_t>( chrono::duration_cast<chrono::nanoseconds>(
+		chrono::steady_clock::now() - start
+	).count() );
+}
+
+
+
+Session gui::read_session( const string& path )
+{
+	ifstream file( path );
+	if( !file )
+	{
+		throw runtime_error( "Couldn't open '" + path + "'" );
+	}
+
+	string magic;
+	int    version = 0;
+	if( !(file >> magic >> version) || magic != session_magic || version != session_version )
+	{
+		throw runtime_error( "'" + path + "' isn't a session of this version" );
+	}
+
+	Session session;
+	string  line;
+	while( getline( file, line ) )
+	{
+		stringstream fields( line );
+		string field;
+		if( !(fields >> field) )
+		{
+			continue;
+		}
+
+		if( field == "seed" )
+		{
+			fields >> session.seed;
+		}
+		else if( field == "move-interval-ns" )
+		{
+			fields >> session.move_interval_ns;
+		}
+		else if( field == "update-period-ns" )
+		{
+			fields >> session.update_period_ns;
+		}
+		else if( field == "wall" )
+		{
+			fields >> session.wall_columns >> session.wall_rows;
+		}
+		else if( field == "window" )
+		{
+			pair<int, int> size;
+			fields >> size.first >> size.second;
+			session.window_sizes.push_back( size );
+		}
+		else if( field == "games" )
+		{
+			size_t count = 0;
+			fields >> count;
+			for( size_t i = 0; i < count && getline( file, line ); i++ )
+			{
+				session.games.push_back( line );
+			}
+		}
+		else if( field == "key" )
+		{
+			Session::KeyPress key_press;
+			fields >> key_press.time_ns >> key_press.key;
+			session.keys.push_back( key_press );
+		}
+		else if( field == "end" )
+		{
+			fields >> session.duration_ns;
+		}
+
+		if( fields.fail() )
+		{
+			throw runtime_error( "Broken line in the session: " + line );
+		}
+	}
+
+	if( session.games.empty() || session.window_sizes.empty() ||
+	    !session.update_period_ns || !session.wall_columns || !session.wall_rows )
+	{
+		throw runtime_error( "'" + path + "' is missing a part of the session" );
+	}
+
+	return session;
+}
+
+
+
+void gui::apply_replay_key( SDL_Keycode key, const vector<Replay*>& replays )
+{
+	bool pause = true;
+	if( replays.size() )
+	{
+		pause = !replays[0]->get_scheduler().is_paused();
+	}
+
+	for( auto replay : replays )
+	{
+		auto& scheduler = replay->get_scheduler();
+		switch( key )
+		{
+			case SDLK_SPACE:
+				scheduler.set_paused( pause );
+				break;
+
+			case SDLK_PLUS:
+			case SDLK_EQUALS:
+			case SDLK_KP_PLUS:
+				scheduler.faster();
+				break;
+
+			case SDLK_MINUS:
+			case SDLK_KP_MINUS:
+				scheduler.slower();
+				break;
+
+			case SDLK_END:
+				replay->jump_to_end();
+				break;
+
+			case SDLK_n:
+			case SDLK_PAGEDOWN:
+				replay->skip_game();
+				break;
+		}
+	}
+}
+
+
+
+// Plays the session on a simulated clock, drawing the boards offscreen
+// if there are renderers
+void run_session( const Session& session, vector<unique_ptr<OffscreenRenderer>>& renderers )
+{
+	using Clock = MoveScheduler::Clock;
+
+	auto board_count = session.wall_columns * session.wall_rows * session.window_sizes.size();
+
+	corpus::GameLoader loader{ session.games, max<size_t>( board_count, 4 ) };
+
+	vector<unique_ptr<Replay>> replays;
+	vector<Replay*>            replay_pointers;
+	for( size_t i = 0; i < board_count; i++ )
+	{
+		replays.emplace_back( new Replay( chrono::nanoseconds( session.move_interval_ns ) ) );
+		replays.back()->set_waits_for_loader( true );
+		replay_pointers.push_back( replays.back().get() );
+	}
+
+	unique_ptr<go::BoardSnapshot> snapshot{ new go::BoardSnapshot };
+
+	auto start        = Clock::now();
+	auto period       = session.update_period_ns;
+	auto elapsed_ns   = uint64_t( 0 );
+	size_t next_key   = 0;
+	bool move_numbers = false;
+
+	while( !session.duration_ns || elapsed_ns <= session.duration_ns )
+	{
+		// The keys pressed by now, ESC ends the session like it did
+		bool quit = false;
+		for( ; next_key < session.keys.size() && session.keys[next_key].time_ns <= elapsed_ns; next_key++ )
+		{
+			auto key = session.keys[next_key].key;
+			if( key == SDLK_ESCAPE )
+			{
+				quit = true;
+			}
+			else if( key == SDLK_m )
+			{
+				move_numbers = !move_numbers;
+				for( auto& renderer : renderers )
+				{
+					renderer->set_move_numbers( move_numbers );
+				}
+			}
+
+			apply_replay_key( key, replay_pointers );
+		}
+
+		if( quit )
+		{
+			break;
+		}
+
+		auto now = start + chrono::nanoseconds( elapsed_ns );
+		bool all_finished = true;
+		for( size_t i = 0; i < replays.size(); i++ )
+		{
+			auto& replay = *replays[i];
+			if( replay.update( loader, now, Clock::time_point::max() ) && i < renderers.size() )
+			{
+				PROFILE_SCOPE( "render" );
+
+				replay.get_publisher().read( *snapshot );
+				renderers[i]->render( *snapshot );
+			}
+
+			all_finished = all_finished && replay.is_finished( loader );
+		}
+
+		// Without an end nothing stops a paused session but the games
+		// running out, or the last key
+		if( all_finished ||
+		    (!session.duration_ns && next_key == session.keys.size() &&
+		     replays[0]->get_scheduler().is_paused()) )
+		{
+			break;
+		}
+
+		elapsed_ns += period;
+	}
+}
+
+
+
+int gui::replay_session_command( const vector<string>& args )
+{
+	auto usage = []()
+	{
+		wcout << "Usage: --replay-session <session> [--render] [--wood <image>] [--font <file.ttf>]" << endl;
+		return 1;
+	};
+
+	if( args.empty() )
+	{
+		return usage();
+	}
+
+	bool   render     = false;
+	string wood_image = "data/wood.jpg";
+	string font_path  = default_font_path;
+	for( size_t i = 1; i < args.size(); i++ )
+	{
+		if( args[i] == "--render" )
+		{
+			render = true;
+		}
+		else if( args[i] == "--wood" && i + 1 < args.size() )
+		{
+			wood_image = args[++i];
+		}
+		else if( args[i] == "--font" && i + 1 < args.size() )
+		{
+			font_path = args[++i];
+		}
+		else
+		{
+			return usage();
+		}
+	}
+
+	auto session = read_session( args[0] );
+
+	auto defer_quit = tools::make_defer( [render]()
+	{
+		if( !render )
+		{
+			return;
+		}
+
+		if( TTF_WasInit() )
+		{
+			TTF_Quit();
+		}
+		SDL_Quit();
+	} );
+
+	// The boards are drawn offscreen at the size of their tiles
+	vector<unique_ptr<OffscreenRenderer>> renderers;
+	sdl2::SurfacePtr wood;
+
+	if( render )
+	{
+		SDL_SetHint( SDL_HINT_VIDEODRIVER, "dummy" );
+		if( SDL_Init( SDL_INIT_VIDEO ) )
+		{
+			wcerr << "SDL_Init() failed: " << SDL_GetError() << endl;
+			return 1;
+		}
+
+		if( TTF_Init() )
+		{
+			wcerr << "TTF_Init() failed: " << TTF_GetError() << endl;
+		}
+
+		wood = sdl2::SurfacePtr( IMG_Load( wood_image.c_str() ) );
+		if( !wood )
+		{
+			throw runtime_error( "Couldn't load '" + wood_image + "': " + IMG_GetError() );
+		}
+
+		for( auto& size : session.window_sizes )
+		{
+			auto tile_width  = max( size.first / static_cast<int>( session.wall_columns ), 1 );
+			auto tile_height = max( size.second / static_cast<int>( session.wall_rows ), 1 );
+			for( size_t i = 0; i < session.wall_columns * session.wall_rows; i++ )
+			{
+				renderers.emplace_back( new OffscreenRenderer( tile_width, tile_height, wood.get(), font_path ) );
+			}
+		}
+	}
+
+	wcout << "Replaying " << session.games.size() << " games, seed " << session.seed << endl;
+
+	tools::set_thread_name( "main" );
+	tools::enable_profiling( true );
+
+	auto moves_before = tools::metrics.moves_played.get();
+	auto games_before = tools::metrics.games_loaded.get();
+	auto wall_start   = tools::profile_clock_ns();
+
+	run_session( session, renderers );
+
+	auto wall_ns = tools::profile_clock_ns() - wall_start;
+	auto moves   = tools::metrics.moves_played.get() - moves_before;
+	auto games   = tools::metrics.games_loaded.get() - games_before;
+
+	char line[160];
+	snprintf(
+		line, sizeof( line ), "%llu games, %llu moves in %.3f s, %.0f moves/s",
+		static_cast<unsigned long long>( games ), static_cast<unsigned long long>( moves ),
+		wall_ns / 1e9, wall_ns ? moves * 1e9 / wall_ns : 0.0
+	);
+	wcout << line << endl;
+
+	auto totals = tools::get_stage_totals();
+	sort( totals.begin(), totals.end(), []( const tools::StageTotal& a, const tools::StageTotal& b )
+	{
+		return a.nanoseconds > b.nanoseconds;
+	} );
+
+	snprintf( line, sizeof( line ), "%-18s %12s %10s %12s", "stage", "total ms", "count", "mean us" );
+	wcout << line << endl;
+	for( auto& total : totals )
+	{
+		snprintf(
+			line, sizeof( line ), "%-18s %12.3f %10llu %12.3f",
+			total.name, total.nanoseconds / 1e6, static_cast<unsigned long long>( total.count ),
+			total.count ? total.nanoseconds / 1e3 / total.count : 0.0
+		);
+		wcout << line << endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "sdl2.hh"
+#include "replay.hh"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <cstdint>
+
+
+// Recording viewer sessions and running them again headless
+// - A session is what the viewer was started with, the games in the
+//   order they were handed to the loader, and the keys pressed with
+//   their time since the start
+// - Replaying one plays the same games with the same keys at the same
+//   moments, on a simulated clock as fast as it goes, and reports the
+//   time spent in every profiled stage. Unlike in the viewer the
+//   replays wait on the loader rather than drop moves while it's
+//   behind, so every run plays exactly the same moves.
+namespace gui
+{
+	struct Session
+	{
+		struct KeyPress
+		{
+			uint64_t    time_ns; // Since the start
+			SDL_Keycode key;
+		};
+
+		uint64_t              seed             = 0;
+		uint64_t              move_interval_ns = 0;
+		uint64_t              update_period_ns = 0;
+		size_t                wall_columns     = 1;
+		size_t                wall_rows        = 1;
+		std::vector<std::pair<int, int>> window_sizes;
+		std::vector<std::string> games;
+		std::vector<KeyPress> keys;
+		uint64_t              duration_ns      = 0; // 0 if it never ended
+	};
+
+
+	// Writes a session as it happens, the keys go out as they're
+	// pressed so that a crash still leaves the session up to it
+	class SessionRecorder
+	{
+		std::ofstream                         file;
+		std::chrono::steady_clock::time_point start;
+
+
+	  public:
+		// Everything but the keys and the duration, throws if the file
+		// can't be written. The clock starts here.
+		SessionRecorder( const std::string& path, const Session& session );
+		~SessionRecorder();
+
+		void record_key( SDL_Keycode key );
+
+		SessionRecorder( const SessionRecorder& ) = delete;
+		SessionRecorder& operator=( const SessionRecorder& ) = delete;
+
+
+	  private:
+		uint64_t elapsed_ns() const;
+	};
+
+
+	// Throws if the file can't be read or isn't a session
+	Session read_session( const std::string& path );
+
+	// Keys that act on the replays, the same in the viewer and in a
+	// replayed session. Pausing follows the first replay.
+	void apply_replay_key( SDL_Keycode key, const std::vector<Replay*>& replays );
+
+	int replay_session_command( const std::vector<std::string>& args );
+}
@@ -1,4 +1,6 @@
 #include "sgf.hh"
+#include "profiler.hh"
+#include "allocation_tracker.hh"
 
 #include <locale>
 #include <cctype>
@@ -163,21 +165,32 @@ Node parse_node_data( wstring data )
 
 	while( data.length() )
 	{
-		// Fetch property identifier
-		size_t identifier_length = 0;
+		// Fetch property identifier, FF[3] allows lowercase letters
+		// in between that aren't part of the identifier
+		size_t  identifier_length = 0;
+		wstring identifier;
 		for( auto c : data )
 		{
-			if( !std::isupper( c ) )
+			if( !std::isalpha( c ) )
 			{
 				break;
 			}
 
+			if( std::isupper( c ) )
+			{
+				identifier += c;
+			}
+
 			identifier_length++;
 		}
-		auto identifier = data.substr( 0, identifier_length );
 
 		data = trim( data.substr( identifier_length ) );
 
+		if( !identifier.length() || !data.length() || data[0] != '[' )
+		{
+			throw runtime_error( "Syntax error, expected a property" );
+		}
+
 
 		// Fetch property values
 		vector<PropertyValue> values;
@@ -249,6 +262,11 @@ Node parse_data( wstring data )
 
 			data = data.substr( node_end );
 		}
+
+		else
+		{
+			throw runtime_error( "Syntax error, expected a node or a game tree" );
+		}
 	}
 
 	return start_node;
@@ -258,6 +276,9 @@ Node parse_data( wstring data )
 
 Node sgf::read_game_tree( wstring data )
 {
+	PROFILE_SCOPE( "parse" );
+	tools::AllocationScope allocation_scope{ tools::ALLOC_PARSE };
+
 	auto root = parse_data( data );
 
 	if( root.children.size() )
@@ -354,3 +375,216 @@ Point sgf::property_value_to<Point>( const PropertyValue &val )
 
 	return point;
 }
+
+
+
+Point parse_point( const string &value, size_t board_size )
+{
+	auto coordinate = []( char c ) -> size_t
+	{
+		if( c >= 'a' && c <= 'z' )
+		{
+			return c - 'a' + 1;
+		}
+		else if( c >= 'A' && c <= 'Z' )
+		{
+			return c - 'A' + 27;
+		}
+
+		throw std::runtime_error( "Not a valid point property value" );
+	};
+
+	if( value.size() == 0 )
+	{
+		return { 0, 0 };
+	}
+
+	if( value.size() != 2 )
+	{
+		throw std::runtime_error( "Not a valid point property value" );
+	}
+
+	Point point{ coordinate( value[0] ), coordinate( value[1] ) };
+
+	// "tt" is a pass in FF[3] on boards up to 19x19
+	if( board_size <= 19 && point.x == 20 && point.y == 20 )
+	{
+		return { 0, 0 };
+	}
+
+	if( point.x > board_size || point.y > board_size )
+	{
+		throw std::runtime_error( "Point outside of the board" );
+	}
+
+	return point;
+}
+
+
+
+// Expands both single points and FF[4] compressed "aa:cc" rectangles
+void append_points( vector<Point> &points, const string &value, size_t board_size )
+{
+	auto separator = value.find( ':' );
+	if( separator == string::npos )
+	{
+		points.push_back( parse_point( value, board_size ) );
+		return;
+	}
+
+	auto from = parse_point( value.substr( 0, separator ), board_size );
+	auto to   = parse_point( value.substr( separator + 1 ), board_size );
+
+	for( auto y = min( from.y, to.y ); y <= max( from.y, to.y ); y++ )
+	{
+		for( auto x = min( from.x, to.x ); x <= max( from.x, to.x ); x++ )
+		{
+			points.push_back( { x, y } );
+		}
+	}
+}
+
+
+
+string trim_value( const string &value )
+{
+	auto begin = value.find_first_not_of( " \t\r\n" );
+	if( begin == string::npos )
+	{
+		return {};
+	}
+
+	auto end = value.find_last_not_of( " \t\r\n" );
+	return value.substr( begin, end - begin + 1 );
+}
+
+
+
+MainLine sgf::read_main_line( const string &data )
+{
+	PROFILE_SCOPE( "parse main line" );
+	tools::AllocationScope allocation_scope{ tools::ALLOC_PARSE };
+
+	MainLine line;
+
+	auto pos = data.find( '(' );
+	if( pos == string::npos )
+	{
+		throw runtime_error( "Syntax error, couldn't find a game tree" );
+	}
+
+	size_t node_count = 0;
+	string identifier;
+	string value;
+	bool   reading_identifier = false;
+
+	// Child variations come after the nodes of a sequence, so the main
+	// line simply runs until the first closing bracket
+	for( pos++; pos < data.size(); pos++ )
+	{
+		auto c = data[pos];
+
+		if( c == ')' )
+		{
+			break;
+		}
+
+		else if( c == ';' )
+		{
+			node_count++;
+			reading_identifier = false;
+			identifier.clear();
+		}
+
+		else if( std::isalpha( static_cast<unsigned char>( c ) ) )
+		{
+			if( !reading_identifier )
+			{
+				reading_identifier = true;
+				identifier.clear();
+			}
+
+			// Lower case letters of old FF[3] identifiers are ignored
+			if( std::isupper( static_cast<unsigned char>( c ) ) )
+			{
+				identifier += c;
+			}
+		}
+
+		else if( c == '[' )
+		{
+			reading_identifier = false;
+
+			// Grab the value, minding the escapes
+			value.clear();
+			bool escape = false;
+			for( pos++; pos < data.size(); pos++ )
+			{
+				c = data[pos];
+				if( c == ']' && !escape )
+				{
+					break;
+				}
+
+				escape = (c == '\\' && !escape);
+				if( !escape )
+				{
+					value += c;
+				}
+			}
+
+			if( pos >= data.size() )
+			{
+				throw runtime_error(
+					"Syntax error, unexpected end of content inside a value"
+				);
+			}
+
+			if( identifier == "B" || identifier == "W" )
+			{
+				line.moves.push_back( {
+					parse_point( trim_value( value ), line.board_size ),
+					identifier == "B"
+				} );
+			}
+
+			// Rest of the properties only matter in the root node
+			else if( node_count != 1 )
+			{
+				continue;
+			}
+
+			else if( identifier == "SZ" )
+			{
+				line.board_size = std::stoul( trim_value( value ) );
+				if( line.board_size < 1 || line.board_size > 52 )
+				{
+					throw runtime_error( "Board size out of range" );
+				}
+			}
+			else if( identifier == "GM" )
+			{
+				line.game_type = std::stoi( trim_value( value ) );
+			}
+			else if( identifier == "RE" )
+			{
+				line.result = trim_value( value );
+			}
+			else if( identifier == "AB" )
+			{
+				append_points( line.black_setup, trim_value( value ), line.board_size );
+			}
+			else if( identifier == "AW" )
+			{
+				append_points( line.white_setup, trim_value( value ), line.board_size );
+			}
+		}
+	}
+
+	if( !node_count )
+	{
+		throw runtime_error( "Syntax error, the game tree has no nodes" );
+	}
+
+	return line;
+}
@@ -90,6 +90,29 @@ namespace sgf
 	void print_game_tree( const Node &root );
 
 
+	// A move of the main line, point { 0, 0 } is a pass
+	struct Move
+	{
+		Point point;
+		bool  black;
+	};
+
+	// The main line of the first game in the data, following the first
+	// variation at every branch. Only root properties are kept besides
+	// the moves, so this is a lot cheaper than read_game_tree().
+	struct MainLine
+	{
+		size_t        board_size = 19;
+		int           game_type  = 1;
+		vector<Point> black_setup; // AB
+		vector<Point> white_setup; // AW
+		vector<Move>  moves;
+		string        result;      // RE
+	};
+
+	MainLine read_main_line( const string &data );
+
+
 	template<typename T>
 	T property_value_to( const PropertyValue &val )
 	{
@@ -0,0 +1,117 @@
+#include "sprite_batch.hh"
+
+using namespace std;
+using namespace gui;
+
+
+
+SpriteBatch::SpriteBatch( SDL_Renderer *target_renderer )
+: renderer( target_renderer ),
+  texture( nullptr ),
+  texture_width( 1 ),
+  texture_height( 1 )
+{
+}
+
+
+
+void SpriteBatch::begin( SDL_Texture *source_texture )
+{
+	flush();
+
+	texture = source_texture;
+	if( !texture ||
+	    SDL_QueryTexture( texture, nullptr, nullptr, &texture_width, &texture_height ) )
+	{
+		texture_width  = 1;
+		texture_height = 1;
+	}
+}
+
+
+
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+
+void SpriteBatch::add( const SDL_Rect& source, const SDL_Rect& target )
+{
+	const SDL_Color color{ 255, 255, 255, 255 };
+
+	auto u0 = static_cast<float>( source.x ) / texture_width;
+	auto v0 = static_cast<float>( source.y ) / texture_height;
+	auto u1 = static_cast<float>( source.x + source.w ) / texture_width;
+	auto v1 = static_cast<float>( source.y + source.h ) / texture_height;
+
+	auto x0 = static_cast<float>( target.x );
+	auto y0 = static_cast<float>( target.y );
+	auto x1 = static_cast<float>( target.x + target.w );
+	auto y1 = static_cast<float>( target.y + target.h );
+
+	auto first = static_cast<int>( vertices.size() );
+	vertices.push_back( { { x0, y0 }, color, { u0, v0 } } );
+	vertices.push_back( { { x1, y0 }, color, { u1, v0 } } );
+	vertices.push_back( { { x1, y1 }, color, { u1, v1 } } );
+	vertices.push_back( { { x0, y1 }, color, { u0, v1 } } );
+
+	const int quad[] = { 0, 1, 2, 0, 2, 3 };
+	for( auto corner : quad )
+	{
+		indices.push_back( first + corner );
+	}
+}
+
+
+
+void SpriteBatch::flush()
+{
+	if( texture && indices.size() )
+	{
+		SDL_RenderGeometry(
+			renderer,
+			texture,
+			vertices.data(),
+			static_cast<int>( vertices.size() ),
+			indices.data(),
+			static_cast<int>( indices.size() )
+		);
+	}
+
+	vertices.clear();
+	indices.clear();
+}
+
+
+
+size_t SpriteBatch::size() const
+{
+	return vertices.size() / 4;
+}
+
+#else
+
+void SpriteBatch::add( const SDL_Rect& source, const SDL_Rect& target )
+{
+	sources.push_back( source );
+	targets.push_back( target );
+}
+
+
+
+void SpriteBatch::flush()
+{
+	for( size_t i = 0; texture && i < sources.size(); i++ )
+	{
+		SDL_RenderCopy( renderer, texture, &sources[i], &targets[i] );
+	}
+
+	sources.clear();
+	targets.clear();
+}
+
+
+
+size_t SpriteBatch::size() const
+{
+	return sources.size();
+}
+
+#endif
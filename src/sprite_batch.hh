@@ -0,0 +1,42 @@
+#pragma once
+
+#include "sdl2.hh"
+
+#include <vector>
+
+
+namespace gui
+{
+	// Collects copies from one texture and submits them together
+	// - With SDL 2.0.18 and newer the whole batch is one
+	//   SDL_RenderGeometry() call, older versions fall back to an
+	//   SDL_RenderCopy() per sprite, still without state changes between
+	class SpriteBatch
+	{
+		SDL_Renderer *renderer;
+		SDL_Texture  *texture;
+		int           texture_width;
+		int           texture_height;
+
+		#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+		std::vector<SDL_Vertex> vertices;
+		std::vector<int>        indices;
+		#else
+		std::vector<SDL_Rect>   sources;
+		std::vector<SDL_Rect>   targets;
+		#endif
+
+
+	  public:
+		SpriteBatch( SDL_Renderer *target_renderer );
+
+		// Flushes whatever was batched from the previous texture
+		void begin( SDL_Texture *source_texture );
+
+		void add( const SDL_Rect& source, const SDL_Rect& target );
+
+		void flush();
+
+		size_t size() const;
+	};
+}
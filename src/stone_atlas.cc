@@ -0,0 +1,137 @@
+#include "stone_atlas.hh"
+
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+
+using namespace std;
+using namespace gui;
+
+
+
+StoneAtlas::StoneAtlas( SDL_Renderer *target_renderer )
+: renderer( target_renderer ), diameter( 0 )
+{
+}
+
+
+
+// Share of the pixel covered by a circle, from 4x4 samples
+float circle_coverage( int x, int y, float center, float radius )
+{
+	int inside = 0;
+	for( int sample_y = 0; sample_y < 4; sample_y++ )
+	{
+		for( int sample_x = 0; sample_x < 4; sample_x++ )
+		{
+			auto dx = x + (sample_x + 0.5f) / 4 - center;
+			auto dy = y + (sample_y + 0.5f) / 4 - center;
+			inside += (dx * dx + dy * dy <= radius * radius);
+		}
+	}
+
+	return inside / 16.f;
+}
+
+
+
+bool StoneAtlas::prepare( int stone_diameter )
+{
+	stone_diameter = max( stone_diameter, 1 );
+	if( texture && stone_diameter == diameter )
+	{
+		return true;
+	}
+
+	diameter = stone_diameter;
+	texture.reset();
+
+	auto surface = sdl2::SurfacePtr( SDL_CreateRGBSurfaceWithFormat(
+		0, diameter * 4, diameter, 32, SDL_PIXELFORMAT_RGBA8888
+	) );
+	if( !surface )
+	{
+		wcerr << "StoneAtlas::prepare() - Couldn't create surface: "
+		      << SDL_GetError() << endl;
+		diameter = 0;
+		return false;
+	}
+
+	auto radius = diameter / 2.f;
+
+	SDL_LockSurface( surface.get() );
+	for( int sprite = 0; sprite < 4; sprite++ )
+	{
+		bool white  = sprite & 1;
+		bool marked = sprite & 2;
+
+		for( int y = 0; y < diameter; y++ )
+		{
+			auto row = reinterpret_cast<Uint32*>(
+				static_cast<Uint8*>( surface->pixels ) + y * surface->pitch
+			);
+
+			for( int x = 0; x < diameter; x++ )
+			{
+				auto coverage = circle_coverage( x, y, radius, radius );
+
+				// Light from the top left, a highlight on the stone
+				auto hx = x + 0.5f - radius * 0.7f;
+				auto hy = y + 0.5f - radius * 0.7f;
+				auto highlight = max( 0.f, 1.f - sqrt( hx * hx + hy * hy ) / (radius * 1.3f) );
+
+				float shade = white ? 200.f + 55.f * highlight
+				                    : 20.f + 70.f * highlight * highlight;
+
+				// Last move marker, a dot of the opposite colour
+				if( marked )
+				{
+					auto mark = circle_coverage( x, y, radius, radius * 0.3f );
+					shade = shade * (1.f - mark) + (white ? 30.f : 235.f) * mark;
+				}
+
+				auto value = static_cast<Uint32>( shade );
+				auto alpha = static_cast<Uint32>( coverage * 255.f + 0.5f );
+
+				row[sprite * diameter + x] =
+					(value << 24) | (value << 16) | (value << 8) | alpha;
+			}
+		}
+	}
+	SDL_UnlockSurface( surface.get() );
+
+	texture = sdl2::TexturePtr( SDL_CreateTextureFromSurface( renderer, surface.get() ) );
+	if( !texture )
+	{
+		wcerr << "StoneAtlas::prepare() - Couldn't create texture: "
+		      << SDL_GetError() << endl;
+		diameter = 0;
+		return false;
+	}
+
+	SDL_SetTextureBlendMode( texture.get(), SDL_BLENDMODE_BLEND );
+	return true;
+}
+
+
+
+SDL_Texture* StoneAtlas::get_texture() const
+{
+	return texture.get();
+}
+
+
+
+int StoneAtlas::get_diameter() const
+{
+	return diameter;
+}
+
+
+
+SDL_Rect StoneAtlas::get_sprite( go::Side side, bool last_move ) const
+{
+	auto index = (side == go::Side::WHITE ? 1 : 0) + (last_move ? 2 : 0);
+	return { index * diameter, 0, diameter, diameter };
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "sdl2.hh"
+#include "goban.hh"
+
+
+namespace gui
+{
+	// Round anti-aliased stone sprites of one size, rendered in software
+	// into a single texture:
+	//   [ black | white | black, last move | white, last move ]
+	// The sprites are only regenerated when the stone size changes.
+	class StoneAtlas
+	{
+		SDL_Renderer     *renderer;
+		sdl2::TexturePtr  texture;
+		int               diameter;
+
+
+	  public:
+		StoneAtlas( SDL_Renderer *target_renderer );
+
+		// Makes sure the sprites are of the given diameter,
+		// returns false if they couldn't be created
+		bool prepare( int stone_diameter );
+
+		SDL_Texture* get_texture() const;
+		int          get_diameter() const;
+
+		SDL_Rect get_sprite( go::Side side, bool last_move ) const;
+	};
+}
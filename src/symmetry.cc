@@ -0,0 +1,137 @@
+#include "symmetry.hh"
+
+#include <algorithm>
+
+using namespace go;
+using namespace std;
+
+
+
+void go::transform_point(
+	size_t& x,
+	size_t& y,
+	size_t  board_size,
+	size_t  symmetry
+)
+{
+	if( symmetry & 1 )
+	{
+		swap( x, y );
+	}
+
+	if( symmetry & 2 )
+	{
+		x = board_size - 1 - x;
+	}
+
+	if( symmetry & 4 )
+	{
+		y = board_size - 1 - y;
+	}
+}
+
+
+
+uint64_t splitmix64( uint64_t value )
+{
+	value += 0x9e3779b97f4a7c15ULL;
+	value  = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	value  = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+	return value ^ (value >> 31);
+}
+
+
+
+uint64_t go::zobrist_key( size_t x, size_t y, Side side )
+{
+	if( side == NONE )
+	{
+		return 0;
+	}
+
+	// The keys end up in index files, so they have to stay the same
+	// from run to run and can't come from a randomly seeded generator
+	return splitmix64( ((y * 52 + x) << 1) | (side == WHITE ? 1 : 0) );
+}
+
+
+
+Side swap_colour( Side side )
+{
+	return side == BLACK ? WHITE : side == WHITE ? BLACK : NONE;
+}
+
+
+
+go::PositionHasher::PositionHasher( size_t size )
+: board_size( size ),
+  stone_count( 0 ),
+  sides( size * size, NONE ),
+  transformed( size * size * symmetry_count )
+{
+	for( size_t index = 0; index < size * size; index++ )
+	{
+		for( size_t symmetry = 0; symmetry < symmetry_count; symmetry++ )
+		{
+			auto x = index % size;
+			auto y = index / size;
+			transform_point( x, y, size, symmetry );
+
+			transformed[index * symmetry_count + symmetry] =
+				static_cast<uint16_t>( y * size + x );
+		}
+	}
+
+	// Salt with the board size, equal patterns on different boards differ
+	for( auto& hash : hashes )
+	{
+		hash = splitmix64( ~static_cast<uint64_t>( size ) );
+	}
+}
+
+
+
+void go::PositionHasher::update( const vector<Stone>& changed_points )
+{
+	for( auto& point : changed_points )
+	{
+		auto index    = point.y * board_size + point.x;
+		auto old_side = sides[index];
+
+		if( old_side == point.side )
+		{
+			continue;
+		}
+
+		stone_count += (point.side != NONE) - (old_side != NONE);
+		sides[index] = point.side;
+
+		for( size_t symmetry = 0; symmetry < symmetry_count; symmetry++ )
+		{
+			auto target = transformed[index * symmetry_count + symmetry];
+			auto x      = target % board_size;
+			auto y      = target / board_size;
+
+			hashes[symmetry] ^= zobrist_key( x, y, old_side )
+			                  ^ zobrist_key( x, y, point.side );
+
+			hashes[symmetry_count + symmetry] ^=
+				zobrist_key( x, y, swap_colour( old_side ) ) ^
+				zobrist_key( x, y, swap_colour( point.side ) );
+		}
+	}
+}
+
+
+
+uint64_t go::PositionHasher::canonical_hash() const
+{
+	return *min_element( begin( hashes ), end( hashes ) );
+}
+
+
+
+bool go::PositionHasher::is_empty() const
+{
+	return stone_count == 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "goban.hh"
+
+#include <vector>
+#include <cstdint>
+
+
+namespace go
+{
+	// Rotations and reflections of a square board
+	// - Bit 0 transposes, bit 1 mirrors x and bit 2 mirrors y
+	// - Symmetry 0 is the identity
+	const size_t symmetry_count = 8;
+
+	// Maps a 0-based point through the given symmetry
+	void transform_point(
+		size_t& x,
+		size_t& y,
+		size_t  board_size,
+		size_t  symmetry
+	);
+
+
+
+	// Zobrist key of a stone, 0 for empty points
+	uint64_t zobrist_key( size_t x, size_t y, Side side );
+
+
+
+	// Keeps Zobrist hashes of a position under every symmetry, with and
+	// without swapping the colours, up to date from the changed points of
+	// each move. The smallest of them is the canonical hash, shared by all
+	// positions that only differ by orientation or colours.
+	class PositionHasher
+	{
+		size_t                board_size;
+		size_t                stone_count;
+		std::vector<Side>     sides;
+		std::vector<uint16_t> transformed; // [index * symmetry_count + symmetry]
+		uint64_t              hashes[2 * symmetry_count];
+
+
+	  public:
+		PositionHasher( size_t size = 19 );
+
+		void update( const std::vector<Stone>& changed_points );
+
+		uint64_t canonical_hash() const;
+
+		bool is_empty() const;
+	};
+}
@@ -0,0 +1,395 @@
+#include "text_cache.hh"
+#include "bitmap_font.hh"
+
+#include <mutex>
+#include <algorithm>
+#include <iostream>
+
+
+using namespace std;
+using namespace gui;
+
+
+const char *gui::default_font_path = "";
+
+
+// Sizes kept at most, the oldest atlas goes first
+const size_t max_cached_atlases = 8;
+
+// Strings laid out at most for one size before starting over
+const size_t max_cached_layouts = 4096;
+
+// SDL_ttf shares FreeType between the fonts, and every window
+// draws its text on a thread of its own
+mutex ttf_mutex;
+
+
+
+vector<uint32_t> gui::decode_utf8( const string& text )
+{
+	vector<uint32_t> code_points;
+
+	for( size_t i = 0; i < text.size(); )
+	{
+		auto lead = static_cast<unsigned char>( text[i] );
+
+		size_t   length     = 1;
+		uint32_t code_point = lead;
+		if( lead >= 0xf0 )      { length = 4; code_point = lead & 0x07; }
+		else if( lead >= 0xe0 ) { length = 3; code_point = lead & 0x0f; }
+		else if( lead >= 0xc0 ) { length = 2; code_point = lead & 0x1f; }
+		else if( lead >= 0x80 ) { length = 0; }
+
+		if( !length || i + length > text.size() )
+		{
+			code_points.push_back( '?' );
+			i++;
+			continue;
+		}
+
+		for( size_t j = 1; j < length; j++ )
+		{
+			code_point = (code_point << 6) | (static_cast<unsigned char>( text[i + j] ) & 0x3f);
+		}
+
+		code_points.push_back( code_point );
+		i += length;
+	}
+
+	return code_points;
+}
+
+
+
+TextCache::Atlas::~Atlas()
+{
+	lock_guard<mutex> lock{ ttf_mutex };
+	font.reset();
+}
+
+
+
+TextCache::TextCache( SDL_Renderer *target_renderer, const string& truetype_font_path )
+: renderer( target_renderer ),
+  font_path( truetype_font_path ),
+  use_bitmap_font( !TTF_WasInit() || truetype_font_path.empty() ),
+  batch( target_renderer ),
+  batch_atlas( nullptr ),
+  batch_color{ 255, 255, 255, 255 }
+{
+}
+
+
+
+bool TextCache::is_bitmap_font() const
+{
+	return use_bitmap_font;
+}
+
+
+
+TextCache::Atlas& TextCache::get_atlas( int size )
+{
+	for( auto& atlas : atlases )
+	{
+		if( atlas->size == size )
+		{
+			return *atlas;
+		}
+	}
+
+	if( atlases.size() >= max_cached_atlases )
+	{
+		flush();
+		batch_atlas = nullptr;
+		atlases.pop_front();
+	}
+
+	atlases.emplace_back( new Atlas );
+	auto& atlas = *atlases.back();
+	atlas.size  = size;
+
+	if( !use_bitmap_font )
+	{
+		lock_guard<mutex> lock{ ttf_mutex };
+		atlas.font = sdl2::FontPtr( TTF_OpenFont( font_path.c_str(), size ) );
+		if( atlas.font )
+		{
+			atlas.line_height = TTF_FontHeight( atlas.font.get() );
+		}
+		else
+		{
+			wcerr << "TextCache::get_atlas() - Couldn't open '" << font_path.c_str()
+			      << "', using the built-in font: " << TTF_GetError() << endl;
+			use_bitmap_font = true;
+		}
+	}
+
+	if( !atlas.font )
+	{
+		atlas.line_height = bitmap_glyph_height * max( 1, size / bitmap_glyph_height );
+	}
+
+	// Room for the printable ASCII glyphs several times over
+	atlas.texture_size = 256;
+	while( atlas.texture_size < size * 16 && atlas.texture_size < 2048 )
+	{
+		atlas.texture_size *= 2;
+	}
+
+	atlas.texture = sdl2::TexturePtr( SDL_CreateTexture(
+		renderer,
+		SDL_PIXELFORMAT_ARGB8888,
+		SDL_TEXTUREACCESS_STATIC,
+		atlas.texture_size,
+		atlas.texture_size
+	) );
+
+	if( atlas.texture )
+	{
+		vector<uint32_t> transparent( size_t( atlas.texture_size ) * atlas.texture_size, 0 );
+		SDL_UpdateTexture( atlas.texture.get(), nullptr, transparent.data(), atlas.texture_size * 4 );
+		SDL_SetTextureBlendMode( atlas.texture.get(), SDL_BLENDMODE_BLEND );
+	}
+	else
+	{
+		wcerr << "TextCache::get_atlas() - Couldn't create the glyph atlas: "
+		      << SDL_GetError() << endl;
+	}
+
+	return atlas;
+}
+
+
+
+sdl2::SurfacePtr TextCache::rasterize( Atlas& atlas, uint32_t code_point, int& advance )
+{
+	if( atlas.font )
+	{
+		lock_guard<mutex> lock{ ttf_mutex };
+
+		// SDL_ttf takes the basic multilingual plane only
+		auto glyph = static_cast<Uint16>( code_point <= 0xffff ? code_point : '?' );
+
+		int min_x, max_x, min_y, max_y;
+		if( TTF_GlyphMetrics( atlas.font.get(), glyph, &min_x, &max_x, &min_y, &max_y, &advance ) )
+		{
+			advance = 0;
+			return nullptr;
+		}
+
+		auto surface = sdl2::SurfacePtr( TTF_RenderGlyph_Blended(
+			atlas.font.get(), glyph, SDL_Color{ 255, 255, 255, 255 }
+		) );
+		if( !surface )
+		{
+			return nullptr;
+		}
+
+		return sdl2::SurfacePtr( SDL_ConvertSurfaceFormat( surface.get(), SDL_PIXELFORMAT_ARGB8888, 0 ) );
+	}
+
+	// Built-in font, every lit pixel a block of scale x scale
+	auto scale = max( 1, atlas.size / bitmap_glyph_height );
+	advance = bitmap_glyph_advance * scale;
+
+	auto surface = sdl2::SurfacePtr( SDL_CreateRGBSurfaceWithFormat(
+		0, bitmap_glyph_width * scale, bitmap_glyph_height * scale, 32, SDL_PIXELFORMAT_ARGB8888
+	) );
+	if( !surface )
+	{
+		return nullptr;
+	}
+
+	SDL_FillRect( surface.get(), nullptr, 0 );
+
+	auto rows = get_bitmap_glyph( code_point < 0x80 ? static_cast<char>( code_point ) : '?' );
+	for( int row = 0; row < bitmap_glyph_height; row++ )
+	{
+		for( int column = 0; column < bitmap_glyph_width; column++ )
+		{
+			if( rows[row] & (0x10 >> column) )
+			{
+				SDL_Rect block{ column * scale, row * scale, scale, scale };
+				SDL_FillRect( surface.get(), &block, 0xffffffff );
+			}
+		}
+	}
+
+	return surface;
+}
+
+
+
+const TextCache::Glyph& TextCache::get_glyph( Atlas& atlas, uint32_t code_point )
+{
+	auto found = atlas.glyphs.find( code_point );
+	if( found != atlas.glyphs.end() )
+	{
+		return found->second;
+	}
+
+	Glyph glyph{ { 0, 0, 0, 0 }, 0 };
+	auto surface = rasterize( atlas, code_point, glyph.advance );
+
+	if( surface && atlas.texture )
+	{
+		const int padding = 1;
+		auto width  = surface->w;
+		auto height = surface->h;
+
+		// Shelf packing, a new shelf when the row is full
+		if( atlas.pen_x + width + padding > atlas.texture_size )
+		{
+			atlas.pen_x        = 0;
+			atlas.pen_y       += atlas.shelf_height + padding;
+			atlas.shelf_height = 0;
+		}
+
+		// Full, start over. What's queued still refers to the old
+		// glyphs, so it goes first.
+		if( atlas.pen_y + height > atlas.texture_size )
+		{
+			if( batch_atlas == &atlas )
+			{
+				flush();
+			}
+
+			atlas.glyphs.clear();
+			atlas.layouts.clear();
+			atlas.pen_x        = 0;
+			atlas.pen_y        = 0;
+			atlas.shelf_height = 0;
+			atlas.generation++;
+		}
+
+		if( width <= atlas.texture_size && height <= atlas.texture_size )
+		{
+			glyph.source = { atlas.pen_x, atlas.pen_y, width, height };
+			SDL_UpdateTexture( atlas.texture.get(), &glyph.source, surface->pixels, surface->pitch );
+
+			atlas.pen_x       += width + padding;
+			atlas.shelf_height = max( atlas.shelf_height, height );
+		}
+	}
+
+	return atlas.glyphs.emplace( code_point, glyph ).first->second;
+}
+
+
+
+const TextCache::Layout& TextCache::get_layout( Atlas& atlas, const string& text )
+{
+	auto found = atlas.layouts.find( text );
+	if( found != atlas.layouts.end() )
+	{
+		return found->second;
+	}
+
+	if( atlas.layouts.size() >= max_cached_layouts )
+	{
+		atlas.layouts.clear();
+	}
+
+	auto code_points = decode_utf8( text );
+
+	// The atlas may fill up and start over half way through,
+	// then the glyphs taken before are gone
+	Layout layout;
+	for( int attempt = 0; attempt < 2; attempt++ )
+	{
+		auto generation = atlas.generation;
+
+		layout = Layout{};
+		layout.height = atlas.line_height;
+		for( auto code_point : code_points )
+		{
+			auto& glyph = get_glyph( atlas, code_point );
+			if( glyph.source.w && glyph.source.h )
+			{
+				layout.sources.push_back( glyph.source );
+				layout.targets.push_back( { layout.width, 0, glyph.source.w, glyph.source.h } );
+			}
+
+			layout.width += glyph.advance;
+		}
+
+		if( generation == atlas.generation )
+		{
+			break;
+		}
+	}
+
+	return atlas.layouts.emplace( text, move( layout ) ).first->second;
+}
+
+
+
+SDL_Point TextCache::measure( const string& text, int size )
+{
+	auto& layout = get_layout( get_atlas( size ), text );
+	return { layout.width, layout.height };
+}
+
+
+
+void TextCache::draw(
+	const string& text,
+	int           size,
+	int           x,
+	int           y,
+	SDL_Color     color,
+	TextAlign     align
+)
+{
+	auto& atlas  = get_atlas( size );
+	auto& layout = get_layout( atlas, text );
+	if( !atlas.texture || layout.sources.empty() )
+	{
+		return;
+	}
+
+	// The colour mod applies to the whole batch
+	if( batch_atlas != &atlas ||
+	    batch_color.r != color.r || batch_color.g != color.g ||
+	    batch_color.b != color.b || batch_color.a != color.a )
+	{
+		batch.flush();
+		SDL_SetTextureColorMod( atlas.texture.get(), color.r, color.g, color.b );
+		SDL_SetTextureAlphaMod( atlas.texture.get(), color.a );
+		batch.begin( atlas.texture.get() );
+
+		batch_atlas = &atlas;
+		batch_color = color;
+	}
+
+	if( align == ALIGN_CENTER )
+	{
+		x -= layout.width / 2;
+		y -= layout.height / 2;
+	}
+
+	for( size_t i = 0; i < layout.sources.size(); i++ )
+	{
+		auto target = layout.targets[i];
+		target.x += x;
+		target.y += y;
+		batch.add( layout.sources[i], target );
+	}
+}
+
+
+
+void TextCache::flush()
+{
+	batch.flush();
+}
+
+
+
+void TextCache::clear()
+{
+	flush();
+	batch_atlas = nullptr;
+	atlases.clear();
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "sdl2.hh"
+#include "sprite_batch.hh"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+
+namespace gui
+{
+	// No font ships with the viewer, so the text is drawn with the
+	// built-in bitmap font unless a TrueType font is given with
+	// --font <file.ttf>. A font that can't be opened falls back too.
+	extern const char *default_font_path;
+
+
+	enum TextAlign
+	{
+		ALIGN_CENTER, // The position is the center of the text
+		ALIGN_LEFT    // The position is the top left corner
+	};
+
+
+
+	// Text drawn from glyph atlases
+	// - The glyphs of each font size are rasterized once into an atlas
+	//   texture, as they're first needed. They come from the TrueType
+	//   font if SDL_ttf was initialized and the font opens, from the
+	//   built-in bitmap font otherwise.
+	// - Laid out strings are cached too, so drawing a string again is
+	//   only copies from the atlas
+	// - Everything drawn is batched until flush(), the batch only
+	//   breaks where the size or the colour changes
+	// Glyphs are white in the atlas and coloured with the texture
+	// colour mod. A TextCache belongs to one renderer and one thread.
+	class TextCache
+	{
+		struct Glyph
+		{
+			SDL_Rect source;
+			int      advance;
+		};
+
+		struct Layout
+		{
+			std::vector<SDL_Rect> sources;
+			std::vector<SDL_Rect> targets; // From the top left corner
+			int                   width  = 0;
+			int                   height = 0;
+		};
+
+		struct Atlas
+		{
+			int                                 size         = 0;
+			sdl2::FontPtr                       font;
+			sdl2::TexturePtr                    texture;
+			int                                 texture_size = 0;
+			int                                 line_height  = 0;
+			int                                 pen_x        = 0;
+			int                                 pen_y        = 0;
+			int                                 shelf_height = 0;
+			uint64_t                            generation   = 0;
+			std::unordered_map<uint32_t, Glyph> glyphs;
+			std::unordered_map<std::string, Layout> layouts;
+
+			~Atlas();
+		};
+
+		SDL_Renderer                       *renderer;
+		std::string                         font_path;
+		bool                                use_bitmap_font;
+		std::deque<std::unique_ptr<Atlas>>  atlases;
+
+		SpriteBatch                         batch;
+		Atlas                              *batch_atlas;
+		SDL_Color                           batch_color;
+
+
+	  public:
+		TextCache( SDL_Renderer *target_renderer, const std::string& truetype_font_path );
+
+		// Queues UTF-8 text of the given pixel size
+		void draw(
+			const std::string& text,
+			int                size,
+			int                x,
+			int                y,
+			SDL_Color          color,
+			TextAlign          align = ALIGN_CENTER
+		);
+
+		// Width and height the text takes up
+		SDL_Point measure( const std::string& text, int size );
+
+		// Draws everything queued
+		void flush();
+
+		// Drops the atlases, eg. when textures were lost
+		void clear();
+
+		// Not using the TrueType font
+		bool is_bitmap_font() const;
+
+
+	  private:
+		Atlas&        get_atlas( int size );
+		const Layout& get_layout( Atlas& atlas, const std::string& text );
+		const Glyph&  get_glyph( Atlas& atlas, uint32_t code_point );
+		sdl2::SurfacePtr rasterize( Atlas& atlas, uint32_t code_point, int& advance );
+	};
+
+
+	// Code points of UTF-8 text, broken sequences become '?'
+	std::vector<uint32_t> decode_utf8( const std::string& text );
+}
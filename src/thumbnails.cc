@@ -0,0 +1,227 @@
+#include "thumbnails.hh"
+#include "corpus.hh"
+#include "common_tools.hh"
+#include "board_snapshot.hh"
+#include "offscreen_renderer.hh"
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+
+using namespace std;
+
+
+
+string corpus::thumbnail_path(
+	const string& root_directory,
+	const string& output_directory,
+	const string& game_path,
+	size_t        move_number
+)
+{
+	auto relative = game_path;
+	if( !relative.compare( 0, root_directory.size(), root_directory ) )
+	{
+		relative = relative.substr( root_directory.size() );
+	}
+
+	while( relative.size() && (relative[0] == '/' || relative[0] == '\\') )
+	{
+		relative = relative.substr( 1 );
+	}
+
+	auto extension = relative.rfind( '.' );
+	if( extension != string::npos && relative.find_first_of( "/\\", extension ) == string::npos )
+	{
+		relative = relative.substr( 0, extension );
+	}
+
+	if( move_number )
+	{
+		char suffix[32];
+		snprintf( suffix, sizeof( suffix ), "_m%03u", static_cast<unsigned>( move_number ) );
+		relative += suffix;
+	}
+
+	return output_directory + "/" + relative + ".png";
+}
+
+
+
+string parent_directory( const string& path )
+{
+	auto separator = path.find_last_of( "/\\" );
+	if( separator == string::npos )
+	{
+		return ".";
+	}
+
+	return path.substr( 0, separator );
+}
+
+
+
+void corpus::make_thumbnails(
+	const string&           root_directory,
+	const string&           output_directory,
+	const ThumbnailOptions& options
+)
+{
+	auto files = find_game_files( root_directory );
+
+	auto wood = sdl2::SurfacePtr( IMG_Load( options.wood_image.c_str() ) );
+	if( !wood )
+	{
+		throw runtime_error( "Couldn't load '" + options.wood_image + "': " + IMG_GetError() );
+	}
+
+	// A renderer for every worker thread, made on first use
+	vector<unique_ptr<gui::OffscreenRenderer>> renderers( tools::worker_thread_count() );
+	mutex renderer_mutex;
+
+	atomic<size_t> rendered_count{ 0 };
+	atomic<size_t> up_to_date_count{ 0 };
+	atomic<size_t> failed_count{ 0 };
+
+	tools::parallel_for( files.size(), [&]( size_t index, size_t thread_index )
+	{
+		auto& path   = files[index];
+		auto  output = thumbnail_path( root_directory, output_directory, path );
+
+		try
+		{
+			// The final thumbnail is written last, so it being newer
+			// than the game means the whole game is done
+			try
+			{
+				if( tools::get_file_info( output ).modified >= tools::get_file_info( path ).modified )
+				{
+					up_to_date_count++;
+					return;
+				}
+			}
+			catch( exception& )
+			{
+				// No thumbnail yet
+			}
+
+			auto& renderer = renderers[thread_index];
+			if( !renderer )
+			{
+				lock_guard<mutex> lock{ renderer_mutex };
+				renderer.reset( new gui::OffscreenRenderer( options.size, options.size, wood.get() ) );
+			}
+
+			auto line = read_main_line_file( path );
+
+			tools::create_directories( parent_directory( output ) );
+
+			go::BoardSnapshot board;
+			replay_main_line( line, [&]( go::Goban& goban, size_t move_number, const vector<go::Stone>& )
+			{
+				auto is_final = move_number == line.moves.size();
+				auto is_asked = move_number &&
+					find( options.moves.begin(), options.moves.end(), move_number ) != options.moves.end();
+
+				if( !is_final && !is_asked )
+				{
+					return;
+				}
+
+				board = go::BoardSnapshot{ goban };
+				if( is_asked )
+				{
+					renderer->render( board );
+					renderer->save_png( thumbnail_path( root_directory, output_directory, path, move_number ) );
+				}
+			} );
+
+			// The final position goes last, see above
+			renderer->render( board );
+			renderer->save_png( output );
+			rendered_count++;
+		}
+		catch( exception& e )
+		{
+			wcerr << "Skipping " << path.c_str() << ": " << e.what() << endl;
+			failed_count++;
+		}
+	} );
+
+	wcout << "Rendered " << rendered_count << " thumbnails, "
+	      << up_to_date_count << " were up to date, "
+	      << failed_count << " games failed" << endl;
+}
+
+
+
+int corpus::thumbnails_command( const vector<string>& args )
+{
+	auto usage = []()
+	{
+		wcout << "Usage: --thumbnails <directory> <output directory>"
+		      << " [--size N] [--moves N,N,...] [--wood <image>]" << endl;
+		return 1;
+	};
+
+	if( args.size() < 2 )
+	{
+		return usage();
+	}
+
+	ThumbnailOptions options;
+	for( size_t i = 2; i < args.size(); i += 2 )
+	{
+		if( i + 1 >= args.size() )
+		{
+			return usage();
+		}
+
+		if( args[i] == "--size" )
+		{
+			options.size = stoi( args[i + 1] );
+		}
+		else if( args[i] == "--moves" )
+		{
+			stringstream moves( args[i + 1] );
+			string move;
+			while( getline( moves, move, ',' ) )
+			{
+				options.moves.push_back( stoul( move ) );
+			}
+		}
+		else if( args[i] == "--wood" )
+		{
+			options.wood_image = args[i + 1];
+		}
+		else
+		{
+			return usage();
+		}
+	}
+
+	// No window is ever opened, the dummy driver will do
+	SDL_SetHint( SDL_HINT_VIDEODRIVER, "dummy" );
+	if( SDL_Init( SDL_INIT_VIDEO ) )
+	{
+		wcerr << "SDL_Init() failed: " << SDL_GetError() << endl;
+		return 1;
+	}
+
+	auto defer_sdl_quit = tools::make_defer( [](){
+		SDL_Quit();
+	} );
+
+	auto start = chrono::steady_clock::now();
+	make_thumbnails( args[0], args[1], options );
+
+	auto elapsed = chrono::duration<double>( chrono::steady_clock::now() - start );
+	wcout << "Done in " << elapsed.count() << " s" << endl;
+
+	return 0;
+}
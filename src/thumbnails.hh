@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+// Thumbnails of the games for browsing the collection elsewhere
+// - The directory tree of the games is mirrored under the output
+//   directory, a/b.sgf gets a/b.png of the final position and
+//   a/b_m050.png after move 50 if that move was asked for
+// - Games whose thumbnail is newer than the file are skipped, so
+//   running it again only renders what changed
+// - Rendering uses the software renderer and no window, the games are
+//   spread over every core
+namespace corpus
+{
+	struct ThumbnailOptions
+	{
+		int                 size = 256;  // Width and height in pixels
+		std::vector<size_t> moves;       // Also after these moves
+		std::string         wood_image = "data/wood.jpg";
+	};
+
+	std::string thumbnail_path(
+		const std::string& root_directory,
+		const std::string& output_directory,
+		const std::string& game_path,
+		size_t             move_number = 0  // 0 for the final position
+	);
+
+	void make_thumbnails(
+		const std::string&      root_directory,
+		const std::string&      output_directory,
+		const ThumbnailOptions& options
+	);
+
+	int thumbnails_command( const std::vector<std::string>& args );
+}
@@ -0,0 +1,330 @@
+#include "training_export.hh"
+#include "corpus.hh"
+#include "common_tools.hh"
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <exception>
+
+
+using namespace std;
+using namespace corpus;
+
+
+
+void corpus::encode_features(
+	go::Goban&                goban,
+	go::Side                  to_move,
+	const vector<sgf::Point>& history,
+	uint8_t                  *planes
+)
+{
+	auto  size       = goban.get_board_size();
+	auto  plane_size = size * size;
+	auto& board      = goban.get_board();
+	auto  liberties  = goban.get_liberty_counts();
+
+	fill( planes, planes + FEATURE_PLANE_COUNT * plane_size, uint8_t( 0 ) );
+
+	auto plane = [&]( size_t index ) { return planes + index * plane_size; };
+
+	for( size_t i = 0; i < plane_size; i++ )
+	{
+		auto side = board[i].side;
+
+		if( side == go::Side::NONE )
+		{
+			plane( PLANE_EMPTY )[i] = 1;
+		}
+		else
+		{
+			plane( side == to_move ? PLANE_OWN_STONES : PLANE_OPPONENT_STONES )[i] = 1;
+			plane( PLANE_LIBERTIES_1 + min<size_t>( liberties[i], 4 ) - 1 )[i] = 1;
+		}
+
+		plane( PLANE_BLACK_TO_MOVE )[i] = (to_move == go::Side::BLACK);
+		plane( PLANE_ONES )[i]          = 1;
+	}
+
+	for( size_t age = 0; age < 8 && age < history.size(); age++ )
+	{
+		auto& point = history[history.size() - 1 - age];
+		if( point.x == 0 && point.y == 0 )
+		{
+			continue;
+		}
+
+		plane( PLANE_HISTORY + age )[(point.y - 1) * size + point.x - 1] = 1;
+	}
+}
+
+
+
+// Fisher-Yates with a fixed engine, std::shuffle and the standard
+// distributions differ between library implementations
+template<typename T>
+void deterministic_shuffle( vector<T>& items, uint64_t seed )
+{
+	mt19937_64 engine{ seed };
+	for( auto i = items.size(); i > 1; i-- )
+	{
+		swap( items[i - 1], items[engine() % i] );
+	}
+}
+
+
+
+void write_npy(
+	const string&         path,
+	const string&         type,
+	const vector<size_t>& shape,
+	const void           *data,
+	size_t                data_size
+)
+{
+	stringstream header;
+	header << "{'descr': '" << type << "', 'fortran_order': False, 'shape': (";
+	for( auto dimension : shape )
+	{
+		header << dimension << ", ";
+	}
+	header << "), }";
+
+	// Magic, version, header length and the header padded so that the
+	// data starts at a multiple of 64 bytes
+	auto text = header.str();
+	text.append( 63 - (10 + text.size()) % 64, ' ' );
+	text += '\n';
+
+	ofstream out( path, ios_base::out | ios_base::binary | ios_base::trunc );
+	out.write( "\x93NUMPY\x01\x00", 8 );
+
+	uint8_t header_length[2] = {
+		static_cast<uint8_t>( text.size() & 0xff ),
+		static_cast<uint8_t>( text.size() >> 8 )
+	};
+	out.write( reinterpret_cast<const char*>( header_length ), 2 );
+	out.write( text.data(), text.size() );
+	out.write( static_cast<const char*>( data ), data_size );
+
+	if( !out )
+	{
+		throw runtime_error( "Couldn't write '" + path + "'" );
+	}
+}
+
+
+
+struct Shard
+{
+	vector<uint8_t> features;
+	vector<int16_t> moves;
+	vector<int8_t>  results;
+};
+
+
+
+void add_game_samples( Shard& shard, const sgf::MainLine& line )
+{
+	auto size       = line.board_size;
+	auto plane_size = FEATURE_PLANE_COUNT * size * size;
+
+	char winner = 0;
+	if( line.result.size() >= 2 && line.result[1] == '+' )
+	{
+		winner = line.result[0];
+	}
+
+	vector<sgf::Point> history;
+
+	replay_main_line( line, [&]( go::Goban& goban, size_t move_number, const vector<go::Stone>& )
+	{
+		if( move_number >= line.moves.size() )
+		{
+			return;
+		}
+
+		auto& next    = line.moves[move_number];
+		auto  to_move = next.black ? go::Side::BLACK : go::Side::WHITE;
+
+		shard.features.resize( shard.features.size() + plane_size );
+		encode_features( goban, to_move, history, &shard.features[shard.features.size() - plane_size] );
+
+		auto is_pass = next.point.x == 0 && next.point.y == 0;
+		shard.moves.push_back( static_cast<int16_t>(
+			is_pass ? size * size : (next.point.y - 1) * size + next.point.x - 1
+		) );
+
+		int8_t result = 0;
+		if( winner == 'B' || winner == 'W' )
+		{
+			result = ((winner == 'B') == next.black) ? 1 : -1;
+		}
+		shard.results.push_back( result );
+
+		history.push_back( next.point );
+	} );
+}
+
+
+
+void corpus::export_training_data(
+	const string&        root_directory,
+	const string&        output_directory,
+	const ExportOptions& options
+)
+{
+	auto files = find_game_files( root_directory );
+	sort( files.begin(), files.end() );
+	deterministic_shuffle( files, options.seed );
+
+	auto games_per_shard = max<size_t>( options.games_per_shard, 1 );
+	auto shard_count     = (files.size() + games_per_shard - 1) / games_per_shard;
+	auto size            = options.board_size;
+	auto plane_size      = FEATURE_PLANE_COUNT * size * size;
+
+	atomic<size_t> sample_count{ 0 };
+	atomic<size_t> skipped_count{ 0 };
+	atomic<size_t> failed_shards{ 0 };
+
+	tools::create_directories( output_directory );
+
+	tools::parallel_for( shard_count, [&]( size_t shard_index, size_t )
+	{
+		Shard shard;
+
+		auto first = shard_index * games_per_shard;
+		auto last  = min( first + games_per_shard, files.size() );
+		for( auto i = first; i < last; i++ )
+		{
+			auto features_size = shard.features.size();
+			try
+			{
+				auto line = read_main_line_file( files[i] );
+				if( line.board_size != size )
+				{
+					skipped_count++;
+					continue;
+				}
+
+				add_game_samples( shard, line );
+			}
+			catch( exception& )
+			{
+				// Drop whatever the broken game got to add
+				auto samples = features_size / plane_size;
+				shard.features.resize( features_size );
+				shard.moves.resize( samples );
+				shard.results.resize( samples );
+				skipped_count++;
+			}
+		}
+
+		// Shuffle the samples, seeded by the shard
+		auto samples = shard.moves.size();
+		vector<size_t> order( samples );
+		for( size_t i = 0; i < samples; i++ )
+		{
+			order[i] = i;
+		}
+		deterministic_shuffle( order, options.seed ^ ((shard_index + 1) * 0x9e3779b97f4a7c15ULL) );
+
+		Shard shuffled;
+		shuffled.features.resize( shard.features.size() );
+		for( size_t i = 0; i < samples; i++ )
+		{
+			copy_n( &shard.features[order[i] * plane_size], plane_size, &shuffled.features[i * plane_size] );
+			shuffled.moves.push_back( shard.moves[order[i]] );
+			shuffled.results.push_back( shard.results[order[i]] );
+		}
+		shard = {};
+
+		char name[32];
+		snprintf( name, sizeof( name ), "/shard_%05u_", static_cast<unsigned>( shard_index ) );
+		auto prefix = output_directory + name;
+
+		try
+		{
+			write_npy( prefix + "features.npy", "|u1", { samples, FEATURE_PLANE_COUNT, size, size },
+			           shuffled.features.data(), shuffled.features.size() );
+			write_npy( prefix + "moves.npy", "<i2", { samples },
+			           shuffled.moves.data(), shuffled.moves.size() * sizeof( int16_t ) );
+			write_npy( prefix + "results.npy", "|i1", { samples },
+			           shuffled.results.data(), shuffled.results.size() );
+		}
+		catch( exception& e )
+		{
+			wcerr << e.what() << endl;
+			failed_shards++;
+			return;
+		}
+
+		sample_count += samples;
+	} );
+
+	if( failed_shards )
+	{
+		throw runtime_error( "Couldn't write all of the shards" );
+	}
+
+	wcout << "Exported " << sample_count << " samples from "
+	      << files.size() - skipped_count << " games into "
+	      << shard_count << " shards, " << skipped_count << " games skipped" << endl;
+}
+
+
+
+int corpus::export_training_data_command( const vector<string>& args )
+{
+	auto usage = []()
+	{
+		wcout << "Usage: --export-training-data <directory> <output directory>"
+		      << " [--board-size N] [--games-per-shard N] [--seed N]" << endl;
+		return 1;
+	};
+
+	if( args.size() < 2 )
+	{
+		return usage();
+	}
+
+	ExportOptions options;
+	for( size_t i = 2; i < args.size(); i += 2 )
+	{
+		if( i + 1 >= args.size() )
+		{
+			return usage();
+		}
+
+		if( args[i] == "--board-size" )
+		{
+			options.board_size = stoul( args[i + 1] );
+		}
+		else if( args[i] == "--games-per-shard" )
+		{
+			options.games_per_shard = stoul( args[i + 1] );
+		}
+		else if( args[i] == "--seed" )
+		{
+			options.seed = stoull( args[i + 1] );
+		}
+		else
+		{
+			return usage();
+		}
+	}
+
+	auto start = chrono::steady_clock::now();
+	export_training_data( args[0], args[1], options );
+
+	auto elapsed = chrono::duration<double>( chrono::steady_clock::now() - start );
+	wcout << "Done in " << elapsed.count() << " s" << endl;
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "sgf.hh"
+#include "goban.hh"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Exporting replayed positions as training data
+// - Every position before a move of the main line becomes a sample of
+//   feature planes, the move played next and the result of the game
+// - Samples are written to NPY shards, three files per shard:
+//     shard_NNNNN_features.npy  uint8 [samples, planes, size, size]
+//     shard_NNNNN_moves.npy     int16 [samples], y * size + x, size * size for a pass
+//     shard_NNNNN_results.npy   int8  [samples], 1 if the side to move won,
+//                                                -1 if it lost, 0 if unknown
+// - The games are shuffled with the seed and dealt out to the shards,
+//   the samples of a shard are shuffled too. The output only depends
+//   on the seed and the files, not on the thread count.
+namespace corpus
+{
+	// Feature planes, from the point of view of the side to move
+	enum FeaturePlane
+	{
+		PLANE_OWN_STONES,
+		PLANE_OPPONENT_STONES,
+		PLANE_EMPTY,
+		PLANE_LIBERTIES_1,
+		PLANE_LIBERTIES_2,
+		PLANE_LIBERTIES_3,
+		PLANE_LIBERTIES_4_OR_MORE,
+		PLANE_HISTORY,                        // The last move, then the one before it...
+		PLANE_BLACK_TO_MOVE = PLANE_HISTORY + 8,
+		PLANE_ONES,
+		FEATURE_PLANE_COUNT
+	};
+
+	struct ExportOptions
+	{
+		size_t   board_size      = 19; // Games on other boards are skipped
+		size_t   games_per_shard = 64; // Bounds the memory use, a shard per thread is kept in memory
+		uint64_t seed            = 0;
+	};
+
+
+	// Writes the planes of the position, FEATURE_PLANE_COUNT * size * size
+	// bytes, history holds the moves played so far
+	void encode_features(
+		go::Goban&                     goban,
+		go::Side                       to_move,
+		const std::vector<sgf::Point>& history,
+		uint8_t                       *planes
+	);
+
+	void export_training_data(
+		const std::string&   root_directory,
+		const std::string&   output_directory,
+		const ExportOptions& options
+	);
+
+
+	// Command line entry point
+	int export_training_data_command( const std::vector<std::string>& args );
+}
@@ -0,0 +1,436 @@
+#include "video_export.hh"
+#include "corpus.hh"
+#include "common_tools.hh"
+#include "board_snapshot.hh"
+#include "offscreen_renderer.hh"
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <exception>
+#include <condition_variable>
+
+
+using namespace std;
+
+
+
+namespace
+{
+	struct Frame
+	{
+		vector<uint32_t> pixels;
+		size_t           repeat = 0;
+	};
+
+
+	// Frames from the render thread to the encoder
+	// - At most capacity frames are in flight, the renderer waits
+	//   for the encoder when it runs ahead
+	// - Spent frames come back to be reused, so the pixel buffers are
+	//   allocated once
+	class FramePipe
+	{
+		mutex              pipe_mutex;
+		condition_variable frame_available;
+		condition_variable space_available;
+		deque<Frame>       frames;
+		vector<Frame>      spare_frames;
+		size_t             capacity;
+		size_t             in_flight = 0;
+		bool               closed    = false;
+
+
+	  public:
+		explicit FramePipe( size_t capacity ) : capacity( capacity )
+		{
+		}
+
+
+
+		// A frame to fill, waits while too many are in flight.
+		// Returns false once the pipe was closed.
+		bool acquire( Frame& frame )
+		{
+			unique_lock<mutex> lock{ pipe_mutex };
+			space_available.wait( lock, [&](){ return closed || in_flight < capacity; } );
+			if( closed )
+			{
+				return false;
+			}
+
+			in_flight++;
+			if( spare_frames.size() )
+			{
+				frame = move( spare_frames.back() );
+				spare_frames.pop_back();
+			}
+
+			return true;
+		}
+
+
+
+		void push( Frame&& frame )
+		{
+			lock_guard<mutex> lock{ pipe_mutex };
+			frames.push_back( move( frame ) );
+			frame_available.notify_one();
+		}
+
+
+
+		// Waits for a frame, returns false once the pipe
+		// is closed and empty
+		bool pop( Frame& frame )
+		{
+			unique_lock<mutex> lock{ pipe_mutex };
+			frame_available.wait( lock, [&](){ return closed || frames.size(); } );
+			if( frames.empty() )
+			{
+				return false;
+			}
+
+			frame = move( frames.front() );
+			frames.pop_front();
+			return true;
+		}
+
+
+
+		void recycle( Frame&& frame )
+		{
+			lock_guard<mutex> lock{ pipe_mutex };
+			spare_frames.push_back( move( frame ) );
+			in_flight--;
+			space_available.notify_one();
+		}
+
+
+
+		// Frames already pushed are still popped
+		void close()
+		{
+			lock_guard<mutex> lock{ pipe_mutex };
+			closed = true;
+			frame_available.notify_all();
+			space_available.notify_all();
+		}
+	};
+
+
+
+	void encode_frames( FramePipe& pipe, ofstream& out, int width, int height )
+	{
+		vector<uint32_t> previous;
+		vector<uint8_t>  yuv;
+		Frame            frame;
+
+		while( pipe.pop( frame ) )
+		{
+			corpus::argb_to_yuv420( frame.pixels, previous, width, height, yuv );
+
+			for( size_t i = 0; i < frame.repeat; i++ )
+			{
+				out << "FRAME\n";
+				out.write( reinterpret_cast<const char*>( yuv.data() ), yuv.size() );
+			}
+
+			if( !out )
+			{
+				throw runtime_error( "Couldn't write the video" );
+			}
+
+			// Keep the pixels to diff against, hand back the old ones
+			swap( previous, frame.pixels );
+			pipe.recycle( move( frame ) );
+		}
+	}
+
+
+
+	void copy_pixels( SDL_Surface *surface, vector<uint32_t>& pixels )
+	{
+		pixels.resize( size_t( surface->w ) * surface->h );
+
+		if( SDL_MUSTLOCK( surface ) )
+		{
+			SDL_LockSurface( surface );
+		}
+
+		auto row_bytes = size_t( surface->w ) * sizeof( uint32_t );
+		for( int y = 0; y < surface->h; y++ )
+		{
+			memcpy(
+				&pixels[size_t( y ) * surface->w],
+				static_cast<const uint8_t*>( surface->pixels ) + size_t( y ) * surface->pitch,
+				row_bytes
+			);
+		}
+
+		if( SDL_MUSTLOCK( surface ) )
+		{
+			SDL_UnlockSurface( surface );
+		}
+	}
+}
+
+
+
+void corpus::argb_to_yuv420(
+	const vector<uint32_t>& pixels,
+	const vector<uint32_t>& previous,
+	int                     width,
+	int                     height,
+	vector<uint8_t>&        yuv
+)
+{
+	auto luma_size   = size_t( width ) * height;
+	auto chroma_size = luma_size / 4;
+	if( yuv.size() != luma_size + 2 * chroma_size )
+	{
+		yuv.assign( luma_size + 2 * chroma_size, 0 );
+	}
+
+	auto luma  = yuv.data();
+	auto u     = luma + luma_size;
+	auto v     = u + chroma_size;
+	auto check = previous.size() == pixels.size();
+
+	auto to_luma = []( int r, int g, int b )
+	{
+		return uint8_t( ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16 );
+	};
+
+	for( int y = 0; y < height; y += 2 )
+	{
+		auto row = size_t( y ) * width;
+		if( check && !memcmp( &pixels[row], &previous[row], 2 * width * sizeof( uint32_t ) ) )
+		{
+			continue;
+		}
+
+		for( int x = 0; x < width; x += 2 )
+		{
+			int r_sum = 0, g_sum = 0, b_sum = 0;
+
+			for( auto index : { row + x, row + x + 1, row + width + x, row + width + x + 1 } )
+			{
+				int r = (pixels[index] >> 16) & 0xff;
+				int g = (pixels[index] >> 8) & 0xff;
+				int b = pixels[index] & 0xff;
+
+				luma[index] = to_luma( r, g, b );
+				r_sum += r;
+				g_sum += g;
+				b_sum += b;
+			}
+
+			// Chroma of the 2x2 average
+			int r = (r_sum + 2) / 4;
+			int g = (g_sum + 2) / 4;
+			int b = (b_sum + 2) / 4;
+
+			auto chroma = size_t( y / 2 ) * (width / 2) + x / 2;
+			u[chroma] = uint8_t( ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128 );
+			v[chroma] = uint8_t( ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128 );
+		}
+	}
+}
+
+
+
+void corpus::export_video(
+	const string&       game_path,
+	const string&       output_path,
+	const VideoOptions& options
+)
+{
+	if( options.width <= 0 || options.height <= 0 || options.width % 2 || options.height % 2 )
+	{
+		throw runtime_error( "The video size must be even" );
+	}
+
+	if( options.fps <= 0 || options.frames_per_move <= 0 )
+	{
+		throw runtime_error( "The frame rate and frames per move must be positive" );
+	}
+
+	auto line = read_main_line_file( game_path );
+
+	auto wood = sdl2::SurfacePtr( IMG_Load( options.wood_image.c_str() ) );
+	if( !wood )
+	{
+		throw runtime_error( "Couldn't load '" + options.wood_image + "': " + IMG_GetError() );
+	}
+
+	gui::OffscreenRenderer renderer{ options.width, options.height, wood.get() };
+
+	ofstream out( output_path, ios_base::out | ios_base::binary | ios_base::trunc );
+	if( !out )
+	{
+		throw runtime_error( "Couldn't open '" + output_path + "'" );
+	}
+
+	// C420jpeg: chroma sited between the four pixels it was averaged from
+	out << "YUV4MPEG2 W" << options.width << " H" << options.height
+	    << " F" << options.fps << ":1 Ip A1:1 C420jpeg\n";
+
+	FramePipe pipe{ 4 };
+	exception_ptr encoder_error;
+
+	thread encoder( [&]()
+	{
+		try
+		{
+			encode_frames( pipe, out, options.width, options.height );
+		}
+		catch( ... )
+		{
+			encoder_error = current_exception();
+			pipe.close();
+		}
+	} );
+
+	// Also when rendering throws
+	auto defer_join = tools::make_defer( [&](){
+		pipe.close();
+		if( encoder.joinable() )
+		{
+			encoder.join();
+		}
+	} );
+
+	// A position is only sent once the next one differs, passes and
+	// the final hold just add to its frames
+	Frame    pending;
+	bool     has_pending   = false;
+	uint64_t last_revision = 0;
+	size_t   frame_count   = 0;
+
+	auto send_pending = [&]()
+	{
+		if( has_pending )
+		{
+			frame_count += pending.repeat;
+			pipe.push( move( pending ) );
+			has_pending = false;
+		}
+	};
+
+	go::BoardSnapshot board;
+	replay_main_line( line, [&]( go::Goban& goban, size_t, const vector<go::Stone>& )
+	{
+		board = go::BoardSnapshot{ goban };
+
+		if( has_pending && board.revision == last_revision )
+		{
+			pending.repeat += options.frames_per_move;
+			return;
+		}
+
+		send_pending();
+
+		if( !pipe.acquire( pending ) )
+		{
+			return;
+		}
+
+		renderer.render( board );
+		copy_pixels( renderer.get_surface(), pending.pixels );
+		pending.repeat = options.frames_per_move;
+		has_pending    = true;
+		last_revision  = board.revision;
+	} );
+
+	if( has_pending )
+	{
+		pending.repeat += 2 * options.fps;
+	}
+
+	send_pending();
+
+	pipe.close();
+	encoder.join();
+
+	if( encoder_error )
+	{
+		rethrow_exception( encoder_error );
+	}
+
+	wcout << "Wrote " << frame_count << " frames of " << line.moves.size() << " moves" << endl;
+}
+
+
+
+int corpus::export_video_command( const vector<string>& args )
+{
+	auto usage = []()
+	{
+		wcout << "Usage: --export-video <game.sgf> <output.y4m>"
+		      << " [--size WxH] [--fps N] [--frames-per-move N] [--wood <image>]" << endl;
+		return 1;
+	};
+
+	if( args.size() < 2 )
+	{
+		return usage();
+	}
+
+	VideoOptions options;
+	for( size_t i = 2; i < args.size(); i += 2 )
+	{
+		if( i + 1 >= args.size() )
+		{
+			return usage();
+		}
+
+		if( args[i] == "--size" )
+		{
+			if( sscanf( args[i + 1].c_str(), "%dx%d", &options.width, &options.height ) != 2 )
+			{
+				return usage();
+			}
+		}
+		else if( args[i] == "--fps" )
+		{
+			options.fps = stoi( args[i + 1] );
+		}
+		else if( args[i] == "--frames-per-move" )
+		{
+			options.frames_per_move = stoi( args[i + 1] );
+		}
+		else if( args[i] == "--wood" )
+		{
+			options.wood_image = args[i + 1];
+		}
+		else
+		{
+			return usage();
+		}
+	}
+
+	// No window is ever opened, the dummy driver will do
+	SDL_SetHint( SDL_HINT_VIDEODRIVER, "dummy" );
+	if( SDL_Init( SDL_INIT_VIDEO ) )
+	{
+		wcerr << "SDL_Init() failed: " << SDL_GetError() << endl;
+		return 1;
+	}
+
+	auto defer_sdl_quit = tools::make_defer( [](){
+		SDL_Quit();
+	} );
+
+	auto start = chrono::steady_clock::now();
+	export_video( args[0], args[1], options );
+
+	auto elapsed = chrono::duration<double>( chrono::steady_clock::now() - start );
+	wcout << "Done in " << elapsed.count() << " s" << endl;
+
+	return 0;
+}
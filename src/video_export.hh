@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Exporting the replay of a game as uncompressed video
+// - The output is YUV4MPEG2 (.y4m), 4:2:0, which ffmpeg and most
+//   players read directly
+// - Every move is rendered offscreen once and held for a number of
+//   frames, the final position for two seconds more
+// - Rendering and encoding run on separate threads with a few frames
+//   in flight between them. Only the points that changed are redrawn
+//   and only the rows that changed are converted to YUV.
+namespace corpus
+{
+	struct VideoOptions
+	{
+		int         width           = 1920;
+		int         height          = 1080;
+		int         fps             = 30;
+		int         frames_per_move = 15;
+		std::string wood_image      = "data/wood.jpg";
+	};
+
+	// Converts 32 bit ARGB to planar YUV 4:2:0, BT.601 limited range.
+	// Rows are converted in pairs and only where they differ from
+	// previous, pass an empty previous to convert everything.
+	// width and height must be even.
+	void argb_to_yuv420(
+		const std::vector<uint32_t>& pixels,
+		const std::vector<uint32_t>& previous,
+		int                          width,
+		int                          height,
+		std::vector<uint8_t>&        yuv
+	);
+
+	void export_video(
+		const std::string&  game_path,
+		const std::string&  output_path,
+		const VideoOptions& options
+	);
+
+	int export_video_command( const std::vector<std::string>& args );
+}
@@ -8,7 +8,8 @@ using namespace gui;
 
 
 Window::Window()
-: closed(false), sdl_id(0), width(460), height(320)
+: closed(false), sdl_id(0), width(460), height(320), size_changed(true),
+  needs_redraw(true)
 {
 	// Create the window
 	auto window_ptr = SDL_CreateWindow(
@@ -31,32 +32,22 @@ Window::Window()
 
 		return;
 	}
-
-
-	// Create the renderer
-	auto renderer_ptr = SDL_CreateRenderer( window_ptr, 0, SDL_RENDERER_ACCELERATED );
-	if( renderer_ptr )
-	{
-		renderer = sdl2::RendererPtr( renderer_ptr );
-	}
-	else
-	{
-		wcerr << "Window::Window() - SDL_CreateRenderer() failed: "
-		     << SDL_GetError() << endl;
-
-		return;
-	}
 }
 
 
 
 Window::Window( Window&& other )
+: closed(false), sdl_id(0), width(0), height(0), size_changed(true),
+  needs_redraw(true)
 {
 	using std::swap;
 	swap( window,   other.window );
-	swap( renderer, other.renderer );
 	swap( sdl_id,   other.sdl_id );
 	swap( closed,   other.closed );
+	swap( width,    other.width );
+	swap( height,   other.height );
+	swap( size_changed, other.size_changed );
+	swap( needs_redraw, other.needs_redraw );
 
 	wcout << "Window move constructed" << endl;
 }
@@ -67,9 +58,12 @@ Window& Window::operator=( Window&& other )
 {
 	using std::swap;
 	swap( window,   other.window );
-	swap( renderer, other.renderer );
 	swap( sdl_id,   other.sdl_id );
 	swap( closed,   other.closed );
+	swap( width,    other.width );
+	swap( height,   other.height );
+	swap( size_changed, other.size_changed );
+	swap( needs_redraw, other.needs_redraw );
 
 	wcout << "Window moved" << endl;
 	return *this;
@@ -86,7 +80,7 @@ Window::~Window()
 
 bool Window::is_initialized() const
 {
-	return !closed && !!window && !!renderer;
+	return !closed && !!window;
 }
 
 
@@ -96,12 +90,15 @@ void Window::handle_sdl_event( const SDL_Event &e )
 	switch( e.window.event )
 	{
 		case SDL_WINDOWEVENT_SHOWN:
-		case SDL_WINDOWEVENT_HIDDEN:
 		case SDL_WINDOWEVENT_EXPOSED:
+		case SDL_WINDOWEVENT_RESTORED:
+			needs_redraw = true;
+			break;
+
+		case SDL_WINDOWEVENT_HIDDEN:
 		case SDL_WINDOWEVENT_MOVED:
 		case SDL_WINDOWEVENT_MINIMIZED:
 		case SDL_WINDOWEVENT_MAXIMIZED:
-		case SDL_WINDOWEVENT_RESTORED:
 		case SDL_WINDOWEVENT_ENTER:
 		case SDL_WINDOWEVENT_LEAVE:
 		case SDL_WINDOWEVENT_FOCUS_GAINED:
@@ -112,6 +109,7 @@ void Window::handle_sdl_event( const SDL_Event &e )
 		case SDL_WINDOWEVENT_SIZE_CHANGED:
 			width = e.window.data1;
 			height = e.window.data2;
+			size_changed = true;
 			break;
 
 		case SDL_WINDOWEVENT_CLOSE:
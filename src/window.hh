@@ -7,13 +7,14 @@ namespace gui
 
 struct Window
 {
-	sdl2::WindowPtr   window;
-	sdl2::RendererPtr renderer;
+	sdl2::WindowPtr   window;   // Its renderer belongs to the render thread
 	uint32_t          sdl_id; // SDL Window Id
 	bool              closed;
 
 	uint32_t          width;
 	uint32_t          height;
+	bool              size_changed; // Set on resize, cleared by the renderer
+	bool              needs_redraw; // Set when the contents were lost
 
 
 	Window();